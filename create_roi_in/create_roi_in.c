@@ -6,6 +6,10 @@ SYNOPSIS: create_roi_in <infile>
 
 DESCRIPTION:
 	<infile> is a base name, assume that <infile>.dat and <infile>.hdr exist.
+	<infile>.hdrb is used instead of <infile>.hdr if it is there, and
+	<infile>.pdat instead of <infile>.dat.  ROI_PAC itself reads the
+	unpacked .dat, so a packed file has to be converted with dat_convert
+	before ROI_PAC is run.
 
 	- Read hdr file to get the start time and number of lines in the data segment
 		- calculate the number of patches to process
@@ -30,6 +34,9 @@ PROGRAM HISTORY:
     VERS:   DATE:  AUTHOR:      PURPOSE:
     ---------------------------------------------------------------
     1.0	    4/12   T. Logan     Seasat Proof of Concept Project - ASF
+    1.1	    10/26  	        Reads .hdrb header files
+    1.2	    10/26  	        Reads packed .pdat data files
+    1.3	    10/26  	        Takes the i/q mean from the .qual file if there is one
     
 HARDWARE/SOFTWARE LIMITATIONS:
 
@@ -99,45 +106,64 @@ BUGS:
 #include <math.h>
 #include "seasat.h"
 
-typedef struct {
-        int      major_cnt;
-	long int  major_sync_loc;
-	int     lsd_year;
-	int     station_code;
-	long int msec;
-	int      day_of_year;
-	int      clock_drift;  
-	int     no_scan_indicator_bit;
-	int     bits_per_sample;
-	int     mfr_lock_bit;
-	int     prf_rate_code;
-	int     delay;
-	int     scu_bit;
-	int     sdf_bit;
-	int     adc_bit;
-	int     time_gate_bit;
-	int     local_prf_bit;
-	int     auto_prf_bit;
-	int     prf_lock_bit;
-	int     local_delay_bit;
-}  SEASAT_header_ext;
-
-int get_values(FILE *fp,SEASAT_header_ext *s);
 int get_int_value(FILE *fp, const char token[], int *val, int from);
-void estdop(FILE *fp, int sl, int nl, double *t1, double *t2, double *t3, double *iqmean);
+void estdop(SEASAT_dat_file *fp, int sl, int nl, double *t1, double *t2, double *t3, double *iqmean);
 void get_peg_info(double start_time, int nl, int prf, 
                   double *schvel, double *schacc, double *height, double *earthrad);
-void spectra(FILE *fp,int sl, int nl,double iqmean,int *ocnt,double *ocal);
+void spectra(SEASAT_dat_file *fp,int sl, int nl,double iqmean,int *ocnt,double *ocal);
 
 #define GOOD_SAMPLES  6840
 #define GOOD_LINES    11600    
 #define MAX_DWP_SHIFTS   20
 #define DIGITIZATION_SHIFT 432
 #define MAX_CALTONES  20
+#define MAX_SATURATED 0.05	/* warn if more samples than this are at 0 or 31 */
+
+extern int sum_lines;		/* lines estdop looks at - dop.c */
+
+/*-------------------------------------------------------------------------
+  Takes the i/q mean from the decoder's quality file <base>.qual, if
+  there is one for the nlines lines of the data file.  It is the mean of
+  the same lines estdop would sum, worked out the same way, so ROI.in
+  comes out the same; the samples are just not read for it.  Also shows
+  the statistics of all samples of the file.  Returns 0, or -1 if the
+  mean has to come from the data.
+ -------------------------------------------------------------------------*/
+static int qual_iqmean(const char *base, long nlines, int sl, int nl, double *iqmean)
+{
+  char qualname[256];
+  SEASAT_sample_stats s;
+  SEASAT_line_quality *q;
+  double mean, variance, saturated, sum, tsum;
+  long where, n, i;
+  int v;
+
+  sprintf(qualname,"%s.qual",base);
+  if (read_qual_stats(qualname,&s) != 0) return(-1);
+  sample_moments(&s,&mean,&variance,&saturated);
+  printf("Samples of %s: mean %lf, variance %lf, %.2lf%% saturated\n",qualname,mean,variance,100.0*saturated);
+  if (saturated > MAX_SATURATED) printf("WARNING: %.2lf%% of the samples are at 0 or 31\n",100.0*saturated);
+
+  q = read_qual_file(qualname,&n);
+  where = (sl+nl/2) - sum_lines/2;
+  if (n != nlines || where < 0 || where+sum_lines >= n) { free(q); return(-1); }
+  tsum = 0.0;
+  for (i=where+1; i<=where+sum_lines; i++) {
+    sum = 0.0;
+    for (v=0; v<QUAL_BINS; v++) sum = sum + (double) v * q[i].hist[v];
+    tsum = tsum + sum / SAMPLES_PER_LINE;
+  }
+  free(q);
+  *iqmean = tsum / sum_lines;
+  printf("i mean from %s: %lf\n\n",qualname,*iqmean);
+  return(0);
+}
 
 main(int argc, char *argv[])
 {
-  FILE *fpdat, *fphdr, *fproi, *fpstarthdr;
+  FILE *fproi, *fpstarthdr;
+  SEASAT_dat_file *fpdat;
+  SEASAT_hdr_file *fphdr;
   char infile[256], outfile[256], hdrfile[256], starthdrfile[256], dwpfile[256];
   int err, nl, patches, prf;
   int from;
@@ -184,8 +210,8 @@ main(int argc, char *argv[])
     exit(1);
   }
 
-  strcpy(infile,argv[1]); strcat(infile,".dat");
-  strcpy(hdrfile,argv[1]); strcat(hdrfile,".hdr");
+  find_dat_file(argv[1],infile);
+  find_hdr_file(argv[1],hdrfile);
 
   start_line = 1;
   end_line = -99;
@@ -195,7 +221,7 @@ main(int argc, char *argv[])
     end_line = atoi(argv[5]);
   }
 
-  if ((fphdr=fopen(hdrfile,"r"))==NULL) {printf("Error opening input file %s\n",hdrfile); exit(1);}
+  if ((fphdr=open_hdr_file(hdrfile,"r"))==NULL) {printf("Error opening input file %s\n",hdrfile); exit(1);}
   hdr = (SEASAT_header_ext *) malloc(sizeof(SEASAT_header_ext));
   hdr1 = (SEASAT_header_ext *) malloc(sizeof(SEASAT_header_ext));  
   
@@ -213,7 +239,7 @@ main(int argc, char *argv[])
 
   /* Create appropriate state vectors for this datatake
    ---------------------------------------------------*/
-  val = get_values(fphdr, hdr);
+  val = read_header(fphdr, hdr);
   if (val!=20) {printf("ERROR: unable to read from header file\n"); exit(1);}
   
   s_date.year = 1970 + hdr->lsd_year;
@@ -229,8 +255,9 @@ main(int argc, char *argv[])
   
   /* seek to the start line the user requested
    ------------------------------------------*/
-  for (i=1; i<start_line; i++) {
-    val = get_values(fphdr, hdr);
+  if (start_line > 1) {
+    if (seek_header(fphdr,start_line-1)==0) val = read_header(fphdr, hdr);
+    else val = EOF;
     if (val!=20) {printf("ERROR: unable to read to specified start line in header file\n"); exit(1);}
   }
   current_year = 1970 + hdr->lsd_year;
@@ -248,7 +275,7 @@ main(int argc, char *argv[])
     while (val==20) {
       nl++;
       if (which==0) { 
-        val=get_values(fphdr,hdr1); 
+        val=read_header(fphdr,hdr1); 
 	which=1; 
 	if (dwp_val[dwp_cnt-1] != hdr1->delay) {
           dwp_val[dwp_cnt] = hdr1->delay;
@@ -256,7 +283,7 @@ main(int argc, char *argv[])
           dwp_cnt++;
         }
       } else { 
-        val=get_values(fphdr,hdr);  
+        val=read_header(fphdr,hdr);  
 	which=0; 
 	if (dwp_val[dwp_cnt-1] != hdr->delay) {
           dwp_val[dwp_cnt] = hdr->delay;
@@ -277,7 +304,7 @@ main(int argc, char *argv[])
   } else {  /* just read to the end_line */
     nl = end_line-start_line+1;
     for (i=start_line; i<end_line; i++) {
-      val = get_values(fphdr, hdr);
+      val = read_header(fphdr, hdr);
       if (val!=20) {printf("ERROR: unable to read to specified end line in header file\n"); exit(1);}
       if (dwp_val[dwp_cnt-1] != hdr->delay) {
         dwp_val[dwp_cnt] = hdr->delay;
@@ -399,12 +426,13 @@ main(int argc, char *argv[])
  
 /* Estimate the doppler centroid
  ------------------------------*/
-  if ((fpdat=fopen(infile,"rb"))==NULL)  {printf("Error opening input file %s\n",infile); exit(1);}
-  estdop(fpdat,start_line-1,nl,&t1,&t2,&t3,&iqmean);
+  if ((fpdat=open_dat_file(infile,"r"))==NULL)  {printf("Error opening input file %s\n",infile); exit(1);}
+  if (qual_iqmean(argv[1],count_dat_lines(fpdat),start_line-1,nl,&iqmean) == 0)
+    estdop(fpdat,start_line-1,nl,&t1,&t2,&t3,NULL);
+  else estdop(fpdat,start_line-1,nl,&t1,&t2,&t3,&iqmean);
 
 /* Calculate the spectra and get the caltones
  -------------------------------------------*/
-  fseek(fpdat,0,SEEK_SET);
   spectra(fpdat,start_line-1,nl,iqmean,&ncaltones,caltones);
 
 /*=================================================================================
@@ -425,6 +453,10 @@ main(int argc, char *argv[])
   printf("============================================================================\n");
 
 /* First input data file */
+  if (fpdat->packed) {
+    strcpy(infile,argv[1]); strcat(infile,".dat");
+    printf("WARNING: ROI_PAC needs the unpacked data file - run dat_convert %s.pdat %s first\n",argv[1],infile);
+  }
   printf("First input data file: %s\n",infile);
   fprintf(fproi,"%s\n",infile);
   
@@ -616,24 +648,10 @@ main(int argc, char *argv[])
   }
 
 /*  fclose(fpdat); */
-  fclose(fphdr);
+  close_hdr_file(fphdr);
   fclose(fproi);
 
   printf("============================================================================\n");
   printf(" CREATE_ROI_IN PROGRAM COMPLETED\n");
   printf("============================================================================\n\n\n");
 }
-
-int get_values(FILE *fp,SEASAT_header_ext *s)
-{
-  int val;
-  if (s==NULL) {printf("empty pointer passed to get_values\n"); exit(1);}
-  val = fscanf(fp,"%i %li %i %i %i %li %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n",
-    &(s->major_cnt),&(s->major_sync_loc),&(s->station_code),&(s->lsd_year),
-    &(s->day_of_year),&(s->msec),&(s->clock_drift),&(s->no_scan_indicator_bit),
-    &(s->bits_per_sample),&(s->mfr_lock_bit),&(s->prf_rate_code),&(s->delay),
-    &(s->scu_bit),&(s->sdf_bit),&(s->adc_bit),&(s->time_gate_bit),&(s->local_prf_bit),
-    &(s->auto_prf_bit),&(s->prf_lock_bit),&(s->local_delay_bit));
-  return(val);
-}
-
@@ -17,12 +17,15 @@ PROGRAM HISTORY:
     VERS:   DATE:    AUTHOR:      PURPOSE:
     ---------------------------------------------------------------
     1.0	    9/21/12  T. Logan     Seasat Proof of Concept Project - ASF
+    1.1	    10/26  	          Reads .dat or packed .pdat data files
+    1.2	    10/26  	          No i/q mean when iqmean is NULL
     				  
     
 HARDWARE/SOFTWARE LIMITATIONS:
 
 ALGORITHM DESCRIPTION:  Algorithm converted from ROI PAC fortran
-			Added calculation of i/q mean 
+			Added calculation of i/q mean (skipped if iqmean is NULL,
+			when the caller has it from the decoder's .qual file)
 			Added culling points for linear regression and modulo math...
 
 ALGORITHM REFERENCES:
@@ -34,6 +37,7 @@ BUGS:
 #include <stdlib.h>
 #include <math.h>
 #include <fftw3.h>
+#include "seasat_dat.h"
 
 typedef struct {
    float real;
@@ -48,7 +52,7 @@ int fft_len  = 16384;
 int half_fft = 8192;
 int sum_lines = 10000;
 
-void estdop(FILE *fp, int sl, int nl, double *t1, double *t2, double *t3, double *iqmean)
+void estdop(SEASAT_dat_file *fp, int sl, int nl, double *t1, double *t2, double *t3, double *iqmean)
 {
   unsigned char in[fft_len];
   complexFloat prod[fft_len];
@@ -76,11 +80,11 @@ void estdop(FILE *fp, int sl, int nl, double *t1, double *t2, double *t3, double
   for(i=0;i<sum_lines;i++) sumi[i] = 0.0; 
 
   /* seek to middle of file */
-  long int where = ((sl+nl/2) - sum_lines/2) * line_len;
-  fseek(fp,where,SEEK_SET);
+  long int where = ((sl+nl/2) - sum_lines/2);
+  seek_dat_line(fp,where);
 
   /* Pre-read the first line of the file */
-  fread(in,1,line_len,fp);
+  read_dat_line(fp,in);
   
   for (i=0; i<sum_lines; i++) {
     if (i%1000==0) {printf("Estimating Doppler...  line %i\n",i+(sl+nl/2)-sum_lines/2);}
@@ -97,14 +101,14 @@ void estdop(FILE *fp, int sl, int nl, double *t1, double *t2, double *t3, double
     fftwf_execute(phalfa);
     
     /* read in next line, convert to complex, transform */
-    fread(in,1,line_len,fp);
+    read_dat_line(fp,in);
     for (k=0; k<line_len; k++) {
       kk = in[k];
       if (kk < 0) kk = kk+32;
       b[k].real = kk-15.5;
       b[k].imag = 0.0;
-      sumi[i] = sumi[i] + in[k];
     }
+    if (iqmean != NULL) for (k=0; k<line_len; k++) sumi[i] = sumi[i] + in[k];
     for (k=line_len; k<fft_len; k++) { b[k].real = 0.0; b[k].imag = 0.0; }
     fftwf_execute(plongb);
     fftwf_execute(phalfb);
@@ -156,6 +160,7 @@ void estdop(FILE *fp, int sl, int nl, double *t1, double *t2, double *t3, double
   fclose(fpout);
 
   yax2bxc(line,acc,len/2,t3,t2,t1);
+  if (iqmean == NULL) return;
 
   tsum = 0.0;
   for (i=0; i<sum_lines; i++) {
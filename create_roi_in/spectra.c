@@ -17,6 +17,7 @@ PROGRAM HISTORY:
     VERS:   DATE:    AUTHOR:      PURPOSE:
     ---------------------------------------------------------------
     1.0	    9/27/12  T. Logan     ASF Day of innovation
+    1.1	    10/26  	          Reads .dat or packed .pdat data files
     
 HARDWARE/SOFTWARE LIMITATIONS:
 
@@ -32,6 +33,7 @@ BUGS:
 #include <string.h>
 #include <math.h>
 #include <fftw3.h>
+#include "seasat_dat.h"
 
 typedef struct {
    float real;
@@ -44,7 +46,7 @@ typedef struct {
 #define DEVS     1.5
 #define MAX_CALTONES 20
 
-void spectra(FILE *fp,int sl, int nl,double iqmean,int *ocnt,double *ocal)
+void spectra(SEASAT_dat_file *fp,int sl, int nl,double iqmean,int *ocnt,double *ocal)
 {
   unsigned char in[FFT_LEN];
   complexFloat **sum;
@@ -80,16 +82,15 @@ void spectra(FILE *fp,int sl, int nl,double iqmean,int *ocnt,double *ocal)
   
   /* seek to middle of file */
   long int where = ((sl+nl/2) - SUM_LINES/2);
-  where = where * LINE_LEN;
   if (where < 0) { 
      printf("ERROR: Bad seek in spectra!!!  May need to decrease SUM_LINES\n"); 
-     printf(" sl = %i, nl/2 = %i, SUM_LINES/2 = %i, LINE_LEN = %i, WHERE = %li\n",sl,nl/2,SUM_LINES/2,LINE_LEN,where);
+     printf(" sl = %i, nl/2 = %i, SUM_LINES/2 = %i, LINE_LEN = %i, WHERE = %li\n",sl,nl/2,SUM_LINES/2,LINE_LEN,where*LINE_LEN);
      exit(1);}
-  fseek(fp,where,SEEK_SET);
+  seek_dat_line(fp,where);
   
   for (i=0; i<SUM_LINES; i++) {
     if (i%1000==0) {printf("Calculating Spectra...  line %i\n",i+(sl+nl/2)-SUM_LINES/2);}
-    fread(in,1,LINE_LEN,fp);
+    read_dat_line(fp,in);
     for (k=0; k<LINE_LEN; k++) {
       kk = in[k];
       if (kk < 0) kk = kk+32;
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Asynchronous line writer
+
+  When the payload is decoded on the main thread, each finished line is
+  copied into a large buffer instead of going out through fwrite.  Full
+  buffers are passed to a writer thread through a ring of WRITE_BUFFERS
+  buffers with one producer (the decoder) and one consumer (the writer).
+  Two semaphores count the full and the free buffers; they are the only
+  synchronisation.  While there is a buffer to take, a semaphore is a
+  single atomic operation; a side only sleeps when the ring is full (the
+  decoder waits for the disk) or empty (the writer waits for lines).
+
+  With direct I/O the output file is written with O_DIRECT from page
+  aligned buffers, bypassing the page cache.  A buffer holds a whole
+  number of 4096 byte blocks, so only the last, partial buffer of a file
+  has to be finished with an ordinary write.  A partial buffer flushed
+  anywhere else would leave the file off the block boundaries for good,
+  so the decoder only takes checkpoints every DIRECT_LINES lines, and a
+  direct write that would start off a boundary is reported.  Either way,
+  and where the file system will not have O_DIRECT, that file goes on
+  through the page cache; the next output file tries direct I/O again.
+
+  Packed (.pdat) lines are packed straight into the buffer, so they cost
+  no extra copy.  Direct I/O is not used for them, since the file header
+  leaves the lines off the block boundaries.
+*************************************************************************************/
+
+#define WRITE_BUFFERS	 4
+#define LINES_PER_BUFFER DIRECT_LINES	/* a whole number of 4096 byte blocks */
+#define DIRECT_ALIGN	 4096
+
+typedef struct {
+	int	fd;
+	long	nbytes;
+	unsigned char *data;		/* LINES_PER_BUFFER lines, DIRECT_ALIGN aligned */
+} write_buffer;
+
+static write_buffer	 wbuf[WRITE_BUFFERS];
+static pthread_t	 writer;
+static sem_t		 full_bufs, free_bufs;
+static unsigned long	 head, tail;		/* next buffer to fill / to write	*/
+static write_buffer	*current = NULL;	/* buffer being filled by the decoder	*/
+static int		 running = 0;
+static int		 use_direct = 0;	/* -d asked for			*/
+static struct stat	 refused;		/* file written through the page cache	*/
+static int		 have_refused = 0;
+static int		 use_packed = 0;
+static long		 line_bytes = SAMPLES_PER_LINE;	/* bytes a line takes in the file */
+
+/* the output file open on fd is written without O_DIRECT from now on */
+static void refuse_direct(int fd, const char *why)
+{
+	printf("WARNING: %s - writing through the page cache\n",why);
+	have_refused = (fstat(fd,&refused) == 0);
+}
+
+static int direct_refused(int fd)
+{
+	struct stat st;
+
+	return(have_refused && fstat(fd,&st) == 0 && st.st_dev == refused.st_dev && st.st_ino == refused.st_ino);
+}
+
+/* turns O_DIRECT on or off for fd; 0 if the file system will not have it */
+static int set_direct(int fd, int on)
+{
+	int flags = fcntl(fd,F_GETFL);
+
+	if (flags < 0) return(0);
+	flags = on ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+	return(fcntl(fd,F_SETFL,flags) == 0);
+}
+
+static void write_all(int fd, const unsigned char *p, long n)
+{
+	long w;
+
+	while (n > 0) {
+	  w = write(fd,p,n);
+	  if (w < 0 && errno == EINTR) continue;
+	  if (w < 0 && errno == EINVAL && use_direct && !direct_refused(fd)) {
+	    refuse_direct(fd,"direct I/O refused for the output file");
+	    set_direct(fd,0);
+	    continue;
+	  }
+	  if (w <= 0) { printf("ERROR: unable to write decoded lines\n"); exit(1); }
+	  p += w;
+	  n -= w;
+	}
+}
+
+static void write_buffer_out(write_buffer *b)
+{
+	long aligned, at;
+	char why[80];
+
+	if (!use_direct || direct_refused(b->fd)) { write_all(b->fd,b->data,b->nbytes); return; }
+
+	if ((at = lseek(b->fd,0,SEEK_CUR)) % DIRECT_ALIGN != 0) {
+	  sprintf(why,"decoded lines flushed off the block boundaries (byte %li)",at);
+	  refuse_direct(b->fd,why);
+	  write_all(b->fd,b->data,b->nbytes);
+	  return;
+	}
+
+	if (!set_direct(b->fd,1)) {
+	  refuse_direct(b->fd,"direct I/O not supported for the output file");
+	  write_all(b->fd,b->data,b->nbytes);
+	  return;
+	}
+	aligned = b->nbytes & ~(long)(DIRECT_ALIGN-1);
+	if (aligned > 0) write_all(b->fd,b->data,aligned);
+	if (aligned < b->nbytes) {
+	  /* the tail of the file */
+	  set_direct(b->fd,0);
+	  write_all(b->fd,b->data+aligned,b->nbytes-aligned);
+	}
+}
+
+static void *writer_thread(void *arg)
+{
+	write_buffer *b;
+	long start;
+
+	for (;;) {
+	  sem_wait(&full_bufs);
+	  b = &wbuf[tail % WRITE_BUFFERS];
+	  if (b->fd < 0) break;			/* stop_async_writer */
+	  io_throttle_begin();
+	  if (stats_on) start = stat_clock();
+	  write_buffer_out(b);
+	  if (stats_on) stat_thread_time(STAT_WRITE,start,b->nbytes);
+	  io_throttle_end();
+	  tail++;
+	  sem_post(&free_bufs);
+	}
+	return(NULL);
+}
+
+/* hands the buffer being filled to the writer */
+static void submit_current(void)
+{
+	if (current == NULL) return;
+	head++;
+	current = NULL;
+	sem_post(&full_bufs);
+}
+
+/*-------------------------------------------------------------------------
+  Starts the writer thread.  direct asks for O_DIRECT output; packed
+  writes the lines packed, 8 samples to every 5 bytes.
+ -------------------------------------------------------------------------*/
+void start_async_writer(int direct, int packed)
+{
+	int i;
+
+	for (i=0; i<WRITE_BUFFERS; i++) {
+	  if (posix_memalign((void **) &wbuf[i].data,DIRECT_ALIGN,(long)LINES_PER_BUFFER*SAMPLES_PER_LINE) != 0) {
+	    printf("ERROR: unable to allocate output buffers\n"); exit(1);
+	  }
+	}
+	sem_init(&full_bufs,0,0);
+	sem_init(&free_bufs,0,WRITE_BUFFERS);
+	head = tail = 0;
+	current = NULL;
+	use_packed = packed;
+	use_direct = packed ? 0 : direct;
+	have_refused = 0;
+	line_bytes = packed ? PACKED_LINE_BYTES : SAMPLES_PER_LINE;
+	if (pthread_create(&writer,NULL,writer_thread,NULL) != 0) {
+	  printf("ERROR: unable to start output writer thread\n"); exit(1);
+	}
+	running = 1;
+}
+
+/*-------------------------------------------------------------------------
+  Queues one decoded line (SAMPLES_PER_LINE bytes) for the file open on
+  fd.  The line is copied, so line can be reused straight away.
+ -------------------------------------------------------------------------*/
+void write_line_async(int fd, const unsigned char *line)
+{
+	if (current != NULL && current->fd != fd) submit_current();
+	if (current == NULL) {
+	  sem_wait(&free_bufs);
+	  current = &wbuf[head % WRITE_BUFFERS];
+	  current->fd = fd;
+	  current->nbytes = 0;
+	}
+	if (use_packed) pack_samples(line,current->data+current->nbytes,SAMPLES_PER_LINE);
+	else memcpy(current->data+current->nbytes,line,SAMPLES_PER_LINE);
+	current->nbytes += line_bytes;
+	if (current->nbytes == LINES_PER_BUFFER*line_bytes) submit_current();
+}
+
+/*-------------------------------------------------------------------------
+  Waits until every queued line is written.  Must be called before the
+  output file is closed or removed.  Does nothing if the writer is not
+  running.
+ -------------------------------------------------------------------------*/
+void flush_async_writer(void)
+{
+	int i;
+
+	if (!running) return;
+	submit_current();
+	for (i=0; i<WRITE_BUFFERS; i++) sem_wait(&free_bufs);
+	for (i=0; i<WRITE_BUFFERS; i++) sem_post(&free_bufs);
+}
+
+void stop_async_writer(void)
+{
+	int i;
+
+	if (!running) return;
+	flush_async_writer();
+	sem_wait(&free_bufs);
+	wbuf[head % WRITE_BUFFERS].fd = -1;
+	sem_post(&full_bufs);
+	pthread_join(writer,NULL);
+
+	for (i=0; i<WRITE_BUFFERS; i++) free(wbuf[i].data);
+	sem_destroy(&full_bufs);
+	sem_destroy(&free_bufs);
+	running = 0;
+}
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Batch decoding
+
+  Decodes every raw file named in a manifest, a few at a time.  The
+  manifest has one raw file a line, optionally followed by the base name
+  for its output files; without one the raw file's name is used, less
+  its directory and extension.  Blank lines and lines starting with #
+  are skipped.
+
+  Each raw file is decoded by a worker process forked from the decoder,
+  which then carries on exactly as if it had been started on that one
+  file, so the outputs are named <base>_NNN.dat (.pdat, .hdr, .hdrb) as
+  always.  What the worker prints goes to <base>.log.  No more than
+  workers files are decoded at once, and between them only io_slots
+  workers write decoded lines at any one time; the others keep decoding
+  into their write buffers until a slot is free.  That keeps a few
+  large writes going to the disk instead of many small competing ones.
+
+  The throttle is a semaphore in memory shared by all the workers.  The
+  writers take a slot around each buffer or batch of lines they write
+  (see async_write.c and line_pool.c); outside batch mode it is not set
+  up and costs nothing.
+*************************************************************************************/
+
+#define MAX_MANIFEST_LINE 1024
+
+typedef struct {
+	char	inname[256];
+	char	outbase[256];
+	long	in_bytes;
+	pid_t	pid;
+	double	start, seconds;
+	int	status;		/* from waitpid				*/
+	int	outputs;	/* output data files written		*/
+	long	lines;		/* lines in them			*/
+	int	failed;
+} batch_job;
+
+static sem_t	*io_sem = NULL;	/* shared by the workers, NULL outside batch mode */
+
+/* waits for a slot to write decoded lines */
+void io_throttle_begin(void)
+{
+	if (io_sem == NULL) return;
+	while (sem_wait(io_sem) != 0 && errno == EINTR);
+}
+
+void io_throttle_end(void)
+{
+	if (io_sem != NULL) sem_post(io_sem);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv,NULL);
+	return(tv.tv_sec + tv.tv_usec/1.0e6);
+}
+
+/* the raw file's name without its directory and extension */
+static void default_base(const char *inname, char *outbase)
+{
+	const char *p = strrchr(inname,'/');
+	char *q;
+
+	strcpy(outbase,p ? p+1 : inname);
+	if ((q = strrchr(outbase,'.')) != NULL && q != outbase) *q = 0;
+}
+
+/*-------------------------------------------------------------------------
+  Reads the manifest name.  Returns the jobs and sets *n.
+ -------------------------------------------------------------------------*/
+static batch_job *read_manifest(const char *name, int *n)
+{
+	FILE *fp;
+	char line[MAX_MANIFEST_LINE], in[MAX_MANIFEST_LINE], out[MAX_MANIFEST_LINE];
+	batch_job *jobs = NULL;
+	int k, max_jobs = 0;
+
+	if ((fp = fopen(name,"r")) == NULL) { printf("ERROR: unable to open manifest %s\n",name); exit(1); }
+	*n = 0;
+	while (fgets(line,MAX_MANIFEST_LINE,fp) != NULL) {
+	  if ((k = sscanf(line,"%s %s",in,out)) < 1 || in[0] == '#') continue;
+	  if (strlen(in) > 200 || (k == 2 && strlen(out) > 200)) {
+	    printf("ERROR: file name too long in manifest %s: %s",name,line); exit(1);
+	  }
+	  if (*n == max_jobs) {
+	    max_jobs = max_jobs ? 2*max_jobs : 256;
+	    jobs = (batch_job *) realloc(jobs,max_jobs*sizeof(batch_job));
+	    if (jobs == NULL) { printf("ERROR: unable to allocate manifest\n"); exit(1); }
+	  }
+	  memset(&jobs[*n],0,sizeof(batch_job));
+	  strcpy(jobs[*n].inname,in);
+	  if (k == 2) strcpy(jobs[*n].outbase,out);
+	  else default_base(in,jobs[*n].outbase);
+	  (*n)++;
+	}
+	fclose(fp);
+	return(jobs);
+}
+
+/* counts the data files a finished job left and the lines in them */
+static void count_outputs(batch_job *j)
+{
+	SEASAT_dat_file *f;
+	char base[300], name[310];
+
+	for (j->outputs=0; ; j->outputs++) {
+	  sprintf(base,"%s_%3.3i",j->outbase,j->outputs);
+	  if ((f = open_dat_file(find_dat_file(base,name),"r")) == NULL) break;
+	  j->lines += count_dat_lines(f);
+	  close_dat_file(f);
+	}
+}
+
+static void report_job(batch_job *j, int done, int n)
+{
+	printf("[%i/%i] %s: ",done,n,j->inname);
+	if (j->failed) {
+	  if (j->pid == 0) printf("FAILED - unable to read the raw file\n");
+	  else if (WIFSIGNALED(j->status)) printf("FAILED - killed by signal %i (see %s.log)\n",WTERMSIG(j->status),j->outbase);
+	  else if (WIFEXITED(j->status)) printf("FAILED - exit status %i (see %s.log)\n",WEXITSTATUS(j->status),j->outbase);
+	  else printf("FAILED (see %s.log)\n",j->outbase);
+	  return;
+	}
+	printf("%i output files, %li lines, %.1f MB in %.1f s (%.1f MB/s)\n",j->outputs,j->lines,
+		j->in_bytes/1.0e6,j->seconds,j->seconds > 0 ? j->in_bytes/1.0e6/j->seconds : 0.0);
+}
+
+/*-------------------------------------------------------------------------
+  Decodes the raw files in manifest with workers worker processes, at
+  most io_slots of them writing at a time, and prints a summary.
+
+  Only returns in a worker, with inname and outbase set to the raw file
+  and output base name it is to decode; the caller then decodes it as
+  usual.  The batch itself exits when every file is done, with 1 if any
+  of them failed.
+ -------------------------------------------------------------------------*/
+void run_batch(const char *manifest, int workers, int io_slots, char *inname, char *outbase)
+{
+	batch_job *jobs;
+	struct stat st;
+	double start;
+	long total_bytes = 0, total_lines = 0;
+	int n, i, next = 0, running = 0, done = 0, failed = 0, outputs = 0, status;
+	pid_t pid;
+	int fd;
+
+	jobs = read_manifest(manifest,&n);
+	if (n == 0) { printf("ERROR: no raw files in manifest %s\n",manifest); exit(1); }
+	if (workers > n) workers = n;
+
+	io_sem = (sem_t *) mmap(NULL,sizeof(sem_t),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+	if (io_sem == MAP_FAILED || sem_init(io_sem,1,io_slots) != 0) {
+	  printf("ERROR: unable to set up the shared I/O throttle\n"); exit(1);
+	}
+	printf("Decoding %i raw files from %s, %i at a time, %i writing at a time\n",n,manifest,workers,io_slots);
+	start = now();
+
+	while (done < n) {
+	  /* start workers while there are files and room */
+	  while (running < workers && next < n) {
+	    batch_job *j = &jobs[next++];
+	    if (stat(j->inname,&st) != 0 || access(j->inname,R_OK) != 0) {
+	      j->failed = 1;
+	      report_job(j,++done,n);
+	      failed++;
+	      continue;
+	    }
+	    j->in_bytes = st.st_size;
+	    j->start = now();
+	    fflush(stdout);
+	    if ((pid = fork()) < 0) { printf("ERROR: unable to start a worker for %s\n",j->inname); exit(1); }
+	    if (pid == 0) {
+	      sprintf(inname,"%s.log",j->outbase);
+	      if ((fd = open(inname,O_WRONLY|O_CREAT|O_TRUNC,0644)) < 0) {
+	        printf("ERROR: unable to open log file %s\n",inname); exit(1);
+	      }
+	      dup2(fd,1);
+	      close(fd);
+	      strcpy(inname,j->inname);
+	      strcpy(outbase,j->outbase);
+	      free(jobs);
+	      return;
+	    }
+	    j->pid = pid;
+	    running++;
+	  }
+	  if (running == 0) continue;
+
+	  /* and wait for one to finish */
+	  if ((pid = wait(&status)) < 0) {
+	    if (errno == EINTR) continue;
+	    printf("ERROR: lost track of the workers\n"); exit(1);
+	  }
+	  for (i=0; i<n && jobs[i].pid != pid; i++);
+	  if (i == n) continue;
+	  running--;
+	  jobs[i].status = status;
+	  jobs[i].seconds = now() - jobs[i].start;
+	  jobs[i].failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	  if (!jobs[i].failed) count_outputs(&jobs[i]);
+	  report_job(&jobs[i],++done,n);
+	  if (jobs[i].failed) failed++;
+	}
+
+	for (i=0; i<n; i++)
+	  if (!jobs[i].failed) {
+	    total_bytes += jobs[i].in_bytes;
+	    total_lines += jobs[i].lines;
+	    outputs += jobs[i].outputs;
+	  }
+	start = now() - start;
+	printf("==========================================================================\n");
+	printf("Batch of %i raw files: %i decoded, %i failed\n",n,n-failed,failed);
+	printf("  %i output files, %li lines\n",outputs,total_lines);
+	printf("  %.1f MB read in %.1f s (%.1f MB/s)\n",total_bytes/1.0e6,start,start > 0 ? total_bytes/1.0e6/start : 0.0);
+	if (failed > 0) {
+	  printf("  failed:");
+	  for (i=0; i<n; i++) if (jobs[i].failed) printf(" %s",jobs[i].inname);
+	  printf("\n");
+	}
+	printf("==========================================================================\n");
+	exit(failed ? 1 : 0);
+}
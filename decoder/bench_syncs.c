@@ -0,0 +1,190 @@
+/******************************************************************************
+NAME: bench_syncs - checks and times the sync word search kernels
+
+SYNOPSIS: bench_syncs [megabytes]
+
+DESCRIPTION:
+	Fills [megabytes] (default 8) of random data, puts in sync codes at
+	random bit offsets with 0 to BIT_ERRORS+2 bits flipped, and checks
+	that scan_syncs finds exactly the positions a bit-by-bit comparison
+	finds, with the same error counts.  This is done with every kernel
+	the cpu supports (scalar, popcnt, avx2), over the whole buffer, over
+	random bit ranges, and a few hits at a time as find_next_sync asks.
+	Then reports MB/s for each kernel scanning the whole buffer.  About 3%
+	of the bit positions of random data are within BIT_ERRORS bits of the
+	sync code, far more than in real data, so the timings are low.  The
+	reference for a range is taken from the bit-by-bit search of the
+	whole buffer.
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Sync scan kernel check and benchmark
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "seasat.h"
+
+#define SYNC_WORD   0xF9A8EDu
+#define INJECT_GAP  4000		/* bytes between sync codes put in, about */
+
+static const char *kernels[] = { "scalar", "popcnt", "avx2" };
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec + ts.tv_nsec/1.0e9);
+}
+
+/* the bit errors of the sync code at bit t, one bit at a time */
+static int ref_errors(const unsigned char *data, long t)
+{
+  int k, d = 0;
+
+  for (k=0; k<24; k++) {
+    long bit = t + k;
+    int v = (data[bit>>3] >> (7-(bit&7))) & 1;
+    if (v != (int)((SYNC_WORD >> (23-k)) & 1)) d++;
+  }
+  return(d);
+}
+
+/* every sync code starting in [start_bit,end_bit), one bit at a time */
+static int ref_scan(const unsigned char *data, long length, long start_bit, long end_bit,
+		SEASAT_sync_hit *hits, int max_hits)
+{
+  long t;
+  int d, n = 0;
+
+  if (end_bit > length*8-23) end_bit = length*8-23;
+  for (t=start_bit; t<end_bit && n<max_hits; t++)
+    if ((d = ref_errors(data,t)) <= BIT_ERRORS) { hits[n].bit = t; hits[n].errors = d; n++; }
+  return(n);
+}
+
+/* the hits of the whole buffer in [start_bit,end_bit), at most max_hits of them */
+static int ref_range(const SEASAT_sync_hit *all, int nall, long start_bit, long end_bit,
+		SEASAT_sync_hit *hits, int max_hits)
+{
+  int lo = 0, hi = nall, mid, n = 0;
+
+  while (lo < hi) {
+    mid = (lo+hi)/2;
+    if (all[mid].bit < start_bit) lo = mid+1;
+    else hi = mid;
+  }
+  for (; lo<nall && all[lo].bit<end_bit && n<max_hits; lo++) hits[n++] = all[lo];
+  return(n);
+}
+
+static int same_hits(const char *what, const SEASAT_sync_hit *h1, int n1, const SEASAT_sync_hit *h2, int n2)
+{
+  int i;
+
+  if (n1 != n2) { printf("MISMATCH: %s: %i hits, reference %i\n",what,n1,n2); return(0); }
+  for (i=0; i<n1; i++)
+    if (h1[i].bit != h2[i].bit || h1[i].errors != h2[i].errors) {
+      printf("MISMATCH: %s: hit %i at bit %li (%i errors), reference bit %li (%i errors)\n",
+      	what,i,h1[i].bit,h1[i].errors,h2[i].bit,h2[i].errors);
+      return(0);
+    }
+  return(1);
+}
+
+int main(int argc, char *argv[])
+{
+  long mb = 8, length, max_hits, i, t, start, end;
+  int k, j, n, nall, nref, nsync = 0, bad = 0, tested = 0;
+  unsigned char *data;
+  SEASAT_sync_hit *all, *ref, *hits;
+  SEASAT_raw_input in;
+  double t0, tk[3];
+  char what[64];
+
+  if (argc > 1) mb = atol(argv[1]);
+  if (mb < 1) { printf("Usage: %s [megabytes]\n",argv[0]); exit(1); }
+  length = mb << 20;
+  max_hits = length;		/* one bit position in 8 */
+
+  data = (unsigned char *) malloc(length);
+  all  = (SEASAT_sync_hit *) malloc(max_hits*sizeof(SEASAT_sync_hit));
+  ref  = (SEASAT_sync_hit *) malloc(max_hits*sizeof(SEASAT_sync_hit));
+  hits = (SEASAT_sync_hit *) malloc(max_hits*sizeof(SEASAT_sync_hit));
+  if (data==NULL || all==NULL || ref==NULL || hits==NULL) { printf("ERROR: unable to allocate buffers\n"); exit(1); }
+
+  /* Random data with sync codes put in at random bit offsets
+   --------------------------------------------------------*/
+  srand(1978);
+  for (i=0; i<length; i++) data[i] = rand() & 0377;
+  for (i=rand()%INJECT_GAP; i+4 <= length; i+=INJECT_GAP/2+rand()%INJECT_GAP) {
+    unsigned int word = SYNC_WORD;
+    int flips = rand()%(BIT_ERRORS+3);
+    for (j=0; j<flips; j++) word ^= 1u << (rand()%24);
+    t = i*8 + rand()%8;
+    for (j=0; j<24; j++, t++) {
+      if ((word >> (23-j)) & 1) data[t>>3] |= 0200 >> (t&7);
+      else data[t>>3] &= ~(0200 >> (t&7));
+    }
+    nsync++;
+  }
+
+  /* a mapped file as far as scan_syncs is concerned */
+  memset(&in,0,sizeof(in));
+  in.data = data;
+  in.length = length;
+  in.eof = 1;
+
+  nall = ref_scan(data,length,0,length*8,all,max_hits);
+  printf("%li MB of random data, %i sync codes put in, %i positions within %i bits\n",mb,nsync,nall,BIT_ERRORS);
+
+  for (k=0; k<3; k++) {
+    if (use_sync_scan_kernel(kernels[k]) != 0) { printf("%-6s kernel: not supported by this cpu\n",kernels[k]); continue; }
+    tested++;
+
+    /* the whole buffer */
+    n = scan_syncs(&in,0,length*8,hits,max_hits);
+    sprintf(what,"%s whole buffer",kernels[k]);
+    if (!same_hits(what,hits,n,all,nall)) bad++;
+
+    /* random ranges, including ones ending within the last sync code */
+    for (j=0; j<2000; j++) {
+      start = rand()%(length*8);
+      end = start + rand()%(1<<(8+j%12));
+      if (j%100 == 0) end = length*8 - rand()%40;
+      n = scan_syncs(&in,start,end,hits,max_hits);
+      nref = ref_range(all,nall,start,end,ref,max_hits);
+      sprintf(what,"%s bits %li to %li",kernels[k],start,end);
+      if (!same_hits(what,hits,n,ref,nref)) { bad++; break; }
+    }
+
+    /* a few hits at a time, carrying on from the last one */
+    for (j=0; j<200; j++) {
+      int few = 1 + j%4;
+      start = rand()%(length*8);
+      end = start + (1<<16);
+      n = scan_syncs(&in,start,end,hits,few);
+      nref = ref_range(all,nall,start,end,ref,few);
+      sprintf(what,"%s %i hits from bit %li",kernels[k],few,start);
+      if (!same_hits(what,hits,n,ref,nref)) { bad++; break; }
+    }
+  }
+  if (bad) { printf("FAILED: %i mismatches\n",bad); exit(1); }
+  printf("Hits identical to a bit-by-bit search for %i kernels\n",tested);
+
+  /* Timing - the whole buffer, all hits
+   -----------------------------------*/
+  for (k=0; k<3; k++) {
+    if (use_sync_scan_kernel(kernels[k]) != 0) continue;
+    t0 = now();
+    scan_syncs(&in,0,length*8,hits,max_hits);
+    tk[k] = now()-t0;
+    printf("%-6s kernel: %8.1f MB/s (%.1fx)\n",kernels[k],mb/tk[k],tk[0]/tk[k]);
+  }
+
+  free(data); free(all); free(ref); free(hits);
+  exit(0);
+}
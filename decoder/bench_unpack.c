@@ -0,0 +1,138 @@
+/******************************************************************************
+NAME: bench_unpack - checks and times the 5-bit sample unpacker
+
+SYNOPSIS: bench_unpack [frames]
+
+DESCRIPTION:
+	Decodes [frames] (default 200000) random minor frames with both the
+	original per-sample switch decoder and decode_payload, checks that the
+	two give identical output and reports samples/second for each.  Also
+	checks unpack_samples at every bit offset against a bit-by-bit decode.
+
+	Set SEASAT_UNPACK=scalar or SEASAT_UNPACK=ssse3 to time a particular
+	kernel instead of the fastest one the cpu supports.
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        SIMD unpacker check and benchmark
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "seasat.h"
+
+#define OBUFF_LEN (SAMPLES_PER_LINE+SAMPLES_PER_FRAME*10)
+
+/* The original decode_payload, kept here as the reference */
+static int decode_payload_switch(const unsigned char *buf, unsigned char *obuff, int *optr)
+{
+    int bufptr, j, which;
+
+    bufptr = 1;  /*start at beginning of valid data */
+
+    for (j=0;j<SAMPLES_PER_FRAME;j++)  {
+      which = j%8;  /* which sample we are decoding */
+      if (bufptr >= INT_FRAME_LEN+1) printf("ERROR: bufptr = %i past end of buffer!!! \n",bufptr);
+      if ((*optr) >= SAMPLES_PER_LINE+SAMPLES_PER_FRAME) { return(1);   /* this is an error */ }
+
+      switch (which) {
+    	case 0:  obuff[*optr] = buf[bufptr] >> 3; *optr+=1; break;
+    	case 1:  obuff[*optr] = ((buf[bufptr]&07)<<2) | (buf[bufptr+1]>>6); *optr+=1; bufptr++; break;
+    	case 2:  obuff[*optr] = (buf[bufptr]&076)>>1; *optr+=1; break;
+    	case 3:  obuff[*optr] = ((buf[bufptr]&01)<<4) | ((buf[bufptr+1]&0360)>>4); *optr+=1; bufptr++; break;
+    	case 4:  obuff[*optr] = ((buf[bufptr]&017)<<1) | ((buf[bufptr+1]&0200)>>7); *optr+=1; bufptr++; break;
+    	case 5:  obuff[*optr] = (buf[bufptr]&0174)>>2; *optr+=1; break;
+    	case 6:  obuff[*optr] = ((buf[bufptr]&03)<<3) | ((buf[bufptr+1]&0340)>>5); *optr+=1; bufptr++; break;
+    	case 7:  obuff[*optr] = buf[bufptr]&037; *optr+=1; bufptr++; break;
+      }
+    }
+    return(0);
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec + ts.tv_nsec/1.0e9);
+}
+
+int main(int argc, char *argv[])
+{
+  int frames = 200000;
+  int i, j, k, off, n, optr1, optr2, ret1, ret2, bad = 0;
+  unsigned char *raw;
+  unsigned char *out1, *out2;
+  double t0, t_switch, t_new;
+
+  if (argc > 1) frames = atoi(argv[1]);
+  if (frames < 100) { printf("Usage: %s [frames]\n",argv[0]); exit(1); }
+
+  raw  = (unsigned char *) malloc((long)frames*INT_FRAME_LEN);
+  out1 = (unsigned char *) malloc(OBUFF_LEN);
+  out2 = (unsigned char *) malloc(OBUFF_LEN);
+  if (raw==NULL || out1==NULL || out2==NULL) { printf("ERROR: unable to allocate buffers\n"); exit(1); }
+
+  srand(1978);
+  for (i=0; i<frames*INT_FRAME_LEN; i++) raw[i] = rand() & 0377;
+  printf("Unpack kernel: %s\n",unpack_kernel_name());
+
+  /* Identical output, including the overflow path at the end of obuff
+   -----------------------------------------------------------------*/
+  for (i=0; i<frames; i++) {
+    optr1 = optr2 = (i*SAMPLES_PER_FRAME) % (SAMPLES_PER_LINE+SAMPLES_PER_FRAME+50);
+    memset(out1,0,OBUFF_LEN); memset(out2,0,OBUFF_LEN);
+    ret1 = decode_payload_switch(&raw[(long)i*INT_FRAME_LEN],out1,&optr1);
+    ret2 = decode_payload(&raw[(long)i*INT_FRAME_LEN],0,out2,&optr2);
+    if (ret1!=ret2 || optr1!=optr2 || memcmp(out1,out2,OBUFF_LEN)!=0) {
+      if (bad++ < 10) printf("MISMATCH: frame %i (ret %i/%i optr %i/%i)\n",i,ret1,ret2,optr1,optr2);
+    }
+  }
+
+  /* Every bit offset and sample count against a bit-by-bit decode
+   -------------------------------------------------------------*/
+  for (off=0; off<8; off++) {
+    for (n=0; n<=SAMPLES_PER_FRAME; n++) {
+      const unsigned char *src = &raw[(off*977+n*13)%(frames*INT_FRAME_LEN-INT_FRAME_LEN)];
+      unpack_samples(src,off,out2,n);
+      for (j=0; j<n; j++) {
+        int v = 0;
+        for (k=0; k<5; k++) {
+          int bit = off + 5*j + k;
+          v = (v<<1) | ((src[bit>>3] >> (7-(bit&7))) & 1);
+        }
+        if (out2[j] != v) {
+          if (bad++ < 10) printf("MISMATCH: offset %i count %i sample %i: %i != %i\n",off,n,j,out2[j],v);
+          break;
+        }
+      }
+    }
+  }
+  if (bad) { printf("FAILED: %i mismatches\n",bad); exit(1); }
+  printf("Output identical for %i random frames and all bit offsets\n",frames);
+
+  /* Timing - a line's worth of frames at a time, as in the decoder
+   --------------------------------------------------------------*/
+  t0 = now();
+  for (i=0, optr1=0; i<frames; i++) {
+    if (optr1 >= SAMPLES_PER_LINE) optr1 = 0;
+    decode_payload_switch(&raw[(long)i*INT_FRAME_LEN],out1,&optr1);
+  }
+  t_switch = now()-t0;
+
+  t0 = now();
+  for (i=0, optr2=0; i<frames; i++) {
+    if (optr2 >= SAMPLES_PER_LINE) optr2 = 0;
+    decode_payload(&raw[(long)i*INT_FRAME_LEN],0,out2,&optr2);
+  }
+  t_new = now()-t0;
+
+  printf("switch decoder: %8.1f Msamples/s\n",(double)frames*SAMPLES_PER_FRAME/t_switch/1.0e6);
+  printf("%-6s kernel: %8.1f Msamples/s (%.1fx)\n",unpack_kernel_name(),
+  	(double)frames*SAMPLES_PER_FRAME/t_new/1.0e6,t_switch/t_new);
+
+  free(raw); free(out1); free(out2);
+  exit(0);
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Decoder checkpoints
+
+  Every so many lines (-c) the decoder flushes its output files to the
+  disk and notes in a small state file where it stands: the line it has
+  just started, the frame tracker and frame number history at that
+  point, its counters, and how long the output files were with all the
+  lines before it in them.  A run started with -r reads the state back,
+  cuts the output files back to those lengths and carries on from that
+  line, so the output comes out just as if the first run had not
+  stopped.
+
+	    file, CKPT_HEADER_SIZE bytes then the state:
+		char  magic[8]		"SEASATCK"
+		int32 version		CKPT_VERSION
+		int32 state_size	sizeof(SEASAT_checkpoint)
+
+  The state is written as it is in memory, so a checkpoint is only good
+  for the seasat_decoder that wrote it.  It is written to a temporary
+  file and renamed over the old one, so there is always one whole
+  checkpoint to go back to.
+*************************************************************************************/
+
+#define CKPT_MAGIC	  "SEASATCK"
+#define CKPT_VERSION	  1
+#define CKPT_HEADER_SIZE  16
+
+/* exits if the checkpoint can not be written - the run would not be resumable */
+void write_checkpoint(const char *name, const SEASAT_checkpoint *c)
+{
+	FILE *fp;
+	char tmpname[300];
+	unsigned char h[CKPT_HEADER_SIZE];
+	int v;
+
+	sprintf(tmpname,"%s.tmp",name);
+	memset(h,0,CKPT_HEADER_SIZE);
+	memcpy(h,CKPT_MAGIC,8);
+	v = CKPT_VERSION;		memcpy(h+8,&v,4);
+	v = sizeof(SEASAT_checkpoint);	memcpy(h+12,&v,4);
+
+	if ((fp = fopen(tmpname,"wb")) == NULL) { printf("ERROR: unable to open checkpoint %s\n",tmpname); exit(1); }
+	if (fwrite(h,CKPT_HEADER_SIZE,1,fp) != 1 || fwrite(c,sizeof(SEASAT_checkpoint),1,fp) != 1 ||
+	    fflush(fp) != 0 || fdatasync(fileno(fp)) != 0) {
+	  printf("ERROR: unable to write checkpoint %s\n",tmpname); exit(1);
+	}
+	fclose(fp);
+	if (rename(tmpname,name) != 0) { printf("ERROR: unable to rename checkpoint %s to %s\n",tmpname,name); exit(1); }
+}
+
+/*-------------------------------------------------------------------------
+  Reads the checkpoint name into c.  Returns 0, or -1 if there is no
+  such file; exits if it is not a checkpoint of this decoder.
+ -------------------------------------------------------------------------*/
+int read_checkpoint(const char *name, SEASAT_checkpoint *c)
+{
+	FILE *fp;
+	unsigned char h[CKPT_HEADER_SIZE];
+	int version, size;
+
+	if ((fp = fopen(name,"rb")) == NULL) return(-1);
+	if (fread(h,CKPT_HEADER_SIZE,1,fp) != 1 || memcmp(h,CKPT_MAGIC,8) != 0) {
+	  printf("ERROR: %s is not a checkpoint\n",name); exit(1);
+	}
+	memcpy(&version,h+8,4);
+	memcpy(&size,h+12,4);
+	if (version != CKPT_VERSION || size != (int) sizeof(SEASAT_checkpoint)) {
+	  printf("ERROR: %s is a checkpoint of a different seasat_decoder (version %i, %i bytes)\n",name,version,size);
+	  exit(1);
+	}
+	if (fread(c,sizeof(SEASAT_checkpoint),1,fp) != 1) { printf("ERROR: checkpoint %s is short\n",name); exit(1); }
+	fclose(fp);
+	return(0);
+}
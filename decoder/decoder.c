@@ -5,144 +5,97 @@
 
 /*************************************************************************************
 Decode payload data into the output buffer
+
+  buf points at the byte holding the aux header byte, which starts bit_offset
+  bits in; the payload follows it.  Samples that would land past the end of
+  obuff are discarded and 1 is returned; the samples that do fit are still written.
 *************************************************************************************/
-int decode_payload(unsigned char *buf, unsigned char *obuff, int *optr)
+int decode_payload(const unsigned char *buf, int bit_offset, unsigned char *obuff, int *optr)
 {
-    int bufptr, j, which;
+    int n = SAMPLES_PER_FRAME;
+    int room = SAMPLES_PER_LINE+SAMPLES_PER_FRAME - *optr;
 
-    bufptr = 1;  /*start at beginning of valid data */
-    
-    for (j=0;j<SAMPLES_PER_FRAME;j++)  {
-      which = j%8;  /* which sample we are decoding */
-      if (bufptr >= INT_FRAME_LEN+1) printf("ERROR: bufptr = %i past end of buffer!!! \n",bufptr);
-      if ((*optr) >= SAMPLES_PER_LINE+SAMPLES_PER_FRAME) { return(1);   /* this is an error */ }
-      
-      switch (which) {
-    	case 0:  obuff[*optr] = buf[bufptr] >> 3;
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 break;
-    	case 1:  obuff[*optr] = ((buf[bufptr]&07)<<2) | (buf[bufptr+1]>>6);
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 bufptr++;
-    		 break;
-    	case 2:  obuff[*optr] = (buf[bufptr]&076)>>1;
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 break;
-    	case 3:  obuff[*optr] = ((buf[bufptr]&01)<<4) | ((buf[bufptr+1]&0360)>>4);
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 bufptr++;
-    		 break;
-    	case 4:  obuff[*optr] = ((buf[bufptr]&017)<<1) | ((buf[bufptr+1]&0200)>>7);
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 bufptr++;
-    		 break;
-    	case 5:  obuff[*optr] = (buf[bufptr]&0174)>>2;
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 break;
-    	case 6:  obuff[*optr] = ((buf[bufptr]&03)<<3) | ((buf[bufptr+1]&0340)>>5);
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 bufptr++;
-    		 break;
-    	case 7:  obuff[*optr] = buf[bufptr]&037;
-    		 if (obuff[*optr]>31) {
-    		    printf("ERROR: bad decode value %o (%i); case %i; obuff = %o\n",obuff[*optr],obuff[*optr],which,buf[bufptr]);
-    		 }
-    		 *optr+=1;
-    		 bufptr++;
-    		 break;
-      }
-    }
+    if (room < n) n = (room > 0) ? room : 0;
+    unpack_samples(buf,bit_offset+8,&obuff[*optr],n);   /* start at beginning of valid data */
+    *optr += n;
+    if (n < SAMPLES_PER_FRAME) return(1);   /* this is an error */
     return(0);
 }
 
 /*************************************************************************************
 Convert raw buffer into raw aux headers
+
+  The aux header byte starts bit_offset bits into buf[0]
 *************************************************************************************/
-void decode_headers(SEASAT_raw_header *r, unsigned char *buf, int *headers)
+void decode_headers(SEASAT_raw_header *r, const unsigned char *buf, int bit_offset, int *headers)
 {
+	unsigned char val;
+
+	if (bit_offset == 0) val = buf[0];
+	else val = buf[0] << bit_offset | buf[1] >> (8-bit_offset);
+
 	switch (*headers) {
 	  case 0:  
-	    	r->aux0->lsd_year = buf[0] >> 4;
-		r->aux0->station  = buf[0] & 017;
+	    	r->aux0->lsd_year = val >> 4;
+		r->aux0->station  = val & 017;
 		*headers+=1; 
 		/* display_aux(&r,0); */
 		break;   
 	  case 1:  
-	  	r->aux1->msec0 = buf[0];
+	  	r->aux1->msec0 = val;
 		*headers+=1; 
 		/* display_aux(&r,1); */
 	  	break;      
 	  case 2:  
-	        r->aux2->msec8 = buf[0];
+	        r->aux2->msec8 = val;
 		*headers+=1;
 		/* display_aux(&r,2); */
 	  	break;      
 	  case 3:
-	        r->aux3->msec16 = buf[0];
+	        r->aux3->msec16 = val;
 		*headers+=1; 
 		/* display_aux(&r,3); */
 	  	break;      
 	  case 4:  
-	        r->aux4->day_of_year0 = buf[0] >> 3;
-		r->aux4->msec24 = buf[0] & 007;
+	        r->aux4->day_of_year0 = val >> 3;
+		r->aux4->msec24 = val & 007;
 		*headers+=1; 
 		/* display_aux(&r,4); */
 	  	break;      
 	  case 5:  
-	        r->aux5->clock_drift0 = buf[0] >> 4;
-		r->aux5->day_of_year5 = buf[0] & 017;
+	        r->aux5->clock_drift0 = val >> 4;
+		r->aux5->day_of_year5 = val & 017;
 		*headers+=1; 
 		/* display_aux(&r,5); */
 	  	break;      
 	  case 6:
-	        r->aux6->clock_drift4 = buf[0];
+	        r->aux6->clock_drift4 = val;
 		*headers+=1; 
 		/* display_aux(&r,6); */
 	  	break;      
 	  case 7:
-	        r->aux7->scan_indicator = buf[0] >> 7;
-		r->aux7->bits_per_sample = (buf[0] & 0160) >> 4;
-		r->aux7->mfr_lock = (buf[0] & 010) >> 3;
-		r->aux7->prf_code = buf[0] & 007;
+	        r->aux7->scan_indicator = val >> 7;
+		r->aux7->bits_per_sample = (val & 0160) >> 4;
+		r->aux7->mfr_lock = (val & 010) >> 3;
+		r->aux7->prf_code = val & 007;
 		*headers+=1; 
 		/* display_aux(&r,7); */
 	  	break;      
 	  case 8:  
-	        r->aux8->delay_10 = buf[0] >> 4;
-		r->aux8->delay_1  = buf[0] & 017;
+	        r->aux8->delay_10 = val >> 4;
+		r->aux8->delay_1  = val & 017;
 		*headers+=1; 
 		/* display_aux(&r,8); */
 	  	break;      
 	  case 9:  
-	        r->aux9->scu_bit = (buf[0] & 200) >> 7;
-		r->aux9->sdf_bit = (buf[0] & 100) >> 6;
-		r->aux9->adc_bit = (buf[0] & 040) >> 5;
-		r->aux9->time_gate_bit = (buf[0] & 020) >> 4;
-		r->aux9->local_prf_bit = (buf[0] & 010) >> 3;
-		r->aux9->auto_prf_bit = (buf[0] & 004) >> 2;
-		r->aux9->prf_lock_bit = (buf[0] & 002) >> 1;
-		r->aux9->local_delay_bit = buf[0] & 001;
+	        r->aux9->scu_bit = (val & 200) >> 7;
+		r->aux9->sdf_bit = (val & 100) >> 6;
+		r->aux9->adc_bit = (val & 040) >> 5;
+		r->aux9->time_gate_bit = (val & 020) >> 4;
+		r->aux9->local_prf_bit = (val & 010) >> 3;
+		r->aux9->auto_prf_bit = (val & 004) >> 2;
+		r->aux9->prf_lock_bit = (val & 002) >> 1;
+		r->aux9->local_delay_bit = val & 001;
 		*headers += 1;
 		/* display_aux(&r,9);  */
 	  	break;      
@@ -307,28 +260,36 @@ void display_aux(SEASAT_raw_header *r, int field){
 /*************************************************************************************
   Dump all decoded header values to files
 *************************************************************************************/
-void dump_all_headers(FILE *fp_all_hdr,int major_cnt,long int major_sync_loc,SEASAT_header *s)
+/* the header of line major_cnt as it is written to the header file */
+void fill_header_ext(SEASAT_header_ext *h,int major_cnt,long int major_sync_loc,SEASAT_header *s)
 {
-  fprintf(fp_all_hdr,"%i %li %i %i %i %li %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n",
-    major_cnt,
-    major_sync_loc,
-    s->station_code,
-    s->lsd_year,
-    s->day_of_year,
-    s->msec,
-    s->clock_drift,
-    s->no_scan_indicator_bit,
-    s->bits_per_sample,
-    s->mfr_lock_bit,
-    s->prf_rate_code,
-    s->delay,
-    s->scu_bit,
-    s->sdf_bit,
-    s->adc_bit,
-    s->time_gate_bit,
-    s->local_prf_bit,
-    s->auto_prf_bit,
-    s->prf_lock_bit,
-    s->local_delay_bit);
+  h->major_cnt		  = major_cnt;
+  h->major_sync_loc	  = major_sync_loc;
+  h->station_code	  = s->station_code;
+  h->lsd_year		  = s->lsd_year;
+  h->day_of_year		  = s->day_of_year;
+  h->msec		  = s->msec;
+  h->clock_drift		  = s->clock_drift;
+  h->no_scan_indicator_bit = s->no_scan_indicator_bit;
+  h->bits_per_sample	  = s->bits_per_sample;
+  h->mfr_lock_bit	  = s->mfr_lock_bit;
+  h->prf_rate_code	  = s->prf_rate_code;
+  h->delay		  = s->delay;
+  h->scu_bit		  = s->scu_bit;
+  h->sdf_bit		  = s->sdf_bit;
+  h->adc_bit		  = s->adc_bit;
+  h->time_gate_bit	  = s->time_gate_bit;
+  h->local_prf_bit	  = s->local_prf_bit;
+  h->auto_prf_bit	  = s->auto_prf_bit;
+  h->prf_lock_bit	  = s->prf_lock_bit;
+  h->local_delay_bit	  = s->local_delay_bit;
+}
+
+void dump_all_headers(SEASAT_hdr_file *fp_all_hdr,int major_cnt,long int major_sync_loc,SEASAT_header *s)
+{
+  SEASAT_header_ext h;
+
+  fill_header_ext(&h,major_cnt,major_sync_loc,s);
+  write_header(fp_all_hdr,&h);
 }
 
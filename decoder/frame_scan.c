@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Frame walk by byte range
+
+  In threaded mode the main loop would still touch the raw file at every
+  minor frame: the sync code, the frame number byte and the next frame's
+  number byte.  Those reads are most of the walk's cost, so they are done
+  ahead of it by a pool of threads.  The raw file is cut into ranges of
+  SCAN_BYTES.  Each thread locks on to the first confirmed sync code in
+  its range and follows the frames to the end of the range, recording
+  for every frame where it starts, the bit errors in its sync code and
+  the two frame number bytes the main loop reads.
+
+  The frame tracker in the main loop still decides where each frame is.
+  It looks its frames up in the ranges in order, so a range joins on to
+  the one before wherever the tracker lands on a recorded frame - at
+  the first frame past the range edge, normally.  Any frame the range
+  walk placed differently (a missed short frame, a lock lost in another
+  spot) is read from the raw file as before, so the decoded output is
+  the same as a sequential run.  At most SCAN_AHEAD ranges per thread
+  are kept ahead of the main loop, each in its own slot; a slot is only
+  handed to a new range once the thread walking the old one is done.
+*************************************************************************************/
+
+#define SCAN_BYTES	(16L*1024*1024)		/* raw bytes in a range			*/
+#define SCAN_AHEAD	4			/* ranges per thread kept ahead		*/
+#define FRAME_BITS	1180
+#define SHORT_FRAME_BITS ((INT_FRAME_LEN-1)*8)
+#define NEXT_FRAMENO	(FRAME_BITS+24)		/* next frame number, either cadence	*/
+#define SCAN_MAX_MISSES	4			/* as TRACK_MAX_MISSES			*/
+
+typedef struct {
+	long	bit;			/* start of the frame			*/
+	short	next;			/* byte at bit+NEXT_FRAMENO, -1 past EOF */
+	unsigned char errors;		/* bit errors in the sync code		*/
+	unsigned char id;		/* fill flag and frame number		*/
+} frame_rec;
+
+typedef struct {
+	long	range;			/* range recorded here, -1 for none	*/
+	int	ready;
+	int	busy;			/* a thread is walking into this slot	*/
+	long	nrecs, max_recs;
+	frame_rec *recs;
+} scan_slot;
+
+static SEASAT_raw_input *scan_in = NULL;
+static long		 scan_start;	/* bit the first range starts at	*/
+static long		 nranges;
+static pthread_t	*scanners;
+static int		 nscanners;
+static scan_slot	*slots;
+static int		 nslots;
+static long		 next_range;	/* next range for a thread to walk	*/
+static long		 cur_range;	/* range the main loop is in		*/
+static int		 stopping;
+
+static scan_slot	*cur = NULL;	/* ... its slot, once walked		*/
+static long		 cur_rec;	/* record the main loop got to		*/
+static frame_rec	*hit = NULL;	/* the last frame it found here		*/
+static long		 reads, served;	/* raw file reads asked for, and answered here */
+
+static pthread_mutex_t	scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	range_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	slot_free = PTHREAD_COND_INITIALIZER;
+
+static void add_rec(scan_slot *s, long bit, int errors)
+{
+	frame_rec *f;
+
+	if (s->nrecs == s->max_recs) {
+	  s->max_recs = s->max_recs ? 2*s->max_recs : SCAN_BYTES*8/FRAME_BITS + 16;
+	  s->recs = (frame_rec *) realloc(s->recs,s->max_recs*sizeof(frame_rec));
+	  if (s->recs == NULL) { printf("ERROR: unable to allocate frame walk records\n"); exit(1); }
+	}
+	f = &s->recs[s->nrecs++];
+	f->bit = bit;
+	f->errors = errors;
+	f->id = raw_byte_at(scan_in,bit+24);
+	f->next = raw_byte_at(scan_in,bit+NEXT_FRAMENO);
+}
+
+/*-------------------------------------------------------------------------
+  Walks the frames that start in range k the way the tracker would: a
+  frame every 1180 bits, 1176 where only that sync code is there, carried
+  through misses and searched for again after SCAN_MAX_MISSES of them.
+ -------------------------------------------------------------------------*/
+static void walk_range(scan_slot *s, long k)
+{
+	long p = scan_start + k*SCAN_BYTES*8;
+	long end = p + SCAN_BYTES*8;
+	int e, misses = 0;
+
+	s->nrecs = 0;
+	if ((p = find_confirmed_sync(scan_in,p)) < 0) return;
+	while (p < end && raw_bytes(scan_in,p>>3,INT_FRAME_LEN) != NULL) {
+	  if ((e = sync_errors_at(scan_in,p)) <= BIT_ERRORS) misses = 0;
+	  else if (++misses >= SCAN_MAX_MISSES) {
+	    if ((p = find_confirmed_sync(scan_in,p - FRAME_BITS/2)) < 0) return;
+	    misses = 0;
+	    continue;
+	  }
+	  add_rec(s,p,e);
+	  if (sync_errors_at(scan_in,p+FRAME_BITS) > BIT_ERRORS &&
+	      sync_errors_at(scan_in,p+SHORT_FRAME_BITS) <= BIT_ERRORS) p += SHORT_FRAME_BITS;
+	  else p += FRAME_BITS;
+	}
+}
+
+static void *scan_worker(void *arg)
+{
+	scan_slot *s;
+	long k;
+
+	pthread_mutex_lock(&scan_lock);
+	for (;;) {
+	  /* wait for the slot to be let go by the main loop, and by any
+	     thread still walking a range the main loop skipped */
+	  while (!stopping && next_range < nranges &&
+	         (next_range >= cur_range + nslots || slots[next_range % nslots].busy))
+	    pthread_cond_wait(&slot_free,&scan_lock);
+	  if (stopping || next_range >= nranges) break;
+	  k = next_range++;
+	  s = &slots[k % nslots];
+	  s->ready = 0;
+	  s->busy = 1;
+	  pthread_mutex_unlock(&scan_lock);
+
+	  walk_range(s,k);
+
+	  pthread_mutex_lock(&scan_lock);
+	  s->range = k;
+	  s->ready = 1;
+	  s->busy = 0;
+	  pthread_cond_broadcast(&range_ready);
+	  pthread_cond_broadcast(&slot_free);
+	}
+	pthread_mutex_unlock(&scan_lock);
+	return(NULL);
+}
+
+/*-------------------------------------------------------------------------
+  Starts nthreads threads walking the mapped input in ahead of a frame
+  tracker that starts at start_bit.  Does nothing for a stream, whose
+  bytes are only there while the ring holds them.
+ -------------------------------------------------------------------------*/
+void start_frame_scan(SEASAT_raw_input *in, int nthreads, long start_bit)
+{
+	int i;
+
+	if (in->stream || nthreads < 1 || start_bit >= in->length*8) return;
+	sync_scan_kernel_name();	/* pick the scan kernel before any thread uses it */
+
+	scan_in = in;
+	scan_start = start_bit;
+	nranges = (in->length*8 - start_bit + SCAN_BYTES*8-1) / (SCAN_BYTES*8);
+	nscanners = nthreads;
+	nslots = SCAN_AHEAD*nthreads;
+	slots = (scan_slot *) calloc(nslots,sizeof(scan_slot));
+	scanners = (pthread_t *) malloc(nthreads*sizeof(pthread_t));
+	if (slots == NULL || scanners == NULL) { printf("ERROR: unable to allocate frame walk records\n"); exit(1); }
+	for (i=0; i<nslots; i++) slots[i].range = -1;
+	next_range = cur_range = 0;
+	stopping = 0;
+	cur = NULL;
+	cur_rec = 0;
+	hit = NULL;
+	reads = served = 0;
+
+	for (i=0; i<nthreads; i++)
+	  if (pthread_create(&scanners[i],NULL,scan_worker,NULL) != 0) {
+	    printf("ERROR: unable to start frame walk thread %i\n",i); exit(1);
+	  }
+}
+
+/* the recorded frame at bit, or NULL; ranges behind it are let go */
+static frame_rec *find_frame(long bit)
+{
+	long k, n;
+
+	if (bit < scan_start || (k = (bit-scan_start) / (SCAN_BYTES*8)) >= nranges || k < cur_range) return(NULL);
+	if (cur == NULL || k > cur_range) {
+	  pthread_mutex_lock(&scan_lock);
+	  if (k > cur_range) {
+	    cur_range = k;
+	    if (next_range < k) next_range = k;	/* the tracker skipped those */
+	    pthread_cond_broadcast(&slot_free);
+	  }
+	  cur = &slots[k % nslots];
+	  while (!(cur->ready && cur->range == k)) pthread_cond_wait(&range_ready,&scan_lock);
+	  pthread_mutex_unlock(&scan_lock);
+	  cur_rec = 0;
+	}
+
+	n = cur->nrecs;
+	while (cur_rec < n && cur->recs[cur_rec].bit < bit) cur_rec++;
+	if (cur_rec == n || cur->recs[cur_rec].bit != bit) return(NULL);
+	return(&cur->recs[cur_rec]);
+}
+
+/*-------------------------------------------------------------------------
+  Bit errors in the sync code at bit, from the range walk if it found a
+  frame there, otherwise from the raw file.
+ -------------------------------------------------------------------------*/
+int frame_sync_errors(SEASAT_raw_input *in, long bit)
+{
+	if (in == scan_in) {
+	  reads++;
+	  if ((hit = find_frame(bit)) != NULL) { served++; return(hit->errors); }
+	}
+	return(sync_errors_at(in,bit));
+}
+
+/*-------------------------------------------------------------------------
+  The byte at bit, as raw_byte_at.  The frame number byte of a frame
+  starting at bit-24, and the next frame's number byte, come from the
+  range walk if it found that frame.
+ -------------------------------------------------------------------------*/
+int frame_byte_at(SEASAT_raw_input *in, long bit)
+{
+	if (in == scan_in) {
+	  reads++;
+	  if (hit == NULL || (bit != hit->bit+24 && bit != hit->bit+NEXT_FRAMENO)) hit = find_frame(bit-24);
+	  if (hit != NULL) { served++; return(bit == hit->bit+24 ? hit->id : hit->next); }
+	}
+	return(raw_byte_at(in,bit));
+}
+
+void stop_frame_scan(void)
+{
+	int i;
+
+	if (scan_in == NULL) return;
+	pthread_mutex_lock(&scan_lock);
+	stopping = 1;
+	pthread_cond_broadcast(&slot_free);
+	pthread_mutex_unlock(&scan_lock);
+	for (i=0; i<nscanners; i++) pthread_join(scanners[i],NULL);
+	printf("Range walk on %i threads: %li of %li raw file reads done ahead\n",nscanners,served,reads);
+
+	for (i=0; i<nslots; i++) free(slots[i].recs);
+	free(slots);
+	free(scanners);
+	scan_in = NULL;
+	cur = NULL;
+	hit = NULL;
+}
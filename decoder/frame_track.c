@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Minor frame tracker
+
+  Minor frames follow each other every 1180 bits (147.5 bytes), except
+  for every 28435th frame which is only 147 bytes long.  The tracker
+  predicts where the next sync code has to be and only checks it there.
+  While it lines up the frames are simply handed out in order.  A few
+  misses in a row are carried through on the predicted cadence (a sync
+  code with more than BIT_ERRORS bit errors does not mean the frames
+  have moved).  After TRACK_MAX_MISSES misses the tracker searches for
+  the next sync code that is followed by LOCK_FRAMES more a frame apart,
+  all of them within LOCK_ERRORS bit errors, and carries on from there.
+  Where that lands in the 28435 frame cycle is not known, so until the
+  next 147 byte frame turns up it is told by its sync codes instead, as
+  the range walk does.
+*************************************************************************************/
+
+#define FRAME_BITS	  1180			/* 147.5 bytes			  */
+#define SHORT_FRAME_BITS  ((INT_FRAME_LEN-1)*8)	/* the 147 byte special case	  */
+#define CYCLE_FRAMES	  28434			/* frames before the short frame  */
+#define TRACK_MAX_MISSES  4			/* consecutive misses before lock is lost */
+#define LOCK_FRAMES	  4			/* syncs that must follow a new lock	  */
+#define LOCK_ERRORS	  3			/* bit errors allowed in each of those	  */
+
+void init_frame_tracker(SEASAT_frame_tracker *t, long start_bit)
+{
+	memset(t,0,sizeof(SEASAT_frame_tracker));
+	t->bit = start_bit;
+	t->aligned = -1;
+}
+
+/*-------------------------------------------------------------------------
+  A sync code at bit followed by LOCK_FRAMES more a frame apart.  Noise
+  has a sync code within BIT_ERRORS of it every 30 bits or so, so the
+  whole run has to be within the tighter LOCK_ERRORS to count.
+ -------------------------------------------------------------------------*/
+static int confirmed_sync(SEASAT_raw_input *in, long bit)
+{
+	int i;
+
+	for (i=0; i<=LOCK_FRAMES; i++)
+	  if (sync_errors_at(in,bit+i*FRAME_BITS) > LOCK_ERRORS) return(0);
+	return(1);
+}
+
+/* the first confirmed sync code at or after bit, or -1 */
+long find_confirmed_sync(SEASAT_raw_input *in, long bit)
+{
+	int be;
+
+	while ((bit = find_next_sync(in,bit,&be)) >= 0 && !confirmed_sync(in,bit)) bit++;
+	return(bit);
+}
+
+/*-------------------------------------------------------------------------
+  Returns the bit offset of the next minor frame, or -1 when there is
+  no whole frame left in the file.  Sets t->aligned as read_cnt used to:
+  1 for a byte aligned frame, 0 for a nibble aligned one and 2 for the
+  147 byte frame.
+ -------------------------------------------------------------------------*/
+long track_next_frame(SEASAT_frame_tracker *t, SEASAT_raw_input *in)
+{
+	long p = t->bit;
+	long c;
+
+	if (raw_bytes(in,p>>3,INT_FRAME_LEN) == NULL) return(-1);
+	t->frames++;
+
+	if ((t->errors = frame_sync_errors(in,p)) <= BIT_ERRORS) {
+	  t->verified++;
+	  t->misses = 0;
+	} else {
+	  t->missed++;
+	  if (++t->misses >= TRACK_MAX_MISSES) {
+	    /* lost it - look for the frames again, starting half a frame back */
+	    t->losses++;
+	    c = find_confirmed_sync(in,p - FRAME_BITS/2);
+	    if (c < 0 || raw_bytes(in,c>>3,INT_FRAME_LEN) == NULL) {
+	      t->bit = in->length*8;
+	      return(-1);
+	    }
+	    t->reacquired++;
+	    if (c > p) t->skipped_bits += c-p;	/* it may lock on a little behind */
+	    t->misses = 0;
+	    t->rephase = 1;
+	    t->errors = sync_errors_at(in,c);
+	    p = c;
+	  }
+	}
+
+	/* a 147 byte frame where only the 1176 bit sync code is there */
+	if (t->rephase) {
+	  if (sync_errors_at(in,p+FRAME_BITS) > BIT_ERRORS &&
+	      sync_errors_at(in,p+SHORT_FRAME_BITS) <= BIT_ERRORS) { t->cnt = CYCLE_FRAMES; t->rephase = 0; }
+	  else if (t->cnt == CYCLE_FRAMES) t->cnt = 0;
+	}
+
+	/* the frame cadence, as it was worked out from read_cnt */
+	if (t->cnt == CYCLE_FRAMES) { t->aligned = 2; t->cnt = 0; t->bit = p + SHORT_FRAME_BITS; }
+	else {
+	  t->aligned = (t->cnt%2 == 0) ? 1 : 0;
+	  t->cnt++;
+	  t->bit = p + FRAME_BITS;
+	}
+	return(p);
+}
+
+/*-------------------------------------------------------------------------
+  Frame number of the frame after the one just handed out.  Following
+  the 147 byte frame this has always been read half a byte further on
+  than the frame starts, and it is kept that way so the frame number
+  fixes come out the same.  -1 if the file ends before it.
+ -------------------------------------------------------------------------*/
+int track_next_frameno(SEASAT_frame_tracker *t, SEASAT_raw_input *in)
+{
+	long bit = t->bit + 24 + (t->aligned==2 ? 4 : 0);
+	int c = frame_byte_at(in,bit);
+
+	return(c >= 0 ? c & 0177 : get_next_frameno(in,bit));
+}
+
+/*-------------------------------------------------------------------------
+  Restarts the tracker on the minor frame at bit, cnt frames after the
+  last 147 byte frame (as tracker_frame_cnt gave for it).
+ -------------------------------------------------------------------------*/
+void seek_frame_tracker(SEASAT_frame_tracker *t, long bit, int cnt)
+{
+	init_frame_tracker(t,bit);
+	t->cnt = cnt;
+}
+
+/* frames between the last 147 byte frame and the frame just handed out */
+int tracker_frame_cnt(SEASAT_frame_tracker *t)
+{
+	return(t->aligned == 2 ? CYCLE_FRAMES : t->cnt-1);
+}
+
+/*-------------------------------------------------------------------------
+  Frame number repair, as worked out for the decoder's main loop.  Takes
+  the frame number read from the current minor frame and the one read
+  from the next, and returns the frame number to use.  lock is set while
+  a datatake is being decoded; line is only used in messages.  The caller
+  resets the history when it locks on to a datatake and notes the end of
+  each line (see SEASAT_frame_fixer).
+ -------------------------------------------------------------------------*/
+void init_frame_fixer(SEASAT_frame_fixer *f, int display, int report)
+{
+	memset(f,0,sizeof(SEASAT_frame_fixer));
+	f->this_frame = f->last_frame = f->l2_frame = f->l3_frame = -1;
+	f->last_max_frame_no = -1;
+	f->frames_this_line = -1;
+	f->display = display;
+	f->report = report;
+}
+
+int fix_frame_no(SEASAT_frame_fixer *f, int frame_no, int next_frame, int lock, int line)
+{
+    int this_frame;
+
+    if (f->frames++ > 0) {
+        f->l3_frame = f->l2_frame;
+	f->l2_frame = f->last_frame;
+      	f->last_frame = f->this_frame;
+    }
+    this_frame = frame_no;
+
+    /* Check for bit errors in frame no 0 as this causes BIG problems 
+     ---------------------------------------------------------------*/
+    if ((this_frame-f->last_frame)!=1 && this_frame != 0 && (frame_no!=127 || next_frame!=127)) {  
+
+	/* if the next frame is 1 and last was either 59 or 60, 
+	   assume this is frame zero... might be a bad assumption???  
+	  ---------------------------------------------------------*/
+	if (next_frame==1 && (f->last_frame==59 || f->last_frame==60)) { 
+	    if (f->display)
+	        printf("1: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 000\n",
+	    	f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame);
+	    this_frame = 0; f->fixed++;
+	}
+	
+	/* if  (next_frame-f->last_frame)==2, put this_frame in sequence 
+	 -----------------------------------------------------------*/
+	else if (next_frame - f->last_frame == 2) {
+	    if (f->display)
+	        printf("2: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO %3.3i\n",
+	    	f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame,f->last_frame+1);
+	  this_frame = f->last_frame+1; f->fixed++;
+	}
+	
+	/* if last two frames are in sequence, put this one in sequence
+	 -------------------------------------------------------------*/
+	else if (((f->l2_frame-f->l3_frame==1) || (f->l2_frame-f->l3_frame)%59 == 0 || (f->l2_frame-f->l3_frame)%60 == 0)
+		 && (f->last_frame-f->l2_frame==1)) {
+	  /* - can't ever have two lines in a row that have 60 minor frames
+	     - otherwise, we are good to set this frame into sequence */
+	  if (f->last_max_frame_no<60 || f->last_frame < 59) { 
+    	    if (f->display)
+	        printf("3: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO %3.3i\n",
+	    	f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame,f->last_frame+1);
+	    this_frame=f->last_frame+1; f->fixed++;
+	  } else { 
+	    /* If the last frame was either 59 or 60, then this HAS to be frame zero
+	     ------------------------------------------------------------------------*/
+    	    if (f->display)
+	        printf("4: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 000\n",
+	    	f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame);
+	    this_frame=0; f->fixed++;
+	  }
+	} 
+	
+	/* if last2 and last3 frames are in sequence and last frame 
+	   is ZERO, then set this frame to 1
+	 ---------------------------------------------------------*/
+	else if ((f->l2_frame-f->l3_frame==1) && (f->last_frame==0)) {
+	  if (f->display)
+            printf("5: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 001\n",
+	    	f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame);
+	  this_frame = 1; f->fixed++;
+	}
+	
+	/* If we got to here, then we did not fix the error
+	 -------------------------------------------------*/
+	else if (lock==1) {
+	    if (f->report) printf("6: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; NOT FIXED!! (Line %i)\n",
+	    	f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame,line);
+	    f->non_fixed++;
+	}
+    }
+     
+    /* Check for bad frame zeros!  This can only be frame ZERO if the
+       last frame was 59 or greater and the next frame is 1.
+       -- Update - this condition doesn't allow 1/2 lines to exist,
+          but they do exist in the raw files!!!
+     -------------------------------------------------------------- */
+    if (lock==1 && this_frame==0 && abs(this_frame-f->last_frame)<59 && next_frame!=1) {
+      if (f->display)
+   	  printf("7: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO %3.3i\n",
+   	      f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame,f->last_frame+1);
+      this_frame = f->last_frame+1; f->fixed++;
+    }
+
+    if (lock==1) f->frames_this_line++;
+
+    /* We can NEVER have a frame number greater than 60!!!
+     ----------------------------------------------------*/
+    if (lock==1 && this_frame > 60 && f->frames_this_line>59) {
+      if (f->display)
+	    printf("8: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 000\n",
+	    f->l3_frame,f->l2_frame,f->last_frame,this_frame,next_frame);
+	this_frame=0; f->fixed++;
+    }        
+
+    f->this_frame = this_frame;
+    return(this_frame);
+}
+
+void print_tracker_stats(SEASAT_frame_tracker *t)
+{
+	printf("Tracked %li frames: %li syncs verified; %li missed; lock lost %i times, %i reacquired (%li bits skipped)\n",
+		t->frames,t->verified,t->missed,t->losses,t->reacquired,t->skipped_bits);
+	printf("Sync scan kernel: %s\n",sync_scan_kernel_name());
+}
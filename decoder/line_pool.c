@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Threaded payload decoding
+
+  The frame walk and frame number repair in the main loop are inherently
+  sequential, but they are cheap (and the raw reads behind the walk are
+  done ahead of it by range, see frame_scan.c).  The expensive part - unpacking 13680
+  samples a line and writing them out - only depends on where each frame
+  of the line sits in the raw file.  So in threaded mode the main loop
+  records the bit offset of the frame behind every 228 sample slot of a
+  line, and batches of consecutive lines are unpacked from the mapped
+  input and written with pwrite by a pool of worker threads.  Each batch
+  starts on a major frame boundary, so the output is byte for byte the
+  same as a sequential run.  For a packed (.pdat) file each line is
+  packed again after it is unpacked and written after the file header.
+  Quality records (-q) are written by the same worker, since the sample
+  histogram needs the unpacked line.
+*************************************************************************************/
+
+#define LINES_PER_BATCH 32
+
+typedef struct {
+	int	fd;				/* output file for this batch 		*/
+	long	first_line;			/* line number of the first line	*/
+	int	nlines;
+	long	slot_bit[LINES_PER_BATCH][SLOTS_PER_LINE];
+	unsigned char *obuff;			/* LINES_PER_BATCH decoded lines	*/
+	unsigned char *pbuff;			/* ... packed, for a .pdat file		*/
+	int	qual_fd;			/* quality file, or -1			*/
+	SEASAT_line_quality q[LINES_PER_BATCH];	/* ... the lines' records		*/
+	SEASAT_sample_stats *stats;		/* ... whose samples are summed here	*/
+} line_batch;
+
+static SEASAT_raw_input *pool_in = NULL;
+static int		 pool_packed = 0;
+static pthread_t	*workers;
+static int		 nworkers = 0;
+static line_batch	*batches;
+static int		 nbatches;
+
+static line_batch	**free_list;	/* batches ready for the main thread	*/
+static int		 nfree;
+static line_batch	**work_list;	/* batches waiting for a worker (FIFO)	*/
+static int		 work_head, work_cnt;
+static int		 busy;		/* batches being decoded right now	*/
+static int		 stopping;
+static line_batch	*current = NULL;	/* batch being filled by the main thread */
+
+static pthread_mutex_t	pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	batch_done = PTHREAD_COND_INITIALIZER;
+
+/*-------------------------------------------------------------------------
+  Unpacks and writes one batch of lines.  A slot offset of -1 means the
+  slot was never filled, which gives zeros just as in obuff.
+ -------------------------------------------------------------------------*/
+static void decode_batch(line_batch *b)
+{
+	int i, j;
+	long len = (long) b->nlines * SAMPLES_PER_LINE;
+	long where = b->first_line*SAMPLES_PER_LINE;
+	unsigned char *optr, *out = b->obuff;
+	long start;
+
+	if (stats_on) start = stat_clock();
+	for (i=0; i<b->nlines; i++)
+	  for (j=0; j<SLOTS_PER_LINE; j++) {
+	    optr = &b->obuff[(long)i*SAMPLES_PER_LINE + j*SAMPLES_PER_FRAME];
+	    if (b->slot_bit[i][j] < 0) memset(optr,0,SAMPLES_PER_FRAME);
+	    else unpack_samples(pool_in->data + (b->slot_bit[i][j]>>3),
+	    			b->slot_bit[i][j]&7,optr,SAMPLES_PER_FRAME);
+	  }
+
+	if (pool_packed) {
+	  pack_samples(b->obuff,b->pbuff,b->nlines*SAMPLES_PER_LINE);
+	  out = b->pbuff;
+	  len = (long) b->nlines * PACKED_LINE_BYTES;
+	  where = PDAT_HEADER_SIZE + b->first_line*PACKED_LINE_BYTES;
+	}
+	if (stats_on) stat_thread_time(STAT_UNPACK,start,0);
+	io_throttle_begin();
+	if (stats_on) start = stat_clock();
+	if (pwrite(b->fd,out,len,where) != len) {
+	  printf("ERROR: unable to write %i decoded lines at line %li\n",b->nlines,b->first_line);
+	  exit(1);
+	}
+	if (stats_on) stat_thread_time(STAT_WRITE,start,len);
+	if (b->qual_fd >= 0) {
+	  for (i=0; i<b->nlines; i++)
+	    line_histogram(&b->obuff[(long)i*SAMPLES_PER_LINE],SAMPLES_PER_LINE,b->q[i].hist);
+	  pwrite_quality(b->qual_fd,b->first_line,b->q,b->nlines);
+	}
+	io_throttle_end();
+}
+
+static void *line_worker(void *arg)
+{
+	line_batch *b;
+	int i;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+	  while (work_cnt == 0 && !stopping) pthread_cond_wait(&work_ready,&pool_lock);
+	  if (work_cnt == 0) break;
+	  b = work_list[work_head];
+	  work_head = (work_head+1) % nbatches;
+	  work_cnt--;
+	  busy++;
+	  pthread_mutex_unlock(&pool_lock);
+
+	  decode_batch(b);
+
+	  pthread_mutex_lock(&pool_lock);
+	  if (b->qual_fd >= 0)
+	    for (i=0; i<b->nlines; i++) add_line_stats(b->stats,b->q[i].hist);
+	  busy--;
+	  free_list[nfree++] = b;
+	  pthread_cond_signal(&batch_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return(NULL);
+}
+
+/* hands the batch being filled to the workers */
+static void submit_current(void)
+{
+	if (current == NULL) return;
+	pthread_mutex_lock(&pool_lock);
+	work_list[(work_head+work_cnt) % nbatches] = current;
+	work_cnt++;
+	pthread_cond_signal(&work_ready);
+	pthread_mutex_unlock(&pool_lock);
+	current = NULL;
+}
+
+/*-------------------------------------------------------------------------
+  Starts nthreads workers decoding from the mapped input in.  packed
+  writes the lines packed, after a PDAT_HEADER_SIZE byte file header.
+ -------------------------------------------------------------------------*/
+void start_line_writers(SEASAT_raw_input *in, int nthreads, int packed)
+{
+	int i;
+
+	if (nthreads < 1) nthreads = 1;
+	unpack_kernel_name();		/* pick the unpack kernel before any thread uses it */
+
+	pool_in = in;
+	pool_packed = packed;
+	nworkers = nthreads;
+	nbatches = 2*nthreads;
+	batches = (line_batch *) calloc(nbatches,sizeof(line_batch));
+	free_list = (line_batch **) malloc(nbatches*sizeof(line_batch *));
+	work_list = (line_batch **) malloc(nbatches*sizeof(line_batch *));
+	workers = (pthread_t *) malloc(nthreads*sizeof(pthread_t));
+	if (batches==NULL || free_list==NULL || work_list==NULL || workers==NULL) {
+	  printf("ERROR: unable to allocate line writer buffers\n"); exit(1);
+	}
+	for (i=0; i<nbatches; i++) {
+	  batches[i].obuff = (unsigned char *) malloc(LINES_PER_BATCH*SAMPLES_PER_LINE);
+	  if (packed) batches[i].pbuff = (unsigned char *) malloc(LINES_PER_BATCH*PACKED_LINE_BYTES);
+	  if (batches[i].obuff == NULL || (packed && batches[i].pbuff == NULL)) { printf("ERROR: unable to allocate line writer buffers\n"); exit(1); }
+	  free_list[i] = &batches[i];
+	}
+	nfree = nbatches;
+	work_head = work_cnt = busy = stopping = 0;
+
+	for (i=0; i<nthreads; i++)
+	  if (pthread_create(&workers[i],NULL,line_worker,NULL) != 0) {
+	    printf("ERROR: unable to start line writer thread %i\n",i); exit(1);
+	  }
+}
+
+/*-------------------------------------------------------------------------
+  Queues line number line of the file open on fd.  slot_bit gives the bit
+  offset in the raw file of the first sample of each 228 sample slot of
+  the line, or -1 for an empty slot.  If qual_fd is not -1, the line's
+  quality record q is written to it too, with the histogram of the line
+  filled in once it is decoded, and the histogram is added to stats.
+ -------------------------------------------------------------------------*/
+void queue_line(int fd, long line, const long *slot_bit, int qual_fd, const SEASAT_line_quality *q,
+		SEASAT_sample_stats *stats)
+{
+	if (current != NULL && (current->fd != fd || current->first_line+current->nlines != line))
+	  submit_current();
+
+	if (current == NULL) {
+	  pthread_mutex_lock(&pool_lock);
+	  while (nfree == 0) pthread_cond_wait(&batch_done,&pool_lock);
+	  current = free_list[--nfree];
+	  pthread_mutex_unlock(&pool_lock);
+	  current->fd = fd;
+	  current->qual_fd = qual_fd;
+	  current->stats = stats;
+	  current->first_line = line;
+	  current->nlines = 0;
+	}
+
+	memcpy(current->slot_bit[current->nlines],slot_bit,SLOTS_PER_LINE*sizeof(long));
+	if (qual_fd >= 0) current->q[current->nlines] = *q;
+	current->nlines++;
+	if (current->nlines == LINES_PER_BATCH) submit_current();
+}
+
+/*-------------------------------------------------------------------------
+  Waits until every queued line has been written.  Must be called before
+  the output file is closed or removed.  Does nothing if no workers run.
+ -------------------------------------------------------------------------*/
+void flush_line_writers(void)
+{
+	if (nworkers == 0) return;
+	submit_current();
+	pthread_mutex_lock(&pool_lock);
+	while (work_cnt > 0 || busy > 0) pthread_cond_wait(&batch_done,&pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void stop_line_writers(void)
+{
+	int i;
+
+	if (nworkers == 0) return;
+	flush_line_writers();
+	pthread_mutex_lock(&pool_lock);
+	stopping = 1;
+	pthread_cond_broadcast(&work_ready);
+	pthread_mutex_unlock(&pool_lock);
+	for (i=0; i<nworkers; i++) pthread_join(workers[i],NULL);
+
+	for (i=0; i<nbatches; i++) { free(batches[i].obuff); free(batches[i].pbuff); }
+	free(batches); free(free_list); free(work_list); free(workers);
+	nworkers = 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "seasat.h"
+
+#define RING_SIZE   (16L<<20)	/* look-ahead buffer when reading a stream	*/
+#define RING_BEHIND (1L<<20)	/* bytes kept behind the oldest position asked for */
+#define READ_CHUNK  (1L<<20)	/* most bytes asked of read() at a time		*/
+
+/*-------------------------------------------------------------------------
+ Sets up the look-ahead ring for a stream.  The ring is mapped twice,
+ back to back, so that any RING_SIZE bytes of it can be read through a
+ plain pointer even where they wrap around.
+ -------------------------------------------------------------------------*/
+static int open_ring(SEASAT_raw_input *in)
+{
+	unsigned char *base;
+	int mfd;
+
+	if ((mfd = memfd_create("seasat_raw_ring",0)) < 0) return(-1);
+	if (ftruncate(mfd,RING_SIZE) != 0) { close(mfd); return(-1); }
+	base = (unsigned char *) mmap(NULL,2*RING_SIZE,PROT_NONE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if (base == MAP_FAILED) { close(mfd); return(-1); }
+	if (mmap(base,RING_SIZE,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_FIXED,mfd,0) == MAP_FAILED ||
+	    mmap(base+RING_SIZE,RING_SIZE,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_FIXED,mfd,0) == MAP_FAILED) {
+	  munmap(base,2*RING_SIZE); close(mfd); return(-1);
+	}
+	close(mfd);
+	in->data = base;
+	in->stream = 1;
+	return(0);
+}
+
+/*-------------------------------------------------------------------------
+ Opens a raw SEASAT file.  A regular file is mapped into memory so that
+ the frame walker can work from a pointer and an offset instead of going
+ through stdio.  "-" (standard input), a pipe or anything else that can
+ not be mapped is read as a stream through a look-ahead ring; its length
+ is only known once the end of the stream is reached.
+ Returns 0 on success, -1 on failure.
+ -------------------------------------------------------------------------*/
+int open_raw_input(const char *name, SEASAT_raw_input *in)
+{
+	struct stat sb;
+
+	in->data = NULL;
+	in->length = 0;
+	in->pos = 0;
+	in->stream = 0;
+	in->eof = 1;
+	if (strcmp(name,"-") == 0) in->fd = dup(0);
+	else in->fd = open(name,O_RDONLY);
+	if (in->fd < 0) return(-1);
+	if (fstat(in->fd,&sb) != 0) { close(in->fd); return(-1); }
+
+	if (S_ISREG(sb.st_mode)) {
+	  in->length = sb.st_size;
+	  if (in->length == 0) return(0);
+	  in->data = (unsigned char *) mmap(NULL,in->length,PROT_READ,MAP_PRIVATE,in->fd,0);
+	  if (in->data != MAP_FAILED) {
+	    /* we walk the file front to back exactly once */
+	    madvise(in->data,in->length,MADV_SEQUENTIAL);
+	    madvise(in->data,in->length,MADV_WILLNEED);
+	    return(0);
+	  }
+	  in->data = NULL;
+	  in->length = 0;
+	}
+
+	if (open_ring(in) != 0) { close(in->fd); return(-1); }
+	in->eof = 0;
+	return(0);
+}
+
+/*-------------------------------------------------------------------------
+ Reads the stream until byte end is in the ring or the stream ends.
+ Nothing at or after byte keep is overwritten.
+ -------------------------------------------------------------------------*/
+static void fill_ring(SEASAT_raw_input *in, long keep, long end)
+{
+	long limit, n;
+
+	if (keep < 0) keep = 0;
+	limit = keep + RING_SIZE;
+	if (end > limit) {
+	  printf("ERROR: asked for %li bytes of look-ahead; the stream buffer only holds %li\n",end-keep,RING_SIZE);
+	  exit(1);
+	}
+	while (in->length < end && !in->eof) {
+	  n = limit - in->length;
+	  if (n > READ_CHUNK) n = READ_CHUNK;
+	  n = read(in->fd,in->data + in->length%RING_SIZE,n);
+	  if (n > 0) in->length += n;
+	  else if (n == 0) in->eof = 1;
+	  else if (errno != EINTR) { printf("ERROR: unable to read input stream\n"); exit(1); }
+	}
+}
+
+/*-------------------------------------------------------------------------
+ Returns a pointer to len bytes starting at byte offset loc of the raw
+ file, or NULL if those bytes run past the end of the file.  For a
+ stream the pointer stays good until the reader moves RING_SIZE-RING_BEHIND
+ bytes further on.
+ -------------------------------------------------------------------------*/
+const unsigned char *raw_bytes(SEASAT_raw_input *in, long loc, int len)
+{
+	if (loc < 0) return(NULL);
+	if (!in->stream) {
+	  if (loc+len > in->length) return(NULL);
+	  return(in->data+loc);
+	}
+
+	if (loc+len > in->length && !in->eof) fill_ring(in,loc-RING_BEHIND,loc+len);
+	if (loc+len > in->length) return(NULL);
+	if (loc < in->length-RING_SIZE) {
+	  printf("ERROR: byte %li of the input stream is no longer buffered\n",loc);
+	  exit(1);
+	}
+	return(in->data + loc%RING_SIZE);
+}
+
+/*-------------------------------------------------------------------------
+ Returns the 8 bits starting at bit offset bit of the raw file, or -1 if
+ they run past the end of the file.
+ -------------------------------------------------------------------------*/
+int raw_byte_at(SEASAT_raw_input *in, long bit)
+{
+	const unsigned char *p;
+
+	if ((bit&7) == 0) {
+	  if ((p = raw_bytes(in,bit>>3,1)) == NULL) return(-1);
+	  return(p[0]);
+	}
+	if ((p = raw_bytes(in,bit>>3,2)) == NULL) return(-1);
+	return((p[0] << (bit&7) | p[1] >> (8-(bit&7))) & 0377);
+}
+
+void close_raw_input(SEASAT_raw_input *in)
+{
+	if (in->data != NULL) {
+	  if (in->stream) munmap(in->data,2*RING_SIZE);
+	  else munmap(in->data,in->length);
+	}
+	if (in->fd >= 0) close(in->fd);
+	in->data = NULL;
+	in->fd = -1;
+}
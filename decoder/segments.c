@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Patch aligned segment files
+
+  ROI focuses a swath in patches: each azimuth FFT block of PATCH_LINES
+  lines gives PATCH_GOOD good lines, and the next patch starts PATCH_GOOD
+  lines after the last.  With -S the decoder also cuts each output file
+  into segments of a whole number of patches, which overlap by the
+  PATCH_LINES-PATCH_GOOD lines the next patch needs from the one before:
+
+	segment k	lines k*step to k*step+length-1 of the output file
+	step		patches*PATCH_GOOD
+	length		step + PATCH_LINES-PATCH_GOOD
+
+  so the patches of one segment follow on from those of the last, and
+  create_roi_in (patches = nl/PATCH_GOOD) sees exactly the patches asked
+  for.  A segment is <outfile>_NNN_SSS.dat (or .pdat) with its own slice
+  of the headers, renumbered from 1, in <outfile>_NNN_SSS.hdr (or .hdrb).
+
+  A segment is cut as soon as its last line is written, on a thread of
+  its own, so focusing can start on it while decoding goes on.  The
+  lines are copied out of the output file with copy_file_bytes (dat_io.c):
+  copy_file_range, which shares the blocks where the file system can,
+  and pread/pwrite where it can not.  Once a segment is complete it is added to the list
+  <outfile>_NNN.seg:
+
+	SEGMENT  FIRST  LINES  PATCHES
+
+  FIRST being its first line in the output file (from 1).  Whatever is
+  left at the end of the output file goes into one last, shorter segment,
+  if it has lines not in the segment before.  If the output file is
+  thrown away, so are its segments.
+*************************************************************************************/
+
+typedef struct {
+	char	datname[256];		/* output file the lines are cut from	*/
+	char	segdat[300], seghdr[300];
+	char	listname[300];
+	long	first, nlines;		/* lines of the output file (from 0)	*/
+	SEASAT_header_ext *hdr;		/* ... and their headers		*/
+} seg_job;
+
+static int	   seg_open = 0;
+static char	   seg_base[256];	/* <outfile>_NNN			*/
+static char	   seg_datname[256];
+static const char *seg_dat_ext, *seg_hdr_ext;
+static int	   seg_packed;
+static long	   seg_step, seg_length;
+static long	   seg_lines;		/* lines of the output file so far	*/
+static int	   seg_started;		/* segments with their first line in	*/
+static int	   seg_cut;		/* ... and handed to the cutter		*/
+static SEASAT_header_ext *seg_hdr[2];	/* headers of the (at most) two segments open */
+
+static pthread_t   cutter;
+static int	   cutting = 0;
+static seg_job	   job;
+
+static void seg_names(int k, char *dat, char *hdr)
+{
+	sprintf(dat,"%s_%3.3i.%s",seg_base,k,seg_dat_ext);
+	sprintf(hdr,"%s_%3.3i.%s",seg_base,k,seg_hdr_ext);
+}
+
+static void *cut_segment(void *arg)
+{
+	seg_job *j = (seg_job *) arg;
+	unsigned char h[PDAT_HEADER_SIZE];
+	long line_bytes = seg_packed ? PACKED_LINE_BYTES : SAMPLES_PER_LINE;
+	long start = seg_packed ? PDAT_HEADER_SIZE : 0;
+	long patches;
+	SEASAT_hdr_file *fp_hdr;
+	FILE *fp_list;
+	int fd_in, fd_out, i;
+
+	fd_in = open(j->datname,O_RDONLY);
+	fd_out = open(j->segdat,O_WRONLY|O_CREAT|O_TRUNC,0644);
+	if (fd_in < 0 || fd_out < 0) { printf("ERROR: unable to open segment %s\n",j->segdat); exit(1); }
+	if (seg_packed) {
+	  make_pdat_header(h);
+	  if (write(fd_out,h,PDAT_HEADER_SIZE) != PDAT_HEADER_SIZE) { printf("ERROR: unable to write segment %s\n",j->segdat); exit(1); }
+	}
+	if (copy_file_bytes(fd_in,start+j->first*line_bytes,fd_out,start,j->nlines*line_bytes) != 0) {
+	  printf("ERROR: unable to write segment %s\n",j->segdat); exit(1);
+	}
+	close(fd_in);
+	if (close(fd_out) != 0) { printf("ERROR: unable to write segment %s\n",j->segdat); exit(1); }
+
+	fp_hdr = open_hdr_file(j->seghdr,"w");
+	if (fp_hdr == NULL) { printf("ERROR: unable to open output file %s\n",j->seghdr); exit(1); }
+	for (i=0; i<j->nlines; i++) {
+	  j->hdr[i].major_cnt = i+1;
+	  write_header(fp_hdr,&j->hdr[i]);
+	}
+	close_hdr_file(fp_hdr);
+	free(j->hdr);
+	j->hdr = NULL;
+
+	/* only now is the segment listed as there */
+	patches = (j->nlines - (PATCH_LINES-PATCH_GOOD)) / PATCH_GOOD;
+	fp_list = fopen(j->listname,"a");
+	if (fp_list == NULL) { printf("ERROR: unable to open output file %s\n",j->listname); exit(1); }
+	fprintf(fp_list,"%s\t%li\t%li\t%li\n",j->segdat,j->first+1,j->nlines,patches < 0 ? 0 : patches);
+	fclose(fp_list);
+	printf("Segment %s ready - lines %li to %li, %li patches\n",j->segdat,j->first+1,j->first+j->nlines,
+		patches < 0 ? 0 : patches);
+	return(NULL);
+}
+
+static void wait_cutter(void)
+{
+	if (!cutting) return;
+	pthread_join(cutter,NULL);
+	cutting = 0;
+}
+
+/* hands segment k, lines first to first+nlines-1, to the cutter once they are on the disk */
+static void start_cut(int k, long first, long nlines)
+{
+	flush_line_writers();
+	flush_async_writer();
+	wait_cutter();
+
+	strcpy(job.datname,seg_datname);
+	seg_names(k,job.segdat,job.seghdr);
+	sprintf(job.listname,"%s.seg",seg_base);
+	job.first = first;
+	job.nlines = nlines;
+	job.hdr = seg_hdr[k%2];
+	seg_hdr[k%2] = NULL;
+	if (pthread_create(&cutter,NULL,cut_segment,&job) != 0) { printf("ERROR: unable to start segment cutter\n"); exit(1); }
+	cutting = 1;
+	seg_cut = k+1;
+}
+
+/*-------------------------------------------------------------------------
+  Starts cutting the output file datname, just opened, into segments of
+  patches patches named after base (<outfile>_NNN).  dat_ext and hdr_ext
+  are the extensions of the output and header files; packed is set for
+  a .pdat output file.
+ -------------------------------------------------------------------------*/
+void open_segments(const char *base, const char *datname, int patches, const char *dat_ext,
+		   const char *hdr_ext, int packed)
+{
+	char name[300];
+
+	wait_cutter();
+	strcpy(seg_base,base);
+	strcpy(seg_datname,datname);
+	seg_dat_ext = dat_ext;
+	seg_hdr_ext = hdr_ext;
+	seg_packed = packed;
+	seg_step = (long) patches*PATCH_GOOD;
+	seg_length = seg_step + PATCH_LINES-PATCH_GOOD;
+	seg_lines = 0;
+	seg_started = seg_cut = 0;
+	seg_hdr[0] = seg_hdr[1] = NULL;
+	sprintf(name,"%s.seg",seg_base);
+	remove(name);			/* one from an earlier run would not go with this file */
+	seg_open = 1;
+}
+
+/*-------------------------------------------------------------------------
+  Takes the header of the next line of the output file, once the line
+  itself has been queued for writing.  Does nothing without -S.
+ -------------------------------------------------------------------------*/
+void add_segment_line(const SEASAT_header_ext *h)
+{
+	int k;
+
+	if (!seg_open) return;
+	if (seg_lines % seg_step == 0) {
+	  k = seg_started++;
+	  seg_hdr[k%2] = (SEASAT_header_ext *) malloc(seg_length*sizeof(SEASAT_header_ext));
+	  if (seg_hdr[k%2] == NULL) { printf("ERROR: unable to allocate segment headers\n"); exit(1); }
+	}
+	for (k=seg_cut; k<seg_started; k++) seg_hdr[k%2][seg_lines-k*seg_step] = *h;
+	seg_lines++;
+	if (seg_lines == seg_cut*seg_step + seg_length) start_cut(seg_cut,seg_cut*seg_step,seg_length);
+}
+
+/*-------------------------------------------------------------------------
+  Finishes the segments of the output file.  With keep, the rest of its
+  lines are cut into a last segment; without, the output file is being
+  thrown away and its segments are removed.  Returns the number of
+  segments kept.  Does nothing without -S.
+ -------------------------------------------------------------------------*/
+int close_segments(int keep)
+{
+	char dat[300], hdr[300];
+	long first;
+	int k;
+
+	if (!seg_open) return(0);
+	seg_open = 0;
+	k = seg_cut;
+	if (keep && k < seg_started) {
+	  first = k*seg_step;
+	  /* the last segment, if it has lines the one before does not */
+	  if (k == 0 || seg_lines > first + seg_length-seg_step) start_cut(k,first,seg_lines-first);
+	}
+	wait_cutter();
+	free(seg_hdr[0]);
+	free(seg_hdr[1]);
+	seg_hdr[0] = seg_hdr[1] = NULL;
+
+	if (!keep) {
+	  for (k=0; k<seg_cut; k++) {
+	    seg_names(k,dat,hdr);
+	    remove(dat);
+	    remove(hdr);
+	  }
+	  sprintf(dat,"%s.seg",seg_base);
+	  remove(dat);
+	  return(0);
+	}
+	printf("Cut %s into %i segments of %li lines (%s.seg)\n",seg_datname,seg_cut,seg_length,seg_base);
+	return(seg_cut);
+}
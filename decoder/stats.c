@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Decoder instrumentation
+
+  With -I the decoder times where it spends its time and counts what it
+  gets through, and writes it all out every so many seconds and once
+  more at the end, one JSON object a line, to <outfile>.stats:
+
+	elapsed_s		seconds since decoding started
+	final			true for the last one
+	input_bytes, input_mb_per_s	raw file read so far
+	frames, frames_per_s	minor frames found
+	lines, lines_per_s	range lines written
+	output_bytes, output_mb_per_s	decoded lines written to the disk
+	stage_s			main thread seconds in each stage:
+				  sync		finding and tracking the frames
+				  frame_repair	frame number repair
+				  headers	decoding the header bytes
+				  payload	unpacking the samples (or, with -t,
+						noting where they are)
+				  output	handing lines to the writers, and
+						waiting when they fall behind
+				  other		the rest of the main loop
+	writer_s		seconds the writer threads spent unpacking
+				(with -t) and writing, all threads together
+	sync			syncs verified and missed, times the lock was
+				lost and found again, bytes skipped doing so
+	frame_numbers		frame numbers repaired and left bad
+	sync_bit_errors		frames with 0, 1, ... SYNC_BITS bit errors in
+				their sync code
+
+  The stages are laps of CLOCK_MONOTONIC, taken only when -I is given;
+  without it the decoder pays for no more than a test of stats_on.  A
+  clock read costs about as much as tracking a frame, so the main loop
+  times only one frame in STAT_SAMPLE and counts it STAT_SAMPLE times
+  over, less what the clock reads themselves take.  Frames that start a line or close an output file are timed in
+  full from the frame repair on, since the lines are handed out and the
+  files flushed on those.  Writer threads add their times with atomic
+  adds.
+*************************************************************************************/
+
+#define SYNC_BITS	24		/* bits in the minor frame sync code	*/
+
+int stats_on = 0;
+
+static FILE *fp_stats = NULL;
+static long  period_ns;			/* report this often, 0 only at the end */
+static long  start_ns, next_ns;
+static long  now_ns;			/* time of the last lap			*/
+static long  weight = 1;		/* frames the one being timed stands for */
+static long  clock_ns;			/* what a lap costs			*/
+static long  stage_ns[STAT_STAGES];
+static long  out_bytes;			/* added by the writer threads		*/
+static long  error_hist[SYNC_BITS+1];
+
+static const SEASAT_frame_tracker *st_track;	/* where the decoder keeps its counts */
+static const SEASAT_frame_fixer *st_fix;
+static const long *st_in_pos;
+static const int  *st_frames, *st_lines;
+
+static const char *stage_name[STAT_STAGES] = { "sync", "frame_repair", "headers", "payload", "output", "unpack", "write" };
+
+long stat_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return(ts.tv_sec*1000000000L + ts.tv_nsec);
+}
+
+/*-------------------------------------------------------------------------
+  Starts the instrumentation, reporting to the file name every period
+  seconds (0 for only at the end).  The reports take the raw file
+  position, frames found and lines written from in_pos, frames and
+  lines, and the sync and frame number counts from t and f, all of
+  which have to stay put for the run.  The last report is written on
+  exit, however the decoder stops.  Exits if name can not be written.
+ -------------------------------------------------------------------------*/
+void start_stats(const char *name, int period, const SEASAT_frame_tracker *t, const SEASAT_frame_fixer *f,
+		 const long *in_pos, const int *frames, const int *lines)
+{
+	int i;
+
+	fp_stats = fopen(name,"w");
+	if (fp_stats == NULL) { printf("ERROR: unable to open output file %s\n",name); exit(1); }
+	memset(stage_ns,0,sizeof(stage_ns));
+	memset(error_hist,0,sizeof(error_hist));
+	out_bytes = 0;
+	start_ns = stat_clock();
+	for (i=0; i<1000; i++) stat_clock();
+	clock_ns = (stat_clock() - start_ns) / 1001;
+	period_ns = period*1000000000L;
+	start_ns = now_ns = stat_clock();
+	next_ns = start_ns + period_ns;
+	st_track = t;
+	st_fix = f;
+	st_in_pos = in_pos;
+	st_frames = frames;
+	st_lines = lines;
+	stats_on = 1;
+	atexit(stop_stats);
+}
+
+/* starts timing a frame that stands for w frames; returns the start of its first lap */
+long stat_begin(int w)
+{
+	weight = w;
+	now_ns = stat_clock();
+	return(now_ns);
+}
+
+/* adds the time since lap to stage; returns the time now, the start of the next lap */
+long stat_lap(int stage, long lap)
+{
+	now_ns = stat_clock();
+	if (now_ns - lap > clock_ns) stage_ns[stage] += weight*(now_ns - lap - clock_ns);
+	return(now_ns);
+}
+
+/* adds time spent since start by a writer thread to stage, having written bytes */
+void stat_thread_time(int stage, long start, long bytes)
+{
+	__atomic_add_fetch(&stage_ns[stage],stat_clock()-start,__ATOMIC_RELAXED);
+	if (bytes) __atomic_add_fetch(&out_bytes,bytes,__ATOMIC_RELAXED);
+}
+
+/* notes the bit errors in the sync code of a frame handed out */
+void stat_frame(int errors)
+{
+	error_hist[errors < 0 ? 0 : errors > SYNC_BITS ? SYNC_BITS : errors]++;
+}
+
+/* a report is due, by the time of the last lap */
+int stat_due(void)
+{
+	return(period_ns > 0 && now_ns >= next_ns);
+}
+
+/* writes one report of where the run stands */
+void report_stats(int final)
+{
+	const SEASAT_frame_tracker *t = st_track;
+	const SEASAT_frame_fixer *f = st_fix;
+	long in_bytes = *st_in_pos, frames = *st_frames, lines = *st_lines;
+	long now = stat_clock(), written = __atomic_load_n(&out_bytes,__ATOMIC_RELAXED);
+	double secs = (now - start_ns) / 1e9, other;
+	int i;
+
+	if (fp_stats == NULL) return;
+	if (secs <= 0) secs = 1e-9;
+	other = secs;
+	for (i=0; i<=STAT_OUTPUT; i++) other -= stage_ns[i] / 1e9;
+
+	fprintf(fp_stats,"{\"elapsed_s\": %.3f, \"final\": %s, ",secs,final ? "true" : "false");
+	fprintf(fp_stats,"\"input_bytes\": %li, \"input_mb_per_s\": %.2f, ",in_bytes,in_bytes/secs/1e6);
+	fprintf(fp_stats,"\"frames\": %li, \"frames_per_s\": %.0f, ",frames,frames/secs);
+	fprintf(fp_stats,"\"lines\": %li, \"lines_per_s\": %.1f, ",lines,lines/secs);
+	fprintf(fp_stats,"\"output_bytes\": %li, \"output_mb_per_s\": %.2f, ",written,written/secs/1e6);
+	fprintf(fp_stats,"\"stage_s\": {");
+	for (i=0; i<=STAT_OUTPUT; i++) fprintf(fp_stats,"\"%s\": %.3f, ",stage_name[i],stage_ns[i]/1e9);
+	fprintf(fp_stats,"\"other\": %.3f}, ",other < 0 ? 0.0 : other);
+	fprintf(fp_stats,"\"writer_s\": {\"unpack\": %.3f, \"write\": %.3f}, ",
+		__atomic_load_n(&stage_ns[STAT_UNPACK],__ATOMIC_RELAXED)/1e9,
+		__atomic_load_n(&stage_ns[STAT_WRITE],__ATOMIC_RELAXED)/1e9);
+	fprintf(fp_stats,"\"sync\": {\"verified\": %li, \"missed\": %li, \"losses\": %i, \"reacquired\": %i, \"skipped_bytes\": %li}, ",
+		t->verified,t->missed,t->losses,t->reacquired,t->skipped_bits/8);
+	fprintf(fp_stats,"\"frame_numbers\": {\"fixed\": %i, \"unfixed\": %i}, ",f->fixed,f->non_fixed);
+	fprintf(fp_stats,"\"sync_bit_errors\": [");
+	for (i=0; i<=SYNC_BITS; i++) fprintf(fp_stats,"%li%s",error_hist[i],i < SYNC_BITS ? ", " : "");
+	fprintf(fp_stats,"]}\n");
+	fflush(fp_stats);
+
+	if (period_ns > 0) while (next_ns <= now) next_ns += period_ns;
+}
+
+/* the final report, best once the writers have stopped */
+void stop_stats(void)
+{
+	if (!stats_on) return;
+	report_stats(1);
+	fclose(fp_stats);
+	fp_stats = NULL;
+	stats_on = 0;
+}
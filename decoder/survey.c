@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Survey of raw files
+
+  Finds the datatakes in raw files without decoding any payload, for
+  deciding what to process.  The frames are walked with the frame tracker
+  as in a decode, but only the frame number of each is looked at, and
+  repaired the same way, to find where the range lines and datatakes
+  start and end.  The headers are decoded for just a few lines:
+  the first three of the datatake and of every stride lines after that,
+  and the last three, which are gone back to once the end is found.  Header times often have bit errors, so each
+  time reported is the median of three lines, the day the median of the
+  first three, and the year and station the most common of all of them.
+
+  Which datatakes would be kept follows the decoder: until one is kept
+  the first line of each has to say 1978, else the decoder drops that
+  line and starts over on the next one (major_cnt 1 in test.c); after
+  that it is only a matter of more than KEEP_LINES lines.
+
+  Each datatake becomes one line of a CSV catalog, or one object of a
+  JSON one if the catalog name ends in .json.
+*************************************************************************************/
+
+#define KEEP_LINES	10000	/* seasat_decoder throws shorter datatakes away	*/
+#define SAMPLE_LINES	3	/* lines in a row sampled for a median time	*/
+
+typedef struct {
+	long	bit;		/* first minor frame of the line		*/
+	int	cnt;		/* tracker cadence count of that frame		*/
+} line_start;
+
+typedef struct {
+	int	number;		/* datatake in the file, counting from 0	*/
+	int	output;		/* _NNN the decoder would give it, or -1	*/
+	long	first_byte, last_byte;
+	long	lines;
+	int	year, day, station;
+	long	start_msec, end_msec;
+	int	samples;	/* lines whose headers were decoded		*/
+	int	station_votes[16];
+	int	year_votes[16];
+	long	days[SAMPLE_LINES];	/* day of year of the first lines	*/
+	long	msec[SAMPLE_LINES];	/* the sample group being filled	*/
+	int	nmsec;
+	line_start last[SAMPLE_LINES];	/* the latest line starts, a ring	*/
+} datatake;
+
+/*-------------------------------------------------------------------------
+  Decodes the headers of the line whose first minor frame is at bit,
+  cnt frames after the last 147 byte frame.  Returns 0, or -1 if the
+  file ends first.
+ -------------------------------------------------------------------------*/
+static int sample_line(SEASAT_raw_input *in, long bit, int cnt, SEASAT_header *s)
+{
+	SEASAT_frame_tracker t;
+	SEASAT_raw_header r;
+	SEASAT_aux_0 a0; SEASAT_aux_1 a1; SEASAT_aux_2 a2; SEASAT_aux_3 a3; SEASAT_aux_4 a4;
+	SEASAT_aux_5 a5; SEASAT_aux_6 a6; SEASAT_aux_7 a7; SEASAT_aux_8 a8; SEASAT_aux_9 a9;
+	const unsigned char *buf;
+	long p;
+	int headers = 0;
+
+	r.aux0 = &a0; r.aux1 = &a1; r.aux2 = &a2; r.aux3 = &a3; r.aux4 = &a4;
+	r.aux5 = &a5; r.aux6 = &a6; r.aux7 = &a7; r.aux8 = &a8; r.aux9 = &a9;
+
+	seek_frame_tracker(&t,bit,cnt);
+	while (headers < 10) {
+	  if ((p = track_next_frame(&t,in)) < 0) return(-1);
+	  if ((buf = raw_bytes(in,(p>>3)+4,2)) == NULL) return(-1);
+	  decode_headers(&r,buf,p&7,&headers);
+	}
+	decode_raw(&r,s);
+	return(0);
+}
+
+static long median3(long *v, int n)
+{
+	long a = v[0], b = v[1], c = v[2];
+
+	if (n == 1) return(a);
+	if (n == 2) return(a < b ? a : b);
+	if (a > b) { long t = a; a = b; b = t; }
+	if (b > c) b = c;
+	return(a > b ? a : b);
+}
+
+/* notes the headers of one sampled line */
+static void add_sample(datatake *d, SEASAT_header *s)
+{
+	d->samples++;
+	d->station_votes[s->station_code & 017]++;
+	d->year_votes[s->lsd_year & 017]++;
+	d->msec[d->nmsec++] = s->msec;
+	if (d->samples <= SAMPLE_LINES) d->days[d->samples-1] = s->day_of_year;
+	if (d->samples == SAMPLE_LINES) {
+	  d->start_msec = median3(d->msec,SAMPLE_LINES);
+	  d->day = median3(d->days,SAMPLE_LINES);
+	}
+	if (d->nmsec == SAMPLE_LINES) d->nmsec = 0;
+}
+
+/* the most common of 16 values */
+static int vote(const int *votes)
+{
+	int k, best = 0;
+
+	for (k=1; k<16; k++) if (votes[k] > votes[best]) best = k;
+	return(best);
+}
+
+static void write_entry(FILE *fp, int json, int first, const char *name, datatake *d)
+{
+	if (!json) {
+	  fprintf(fp,"%s,%i,%i,%li,%li,%li,%i,%i,%i,%li,%li,%i\n",name,d->number,d->output,
+	  	d->first_byte,d->last_byte,d->lines,d->year,d->day,d->station,d->start_msec,d->end_msec,d->output>=0);
+	  return;
+	}
+	fprintf(fp,"%s  {\"file\": \"%s\", \"datatake\": %i, \"output\": %i, \"first_byte\": %li, \"last_byte\": %li,\n",
+		first ? "" : ",\n",name,d->number,d->output,d->first_byte,d->last_byte);
+	fprintf(fp,"   \"lines\": %li, \"year\": %i, \"day\": %i, \"station\": %i, \"start_msec\": %li, \"end_msec\": %li,\n",
+		d->lines,d->year,d->day,d->station,d->start_msec,d->end_msec);
+	fprintf(fp,"   \"samples\": %i, \"kept\": %s}",d->samples,d->output>=0 ? "true" : "false");
+}
+
+/*-------------------------------------------------------------------------
+  Finishes datatake d, which ended just before byte end, and adds it to
+  the catalog.
+ -------------------------------------------------------------------------*/
+static void close_datatake(SEASAT_raw_input *in, datatake *d, long end, int *outputs,
+			FILE *fp, int json, int *entries, const char *name)
+{
+	SEASAT_header s;
+	long i, n = 0;
+
+	if (d->samples > 0 && d->samples < SAMPLE_LINES) {
+	  d->start_msec = median3(d->msec,d->samples);
+	  d->day = median3(d->days,d->samples);
+	}
+
+	/* the end time from the last lines */
+	for (i=(d->lines > SAMPLE_LINES ? d->lines-SAMPLE_LINES : 0); i<d->lines; i++)
+	  if (sample_line(in,d->last[i%SAMPLE_LINES].bit,d->last[i%SAMPLE_LINES].cnt,&s) == 0) {
+	    d->msec[n++] = s.msec;
+	    d->station_votes[s.station_code & 017]++;
+	    d->year_votes[s.lsd_year & 017]++;
+	  }
+	if (n > 0) d->end_msec = median3(d->msec,n);
+	d->station = vote(d->station_votes);
+	if (d->samples+n > 0) d->year = 1970 + vote(d->year_votes);
+
+	d->last_byte = end-1;
+	d->output = d->lines > KEEP_LINES ? (*outputs)++ : -1;
+	write_entry(fp,json,*entries==0,name,d);
+	(*entries)++;
+	printf("  datatake %i: %li lines, bytes %li to %li, day %i %li to %li msec%s\n",d->number,d->lines,
+		d->first_byte,d->last_byte,d->day,d->start_msec,d->end_msec,d->output>=0 ? "" : " (too short - not kept)");
+}
+
+/*-------------------------------------------------------------------------
+  Surveys the raw file name, taking the headers of every stride'th
+  line, and adds its datatakes to the catalog open on fp.  *entries
+  counts the catalog entries so far.  Returns the number of datatakes,
+  or -1 if the file can not be opened.
+ -------------------------------------------------------------------------*/
+static int survey_raw_file(const char *name, int stride, FILE *fp, int json, int *entries)
+{
+	SEASAT_raw_input in;
+	SEASAT_frame_tracker track;
+	SEASAT_header s;
+	SEASAT_frame_fixer fix;
+	datatake d;
+	long bit;
+	int tmpc, frame_no, next_frame, this_frame, sampled;
+	int lock = 0, year_checked = 0;
+	int ndatatakes = 0, outputs = 0;
+
+	if (open_raw_input(name,&in) != 0) return(-1);
+	printf("Surveying %s\n",name);
+	init_frame_tracker(&track,0);
+	init_frame_fixer(&fix,0,0);
+	memset(&d,0,sizeof(d));
+
+	while ((bit = track_next_frame(&track,&in)) >= 0) {
+	  if ((tmpc = raw_byte_at(&in,bit+24)) < 0) break;
+	  frame_no = tmpc & 0177;
+	  if (raw_bytes(&in,(track.bit>>3)+4,1) == NULL) break;	/* no next frame number - the end */
+	  next_frame = track_next_frameno(&track,&in);
+	  this_frame = fix_frame_no(&fix,frame_no,next_frame,lock,d.lines);
+
+	  /* a new range line, as the decoder sees it */
+	  if (this_frame == 0) {
+	    if (!lock) {
+	      memset(&d,0,sizeof(d));
+	      d.number = ndatatakes++;
+	      d.first_byte = bit>>3;
+	      fix.last_frame = fix.l2_frame = fix.l3_frame = -1;
+	      lock = 1;
+	    } else fix.last_max_frame_no = fix.last_frame;
+	    fix.frames_this_line = 1;
+
+	    d.last[d.lines%SAMPLE_LINES].bit = bit;
+	    d.last[d.lines%SAMPLE_LINES].cnt = tracker_frame_cnt(&track);
+	    d.lines++;
+	    sampled = (d.lines-1)%stride < SAMPLE_LINES && sample_line(&in,bit,tracker_frame_cnt(&track),&s) == 0;
+	    if (sampled) add_sample(&d,&s);
+
+	    /* the decoder's check of the first line it keeps */
+	    if (!year_checked && d.lines == 1 && sampled) {
+	      if (1970+s.lsd_year != 1978) {
+	        printf("  line at byte %li says year %i - the decoder drops it and starts over\n",bit>>3,1970+s.lsd_year);
+	        ndatatakes--;
+	        lock = 0;
+	        continue;
+	      }
+	      year_checked = 1;
+	    }
+	  }
+
+	  /* frame #127 twice is the sentinel the decoder drops the lock on */
+	  if (lock && frame_no == 127 && next_frame == 127) {
+	    close_datatake(&in,&d,bit>>3,&outputs,fp,json,entries,name);
+	    lock = 0;
+	  }
+	}
+	if (lock) close_datatake(&in,&d,track.bit>>3,&outputs,fp,json,entries,name);
+
+	close_raw_input(&in);
+	return(ndatatakes);
+}
+
+/*-------------------------------------------------------------------------
+  Surveys the nfiles raw files in files into the catalog named catalog.
+  Returns the number of files that could not be read.
+ -------------------------------------------------------------------------*/
+int survey_raw_files(const char *catalog, int stride, int nfiles, char **files)
+{
+	FILE *fp;
+	int i, n, json, entries = 0, failed = 0;
+
+	n = strlen(catalog);
+	json = (n >= 5 && strcmp(catalog+n-5,".json") == 0);
+	if ((fp = fopen(catalog,"w")) == NULL) { printf("ERROR: unable to open catalog %s\n",catalog); exit(1); }
+	if (json) fprintf(fp,"[\n");
+	else fprintf(fp,"file,datatake,output,first_byte,last_byte,lines,year,day,station,start_msec,end_msec,kept\n");
+
+	for (i=0; i<nfiles; i++) {
+	  if ((n = survey_raw_file(files[i],stride,fp,json,&entries)) < 0) {
+	    printf("ERROR: unable to open input file %s - skipped\n",files[i]);
+	    failed++;
+	  }
+	  else if (n == 0) printf("  no datatakes found\n");
+	}
+
+	if (json) fprintf(fp,"%s]\n",entries ? "\n" : "");
+	fclose(fp);
+	printf("Wrote %i datatakes from %i files to %s\n",entries,nfiles-failed,catalog);
+	return(failed);
+}
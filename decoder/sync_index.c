@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat.h"
+
+/*************************************************************************************
+  Raw file sync index
+
+  While a raw file is decoded, every range line that goes into an output
+  file can be noted in a small sidecar file: where its first minor frame
+  starts, where the frame cadence stands, which output file and line it
+  became and its time.  A later run can then start the frame tracker
+  right on the first line it wants instead of walking the file from the
+  start (see the -x, -l and -m options of seasat_decoder).
+
+	    file header, 32 bytes:
+		char  magic[8]		"SEASATSX"
+		int32 version		SIDX_VERSION
+		int32 header_size	32
+		int32 record_size	32
+		int32 spare
+		int64 nrecs		number of records
+
+	    records, 32 bytes each, in the order the lines were decoded:
+		int64 bit		bit offset of the line's first minor frame;
+					the byte is major_sync_loc, bit&7 the phase
+		int64 msec
+		int32 dataset		output file number (_NNN)
+		int32 line		line number as in the header file
+		int32 cnt		frames since the last 147 byte frame
+		int16 aligned		1 byte aligned, 0 nibble aligned, 2 147 bytes
+		int16 spare
+
+  All values are little endian.  Lines of an output file that is thrown
+  away (too short, bad start time) are held back and never written.
+*************************************************************************************/
+
+#define SIDX_MAGIC	  "SEASATSX"
+#define SIDX_VERSION	  1
+#define SIDX_HEADER_SIZE  32
+#define SIDX_RECORD_SIZE  32
+
+static FILE		*fp_index = NULL;
+static long		 nwritten = 0;
+static SEASAT_sync_entry *pending = NULL;	/* lines of the output file still open */
+static long		 npending = 0, max_pending = 0;
+
+static void put_le(unsigned char *p, long v, int n)
+{
+	int i;
+	for (i=0; i<n; i++) { p[i] = v & 0377; v >>= 8; }
+}
+
+static long get_le(const unsigned char *p, int n)
+{
+	long v = 0;
+	int i;
+	for (i=n-1; i>=0; i--) v = (v << 8) | p[i];
+	if (n < 8 && (v >> (8*n-1)) & 1) v -= 1L << (8*n);	/* sign extend */
+	return(v);
+}
+
+static void write_index_header(void)
+{
+	unsigned char h[SIDX_HEADER_SIZE];
+
+	memset(h,0,SIDX_HEADER_SIZE);
+	memcpy(h,SIDX_MAGIC,8);
+	put_le(h+8,SIDX_VERSION,4);
+	put_le(h+12,SIDX_HEADER_SIZE,4);
+	put_le(h+16,SIDX_RECORD_SIZE,4);
+	put_le(h+24,nwritten,8);
+	fseek(fp_index,0,SEEK_SET);
+	fwrite(h,SIDX_HEADER_SIZE,1,fp_index);
+	fseek(fp_index,0,SEEK_END);
+}
+
+/*-------------------------------------------------------------------------
+  Starts writing the sync index name.  Returns 0, or -1 if the file can
+  not be opened.
+ -------------------------------------------------------------------------*/
+int open_sync_index(const char *name)
+{
+	if ((fp_index = fopen(name,"wb")) == NULL) return(-1);
+	nwritten = npending = 0;
+	write_index_header();
+	return(0);
+}
+
+/* notes one line of the output file being written */
+void add_sync_entry(const SEASAT_sync_entry *e)
+{
+	if (fp_index == NULL) return;
+	if (npending == max_pending) {
+	  max_pending = max_pending ? 2*max_pending : 16384;
+	  pending = (SEASAT_sync_entry *) realloc(pending,max_pending*sizeof(SEASAT_sync_entry));
+	  if (pending == NULL) { printf("ERROR: unable to allocate sync index\n"); exit(1); }
+	}
+	pending[npending++] = *e;
+}
+
+/* the output file was kept - write its lines to the index */
+void keep_sync_entries(void)
+{
+	unsigned char r[SIDX_RECORD_SIZE];
+	long i;
+
+	if (fp_index == NULL) return;
+	for (i=0; i<npending; i++) {
+	  memset(r,0,SIDX_RECORD_SIZE);
+	  put_le(r,pending[i].bit,8);
+	  put_le(r+8,pending[i].msec,8);
+	  put_le(r+16,pending[i].dataset,4);
+	  put_le(r+20,pending[i].line,4);
+	  put_le(r+24,pending[i].cnt,4);
+	  put_le(r+28,pending[i].aligned,2);
+	  if (fwrite(r,SIDX_RECORD_SIZE,1,fp_index) != 1) { printf("ERROR: unable to write sync index\n"); exit(1); }
+	}
+	nwritten += npending;
+	npending = 0;
+	write_index_header();		/* the index is good even if the decoder stops dead */
+}
+
+/* the output file was thrown away - forget its lines */
+void drop_sync_entries(void)
+{
+	npending = 0;
+}
+
+void close_sync_index(void)
+{
+	if (fp_index == NULL) return;
+	write_index_header();
+	fclose(fp_index);
+	fp_index = NULL;
+	free(pending);
+	pending = NULL;
+	max_pending = 0;
+	printf("Wrote %li lines to the sync index\n",nwritten);
+}
+
+/*-------------------------------------------------------------------------
+  Reads the whole sync index name.  Returns the entries and sets *n, or
+  exits if the file is not a sync index.
+ -------------------------------------------------------------------------*/
+SEASAT_sync_entry *read_sync_index(const char *name, long *n)
+{
+	FILE *fp;
+	unsigned char h[SIDX_HEADER_SIZE], r[SIDX_RECORD_SIZE];
+	SEASAT_sync_entry *e;
+	long i, nrecs;
+
+	if ((fp = fopen(name,"rb")) == NULL) { printf("ERROR: unable to open sync index %s\n",name); exit(1); }
+	if (fread(h,SIDX_HEADER_SIZE,1,fp) != 1 || memcmp(h,SIDX_MAGIC,8) != 0) {
+	  printf("ERROR: %s is not a sync index\n",name); exit(1);
+	}
+	if (get_le(h+8,4) != SIDX_VERSION || get_le(h+16,4) != SIDX_RECORD_SIZE) {
+	  printf("ERROR: %s is a version %li sync index; expected version %i\n",name,get_le(h+8,4),SIDX_VERSION);
+	  exit(1);
+	}
+	nrecs = get_le(h+24,8);
+	fseek(fp,get_le(h+12,4),SEEK_SET);
+
+	e = (SEASAT_sync_entry *) malloc((nrecs ? nrecs : 1)*sizeof(SEASAT_sync_entry));
+	if (e == NULL) { printf("ERROR: unable to allocate sync index\n"); exit(1); }
+	for (i=0; i<nrecs; i++) {
+	  if (fread(r,SIDX_RECORD_SIZE,1,fp) != 1) { printf("ERROR: sync index %s is short\n",name); exit(1); }
+	  e[i].bit     = get_le(r,8);
+	  e[i].msec    = get_le(r+8,8);
+	  e[i].dataset = get_le(r+16,4);
+	  e[i].line    = get_le(r+20,4);
+	  e[i].cnt     = get_le(r+24,4);
+	  e[i].aligned = get_le(r+28,2);
+	}
+	fclose(fp);
+	*n = nrecs;
+	return(e);
+}
+
+/*-------------------------------------------------------------------------
+  Entry of line line of output file dataset, or -1 if it is not indexed.
+ -------------------------------------------------------------------------*/
+long find_sync_line(const SEASAT_sync_entry *e, long n, int dataset, int line)
+{
+	long lo = 0, hi = n, mid;
+
+	/* entries are in decoding order, so (dataset,line) only ever increases */
+	while (lo < hi) {
+	  mid = (lo+hi)/2;
+	  if (e[mid].dataset < dataset || (e[mid].dataset == dataset && e[mid].line < line)) lo = mid+1;
+	  else hi = mid;
+	}
+	if (lo < n && e[lo].dataset == dataset && e[lo].line == line) return(lo);
+	return(-1);
+}
+
+/*-------------------------------------------------------------------------
+  First entry from entry from on that is timed inside start..end msec
+  (inside 1) or outside it (inside 0), or n if there is none.  Header
+  times often have bit errors, a few lines at a time, so the entry has
+  to be followed by TIME_RUN-1 more that are the same way.
+ -------------------------------------------------------------------------*/
+#define TIME_RUN 5
+
+long find_sync_time(const SEASAT_sync_entry *e, long n, long from, long start, long end, int inside)
+{
+	long i, run = 0;
+
+	for (i=from; i<n; i++) {
+	  if ((e[i].msec >= start && e[i].msec <= end) == inside) run++;
+	  else run = 0;
+	  if (run == TIME_RUN || (run > 0 && i == n-1)) return(i-run+1);
+	}
+	return(n);
+}
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/*************************************************************************************
+  Sync word search at every bit phase
+
+  Scores the 24 bit sync code 0xF9A8ED against the raw stream starting at
+  every bit, not just at byte and nibble boundaries, and reports every
+  position within BIT_ERRORS bits of it.  Positions are bit offsets from
+  the start of the raw file; the hits come back in increasing order.
+*************************************************************************************/
+
+#define SYNC_WORD 0xF9A8EDu
+#define SCAN_BLOCK (1L<<20)		/* bytes scanned per call by find_next_sync */
+
+typedef int (*scan_fn)(const unsigned char *data, long length, long *b, long bend,
+			long start_bit, long end_bit, SEASAT_sync_hit *hits, int nhits, int max_hits);
+
+static scan_fn scan_kernel = NULL;
+static const char *scan_name = "none";
+
+/* 64 bit big endian window at byte b, zero filled past the end of the file */
+static inline unsigned long long load_window(const unsigned char *data, long length, long b)
+{
+	unsigned long long w = 0;
+	int i;
+
+	if (b+8 <= length) {
+	  for (i=0; i<8; i++) w = (w << 8) | data[b+i];
+	} else {
+	  for (i=0; i<8; i++) w = (w << 8) | (b+i < length ? data[b+i] : 0);
+	}
+	return(w);
+}
+
+/*-------------------------------------------------------------------------
+  One 64 bit window holds every 24 bit candidate starting in its first
+  5 bytes, so a window gives 40 candidates at once.
+ -------------------------------------------------------------------------*/
+static inline __attribute__((always_inline))
+int scan_scalar_body(const unsigned char *data, long length, long *b, long bend,
+		long start_bit, long end_bit, SEASAT_sync_hit *hits, int nhits, int max_hits)
+{
+	unsigned long long w;
+	long t;
+	int j, d;
+
+	for (; *b < bend; *b += 5) {
+	  w = load_window(data,length,*b);
+	  for (j=0; j<40; j++) {
+	    d = __builtin_popcount((unsigned int)((w >> (40-j)) & 0xFFFFFF) ^ SYNC_WORD);
+	    if (d > BIT_ERRORS) continue;
+	    t = *b*8 + j;
+	    if (t < start_bit || t >= end_bit) continue;
+	    hits[nhits].bit = t;
+	    hits[nhits].errors = d;
+	    if (++nhits == max_hits) return(nhits);
+	  }
+	}
+	return(nhits);
+}
+
+static int scan_scalar(const unsigned char *data, long length, long *b, long bend,
+		long start_bit, long end_bit, SEASAT_sync_hit *hits, int nhits, int max_hits)
+{
+	return(scan_scalar_body(data,length,b,bend,start_bit,end_bit,hits,nhits,max_hits));
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* Same as scan_scalar, but with the popcnt instruction */
+__attribute__((target("popcnt")))
+static int scan_popcnt(const unsigned char *data, long length, long *b, long bend,
+		long start_bit, long end_bit, SEASAT_sync_hit *hits, int nhits, int max_hits)
+{
+	return(scan_scalar_body(data,length,b,bend,start_bit,end_bit,hits,nhits,max_hits));
+}
+
+/*-------------------------------------------------------------------------
+  Nibble tables for the AVX2 kernel.
+
+  A sync code starting at bit k of byte b covers bytes b..b+3 (b..b+2
+  for k = 0).  Its bit errors are the sum over those bytes of
+  popcount((byte ^ pattern) & mask), with pattern and mask depending on
+  k and the byte.  Each of those terms is split into a lookup on the
+  high and one on the low nibble of the byte.
+ -------------------------------------------------------------------------*/
+static unsigned char lut_lo[8][4][16];
+static unsigned char lut_hi[8][4][16];
+
+static void init_scan_tables(void)
+{
+	int k, j, n;
+	unsigned int pat, msk;
+
+	for (k=0; k<8; k++)
+	  for (j=0; j<4; j++) {
+	    pat = ((SYNC_WORD << (8-k)) >> (24-8*j)) & 0377;
+	    msk = ((0xFFFFFFu << (8-k)) >> (24-8*j)) & 0377;
+	    for (n=0; n<16; n++) {
+	      lut_lo[k][j][n] = __builtin_popcount((n ^ pat) & msk & 017);
+	      lut_hi[k][j][n] = __builtin_popcount(((n<<4) ^ pat) & msk & 0360);
+	    }
+	  }
+}
+
+/*-------------------------------------------------------------------------
+  AVX2 kernel - 32 byte positions by 8 bit phases per iteration, one
+  candidate per byte lane.
+ -------------------------------------------------------------------------*/
+__attribute__((target("avx2,popcnt")))
+static int scan_avx2(const unsigned char *data, long length, long *b, long bend,
+		long start_bit, long end_bit, SEASAT_sync_hit *hits, int nhits, int max_hits)
+{
+	const __m256i low4 = _mm256_set1_epi8(017);
+	const __m256i limit = _mm256_set1_epi8(BIT_ERRORS+1);
+	__m256i lo[4], hi[4];
+	unsigned int found[8], any;
+	int i, j, k;
+
+	while (*b+35 <= length && *b+32 <= bend) {
+	  for (j=0; j<4; j++) {
+	    __m256i v = _mm256_loadu_si256((const __m256i *) (data + *b + j));
+	    lo[j] = _mm256_and_si256(v,low4);
+	    hi[j] = _mm256_and_si256(_mm256_srli_epi16(v,4),low4);
+	  }
+	  any = 0;
+	  for (k=0; k<8; k++) {
+	    __m256i cnt = _mm256_setzero_si256();
+	    for (j=(k==0); j<4; j++) {		/* phase 0 only spans 3 bytes */
+	      __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) lut_lo[k][3-j]));
+	      __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) lut_hi[k][3-j]));
+	      cnt = _mm256_add_epi8(cnt,_mm256_add_epi8(_mm256_shuffle_epi8(tlo,lo[3-j]),
+	      					        _mm256_shuffle_epi8(thi,hi[3-j])));
+	    }
+	    found[k] = _mm256_movemask_epi8(_mm256_cmpgt_epi8(limit,cnt));
+	    any |= found[k];
+	  }
+
+	  /* rare in real data - pull the hits out in bit order */
+	  while (any) {
+	    i = __builtin_ctz(any);
+	    any &= any-1;
+	    for (k=0; k<8; k++) {
+	      long t = (*b+i)*8 + k;
+	      unsigned int word;
+	      if (!((found[k] >> i) & 1)) continue;
+	      if (t < start_bit || t >= end_bit) continue;
+	      word = (unsigned int) data[*b+i] << 24 | data[*b+i+1] << 16 | data[*b+i+2] << 8 | data[*b+i+3];
+	      hits[nhits].bit = t;
+	      hits[nhits].errors = __builtin_popcount(((word >> (8-k)) & 0xFFFFFF) ^ SYNC_WORD);
+	      if (++nhits == max_hits) { _mm256_zeroupper(); return(nhits); }
+	    }
+	  }
+	  *b += 32;
+	}
+	_mm256_zeroupper();
+	return(scan_popcnt(data,length,b,bend,start_bit,end_bit,hits,nhits,max_hits));
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/*-------------------------------------------------------------------------
+  Picks the kernel named (scalar, popcnt or avx2), or the fastest one
+  this cpu supports if name is NULL.  Returns 0, or -1 (and keeps the
+  kernel there was) if the cpu does not have the one named.
+ -------------------------------------------------------------------------*/
+int use_sync_scan_kernel(const char *name)
+{
+	scan_fn k = scan_scalar;
+	const char *n = "scalar";
+
+#ifdef HAVE_X86_KERNELS
+	init_scan_tables();
+	__builtin_cpu_init();
+	if ((name == NULL || strcmp(name,"popcnt")==0 || strcmp(name,"avx2")==0) &&
+	    __builtin_cpu_supports("popcnt")) { k = scan_popcnt; n = "popcnt"; }
+	if ((name == NULL || strcmp(name,"avx2")==0) &&
+	    __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) { k = scan_avx2; n = "avx2"; }
+#endif
+	if (name != NULL && strcmp(name,n) != 0) return(-1);
+	scan_kernel = k;
+	scan_name = n;
+	return(0);
+}
+
+/* SEASAT_SYNC_SCAN=scalar (or popcnt) in the environment forces that kernel */
+static void select_scan_kernel(void)
+{
+	if (use_sync_scan_kernel(getenv("SEASAT_SYNC_SCAN")) != 0) use_sync_scan_kernel(NULL);
+}
+
+const char *sync_scan_kernel_name(void)
+{
+	if (scan_kernel == NULL) select_scan_kernel();
+	return(scan_name);
+}
+
+/*-------------------------------------------------------------------------
+  Finds every sync code starting at a bit offset in [start_bit,end_bit)
+  with at most BIT_ERRORS bit errors.  Fills in at most max_hits hits
+  and returns how many were found.  If the return equals max_hits there
+  may be more; carry on from hits[max_hits-1].bit+1.
+ -------------------------------------------------------------------------*/
+int scan_syncs(SEASAT_raw_input *in, long start_bit, long end_bit, SEASAT_sync_hit *hits, int max_hits)
+{
+	const unsigned char *p;
+	long b0, nbytes, b, bend;
+	int i, n;
+
+	if (scan_kernel == NULL) select_scan_kernel();
+	if (start_bit < 0) start_bit = 0;
+	if (max_hits <= 0 || start_bit >= end_bit) return(0);
+
+	/* bring in the bytes behind the range; a stream learns its length here */
+	b0 = start_bit >> 3;
+	nbytes = ((end_bit+22) >> 3) + 1 - b0;
+	if (raw_bytes(in,b0,nbytes) == NULL) nbytes = in->length - b0;
+	if (end_bit > in->length*8-23) end_bit = in->length*8-23;	/* last whole sync code */
+	if (start_bit >= end_bit) return(0);
+	p = raw_bytes(in,b0,nbytes);
+
+	/* the kernels count from the start of the window */
+	b = 0;
+	bend = ((end_bit+7) >> 3) - b0;
+	n = scan_kernel(p,nbytes,&b,bend,start_bit-b0*8,end_bit-b0*8,hits,0,max_hits);
+	for (i=0; i<n; i++) hits[i].bit += b0*8;
+	return(n);
+}
+
+/*-------------------------------------------------------------------------
+  Returns the bit offset of the first sync code at or after start_bit,
+  or -1 if there is none before the end of the file.  *be is set to its
+  number of bit errors.
+ -------------------------------------------------------------------------*/
+long find_next_sync(SEASAT_raw_input *in, long start_bit, int *be)
+{
+	SEASAT_sync_hit hit;
+
+	if (start_bit < 0) start_bit = 0;
+	while (raw_bytes(in,start_bit>>3,3) != NULL) {
+	  if (scan_syncs(in,start_bit,start_bit+SCAN_BLOCK*8,&hit,1) == 1) {
+	    *be = hit.errors;
+	    return(hit.bit);
+	  }
+	  start_bit += SCAN_BLOCK*8;
+	}
+	return(-1);
+}
+
+/*-------------------------------------------------------------------------
+  Returns the number of bit errors in the sync code starting at bit
+  offset bit, or 24+1 if it would run past the end of the file.
+ -------------------------------------------------------------------------*/
+int sync_errors_at(SEASAT_raw_input *in, long bit)
+{
+	const unsigned char *p;
+	unsigned int word;
+
+	if ((bit&7) == 0) {
+	  if ((p = raw_bytes(in,bit>>3,3)) == NULL) return(25);
+	  word = (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8;
+	} else {
+	  if ((p = raw_bytes(in,bit>>3,4)) == NULL) return(25);
+	  word = (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	}
+	return(__builtin_popcount(((word << (bit&7)) >> 8) ^ SYNC_WORD));
+}
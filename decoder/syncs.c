@@ -14,19 +14,20 @@ unsigned char SYNC3='\355';
  This routine may have problems at the end of the file...  I never check
  for end of file conditions...
  -------------------------------------------------------------------------*/
-int find_sync(FILE *fpin)
+int find_sync(SEASAT_raw_input *in)
 {
-	unsigned char tmp1, tmp2, tmp3;
+	const unsigned char *p;
 	int found;
 	
 	found = 0;
 	while (found == 0) {
-	  while(tmp1 != SYNC1) if (fread(&tmp1,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	  if (fread(&tmp2,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	  if (tmp2 != SYNC2) continue;
-	  if (fread(&tmp3,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	  if (tmp3 != SYNC3) continue;
-	  printf("Found sync code at %li\n",ftell(fpin)-3);
+	  if ((p = raw_bytes(in,in->pos,3)) == NULL) { in->pos = in->length; return(-1); }
+	  in->pos++;
+	  if (p[0] != SYNC1) continue;
+	  if (p[1] != SYNC2) continue;
+	  if (p[2] != SYNC3) continue;
+	  in->pos += 2;
+	  printf("Found sync code at %li\n",in->pos-3);
 	  found=1;
 	}
 	return(found);
@@ -37,17 +38,18 @@ int find_sync(FILE *fpin)
    Returns 1 if found, 0 if not found, -1 if EOF
    Allows for BIT_ERRORS # of errors when looking for a match.
  -------------------------------------------------------------------------*/
-int find_one_sync(FILE *fpin)
+int find_one_sync(SEASAT_raw_input *in)
 {
+	const unsigned char *p;
 	unsigned char tmp1, tmp2, tmp3;
 	int found;
 	int be;
 	
 	found = 0;
 	be = 0;
-	if (fread(&tmp1,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if( fread(&tmp2,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if (fread(&tmp3,sizeof(unsigned char),1,fpin)!=1) return(-1);
+	if ((p = raw_bytes(in,in->pos,3)) == NULL) return(-1);
+	tmp1 = p[0]; tmp2 = p[1]; tmp3 = p[2];
+	in->pos += 3;
   	if (tmp1 == SYNC1 && tmp2 == SYNC2 && tmp3 == SYNC3) found = 1;
 	else {
 	  if (tmp1 != SYNC1) be = bit_errors(SYNC1,tmp1);
@@ -55,7 +57,7 @@ int find_one_sync(FILE *fpin)
 	  if (tmp3 != SYNC3) be += bit_errors(SYNC3,tmp3);
 	  if (be<=BIT_ERRORS) found = 1;
           /* else printf("Error sync code at %.8i: %o %o %o (%i bit errors)\n",
-	     ftell(fpin)-3,tmp1,tmp2,tmp3,be); */
+	     in->pos-3,tmp1,tmp2,tmp3,be); */
 	}
 	return(found);
 }
@@ -63,19 +65,7 @@ int find_one_sync(FILE *fpin)
 /* This routine finds the number of bits different between ref(erence) and pat(tern) */
 int bit_errors(unsigned char ref, unsigned char pat)
 {	
-    int be, len, test, i;
-
-    len =sizeof(ref);
-    be = 0;
-    test = ref ^ pat;
-    for (i=0; i<len*8; i++)
-      {
-        int a;
-	a = test & 1;
-	be = be + a;
- 	test = test >> 1;
-      }
-    return(be);
+    return(__builtin_popcount(ref ^ pat));
 }
 
 /*-------------------------------------------------------------------------
@@ -83,18 +73,17 @@ int bit_errors(unsigned char ref, unsigned char pat)
    Returns 1 if found, 0 if not found, -1 if EOF
    Allows for BIT_ERRORS # of errors when looking for a match.
  -------------------------------------------------------------------------*/
-int find_sync_no_advance(FILE *fpin, int *bers)
+int find_sync_no_advance(SEASAT_raw_input *in, int *bers)
 {
+	const unsigned char *p;
 	unsigned char tmp1, tmp2, tmp3;
 	int found;
 	int be;
-	long offset;
 	
 	found = 0;
 	be = 0;
-	if (fread(&tmp1,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if( fread(&tmp2,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if (fread(&tmp3,sizeof(unsigned char),1,fpin)!=1) return(-1);
+	if ((p = raw_bytes(in,in->pos,3)) == NULL) return(-1);
+	tmp1 = p[0]; tmp2 = p[1]; tmp3 = p[2];
   	if (tmp1 == SYNC1 && tmp2 == SYNC2 && tmp3 == SYNC3) found = 1;
 	else {
 	  if (tmp1 != SYNC1) be = bit_errors(SYNC1,tmp1);
@@ -102,12 +91,9 @@ int find_sync_no_advance(FILE *fpin, int *bers)
 	  if (tmp3 != SYNC3) be += bit_errors(SYNC3,tmp3);
 	  if (be<=BIT_ERRORS) found = 1;
           /* else printf("Error sync code at %.8i: %o %o %o (%i bit errors)\n",
-	     ftell(fpin)-3,tmp1,tmp2,tmp3,be); */
+	     in->pos,tmp1,tmp2,tmp3,be); */
 	}
 	
-        offset = ftell(fpin);
-	offset = offset - 3;
-        fseek(fpin,offset,SEEK_SET);
 	*bers = be;
 	return(found);
 }
@@ -117,94 +103,47 @@ int find_sync_no_advance(FILE *fpin, int *bers)
    Returns 1 if found, 0 if not found, -1 if EOF
    Allows for BIT_ERRORS # of errors when looking for a match.
  -------------------------------------------------------------------------*/
-int find_unaligned_sync_no_advance(FILE *fpin, int *bers)
+int find_unaligned_sync_no_advance(SEASAT_raw_input *in, int *bers)
 {
-	unsigned char rtmp1, rtmp2, rtmp3, rtmp4;
+	const unsigned char *p;
+	unsigned long word;
 	unsigned char tmp1, tmp2, tmp3;
 	int found;
 	int be;
-	long offset;
 	
 	found = 0;
 	be = 0;
-	if (fread(&rtmp1,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if (fread(&rtmp2,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if (fread(&rtmp3,sizeof(unsigned char),1,fpin)!=1) return(-1);
-	if (fread(&rtmp4,sizeof(unsigned char),1,fpin)!=1) return(-1);
+	if ((p = raw_bytes(in,in->pos,4)) == NULL) return(-1);
 	
-	/* Shift the bits and combine into regular bytes for comparison */
-	tmp1 = rtmp1 << 4 | rtmp2 >> 4;
-	tmp2 = rtmp2 << 4 | rtmp3 >> 4;
-	tmp3 = rtmp3 << 4 | rtmp4 >> 4;
+	/* The sync code starts half way into the first byte; pull it out of one 32 bit word */
+	word = (unsigned long) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	tmp1 = word >> 20;
+	tmp2 = word >> 12;
+	tmp3 = word >> 4;
 		
-  	if (tmp1 == SYNC1 && tmp2 == SYNC2 && tmp3 == SYNC3) found = 2;
+	if (tmp1 == SYNC1 && tmp2 == SYNC2 && tmp3 == SYNC3) found = 2;
 	else {
 	  if (tmp1 != SYNC1) be = bit_errors(SYNC1,tmp1);
 	  if (tmp2 != SYNC2) be += bit_errors(SYNC2,tmp2);
 	  if (tmp3 != SYNC3) be += bit_errors(SYNC3,tmp3);
 	  if (be<=BIT_ERRORS) found = 2;
           /* else printf("Error unaligned sync code at %.8i: %o %o %o (%i bit errors)\n",
-	     ftell(fpin)-4,tmp1,tmp2,tmp3,be); */
+	     in->pos,tmp1,tmp2,tmp3,be); */
 	}
 	
-        offset = ftell(fpin);
-	offset = offset - 4;
-        fseek(fpin,offset,SEEK_SET);
 	*bers = be;
 	return(found);
 }
 
-int get_next_frameno(FILE *fpin, int aligned)
+/*-------------------------------------------------------------------------
+   Peeks at the frame number of the minor frame that follows the one
+   just read.  bit is the bit offset of that frame's aux byte.  Returns
+   -1 if the file ends before it.
+ -------------------------------------------------------------------------*/
+int get_next_frameno(SEASAT_raw_input *in, long bit)
   {
-      long save_loc, this_loc;
-      unsigned char tmpc, rtmp1, rtmp2;
-      int  frame_no;
-      
-      save_loc = ftell(fpin);
-      this_loc = save_loc + 3;
-      fseek(fpin,this_loc,SEEK_SET);
+      int tmpc;
 
-      /* If we had (last) an unaligned sync code, do this to get the frame number */
-      if (aligned==0) {
-	if (fread(&tmpc,sizeof(unsigned char),1,fpin)!=1) {printf("ERROR reading frame no\n"); exit(1);}
-	frame_no = tmpc & 0177;
-      }
-
-      /* If we had (last) an aligned sync code, do this to get the frame number */  	
-      if (aligned==1 || aligned == 2) {
-	if (fread(&rtmp1,sizeof(unsigned char),1,fpin)!=1) {printf("ERROR reading frame no\n"); exit(1);}
-	if (fread(&rtmp2,sizeof(unsigned char),1,fpin)!=1) {printf("ERROR reading frame no\n"); exit(1);}
-	tmpc = rtmp1 << 4 | rtmp2 >> 4;
-	frame_no = tmpc & 0177;
-      }
-      
-      fseek(fpin,save_loc,SEEK_SET);
-      return(frame_no);
+      if ((tmpc = raw_byte_at(in,bit)) < 0) return(-1);
+      return(tmpc & 0177);
   }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
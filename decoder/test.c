@@ -2,9 +2,116 @@
 NAME: SeasatPrep - preps seasat format raw data into L0 raw files to be 
 		   processed by ROI or similar SAR processor
 
-SYNOPSIS:  SeasatPrep <infile> <outfile>
+SYNOPSIS:  SeasatPrep [-t threads] [-b] [-d] [-p] [-x index [-l lines | -m times]]
+		[-c lines] [-r] [-q] [-F] [-S patches] [-I seconds] <infile> <outfile>
+	   SeasatPrep -s catalog [-k stride] <infile> [<infile> ...]
+	   SeasatPrep [-t threads] [-b] [-d] [-p] [-F] [-S patches] [-I seconds] -f manifest
+		[-j workers] [-w writers]
 
 DESCRIPTION:
+	<infile> may be - (standard input) or a pipe, in which case it is
+	read as a stream and never seeked, e.g.
+		gunzip -c pass.raw.gz | SeasatPrep - pass
+
+	-t threads	unpack and write the decoded lines on this many worker
+			threads, and walk the frames of the raw file by byte
+			range on as many more.  Frame number repair and the
+			line logic stay on the main thread, so the output is
+			identical to a single threaded run.
+
+	-b		write the decoded headers as binary <outfile>_NNN.hdrb
+			files instead of ASCII .hdr (see seasat_hdr.h)
+
+	-d		write the decoded lines with O_DIRECT, bypassing the
+			page cache.  Without -t the lines are always handed
+			to a writer thread, so decoding does not wait on the
+			disk.  Not used with -t, whose workers write each
+			line where it goes; with -c the checkpoints are taken
+			every DIRECT_LINES lines at the least.
+
+	-p		write the decoded lines packed, 8 samples to every 5
+			bytes, as <outfile>_NNN.pdat instead of .dat (see
+			seasat_dat.h).  Cannot be used with -d.
+
+	-x index	write a sync index of <infile> to the file index: the
+			raw file position, frame cadence, output file, line
+			number and time of every line written.  With -l or -m
+			the index is read instead, and decoding starts right
+			on the first line asked for.
+
+	-l [NNN:]first:last
+			decode only lines first to last (numbered as in the
+			header file) of output file NNN (default 000)
+
+	-m start:end	decode only the lines timed start to end msec, all
+			from the output file start falls in
+
+	A range is written to <outfile>_000 however short it is, and
+	decoding stops at its end.  It needs a regular <infile>.
+
+	-s catalog	survey the <infile>s instead of decoding them: list
+			each datatake with its bytes, line count, station,
+			day and start and end times in catalog, as CSV or as
+			JSON if the name ends in .json.  No payload is decoded
+			and nothing else is written.
+
+	-k stride	in a survey, also decode the headers of every stride
+			lines (default 1000)
+
+	-c lines	every lines lines, flush the output files to the disk
+			and note where the decoder stands in <outfile>.ckpt.
+			With -d, lines is rounded up to a multiple of
+			DIRECT_LINES so the flush leaves the data file on a
+			block boundary.
+
+	-r		resume from <outfile>.ckpt: cut the output files back
+			to the last line the checkpoint has, and go on from
+			there.  Without a checkpoint the run starts from the
+			beginning.  The options have to be those of the run
+			that wrote it, and -c, -r do not go with -x, -l, -m
+			or a streamed <infile>.
+
+	-q		also write a quality record for every line to
+			<outfile>_NNN.qual: repaired frame numbers, fill and
+			missing frames, sync code bit errors and a histogram
+			of the samples (see seasat_qual.h)
+
+	-F		clean the headers while decoding, as fix_headers,
+			fix_time, fix_stairs and dis_search would after it
+			(see seasat_clean.h): the .hdr files come out cleaned
+			and blank lines are put into the data files for the
+			time lost in discontinuities, which are listed in
+			<outfile>_NNN.dis.  An output file whose headers can
+			not be cleaned is removed.  Lines are held up to
+			PIPE_LINES at a time.  Cannot be used with -x, -l, -m,
+			-c, -r or -q.
+
+	-S patches	also cut each output file into overlapping segments
+			of this many ROI patches (PATCH_GOOD lines each, plus
+			the PATCH_LINES-PATCH_GOOD lines the last patch needs),
+			<outfile>_NNN_SSS.dat with its slice of the headers in
+			<outfile>_NNN_SSS.hdr.  Each segment is cut as soon as
+			its lines are decoded and then listed in
+			<outfile>_NNN.seg, so it can be focused while decoding
+			goes on (see segments.c).  Cannot be used with -c or -r.
+
+	-I seconds	instrument the run: time the decoding stages and count
+			bytes, frames, lines, sync losses and sync code bit
+			errors, and write them to <outfile>.stats as a JSON
+			object every seconds seconds and at the end (0: only
+			at the end).  See stats.c.
+
+	-f manifest	decode every raw file listed in manifest, one a line
+			and optionally followed by the base name of its output
+			files (default: the raw file name less its directory
+			and extension).  Each file is decoded by its own worker
+			process, which logs to <base>.log.  A summary of the
+			files and lines written follows.
+
+	-j workers	in a batch, decode this many files at once (default 2)
+
+	-w writers	in a batch, let only this many workers write decoded
+			lines at once (default 1)
 
 EXTERNAL ASSOCIATES:
     NAME:               USAGE:
@@ -18,6 +125,20 @@ PROGRAM HISTORY:
     VERS:   DATE:  AUTHOR:      PURPOSE:
     ---------------------------------------------------------------
     1.0	    4/12   T. Logan     Seasat Proof of Concept Project - ASF
+    1.1	    10/26  	        Threaded payload decoding (-t)
+    1.2	    10/26  	        Streaming input from a pipe or standard input
+    1.3	    10/26  	        Binary header files (-b)
+    1.4	    10/26  	        Decoded lines written on a separate thread; direct I/O (-d)
+    1.5	    10/26  	        Packed 5-bit output files (-p)
+    1.6	    10/26  	        Raw file sync index; decoding a line or time range (-x, -l, -m)
+    1.7	    10/26  	        Survey of raw files into a datatake catalog (-s, -k)
+    1.8	    10/26  	        Batch decoding of a manifest of raw files (-f, -j, -w)
+    1.9	    10/26  	        Checkpoints and resuming an interrupted run (-c, -r)
+    1.10    10/26  	        Per line quality files (-q)
+    1.11    10/26  	        Sample histogram, mean and variance of all lines in the .qual header
+    1.12    10/26  	        Header cleaning and discontinuity repair while decoding (-F)
+    1.13    10/26  	        Patch aligned segment files cut while decoding (-S)
+    1.14    10/26  	        Stage timers and throughput counters written as JSON (-I)
     
 HARDWARE/SOFTWARE LIMITATIONS:
 
@@ -31,11 +152,143 @@ BUGS:
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "seasat.h"
 
 SEASAT_raw_header r;
 SEASAT_header s;
 SEASAT_aux a;
+int seg_patches = 0;			/* cut the output files into segments of this many patches (-S) */
+
+/* where the lines of a clean pipe (-F) are written */
+typedef struct {
+  FILE *fpout;
+  SEASAT_hdr_file *fp_hdr;
+  int  nthreads;
+  long lines;				/* lines written so far			*/
+  char disname[256];			/* gaps filled in, opened with the first */
+  FILE *fp_dis;
+} clean_out;
+
+/*-------------------------------------------------------------------------
+  Exits once the line writers have written every line queued so far, so
+  an output file cut short by an error still holds the lines its header
+  file lists.
+ -------------------------------------------------------------------------*/
+static void exit_decoder(int status)
+{
+  stop_frame_scan();
+  stop_line_writers();
+  stop_async_writer();
+  exit(status);
+}
+
+/*-------------------------------------------------------------------------
+  Writes the line decoded into obuff (or, with threads, the one slot_bit
+  points at) as line line of the output file and its header, and its
+  quality record if fp_qual is open, adding its samples to stats.  The
+  record q is cleared for the next line.  With a clean pipe the line
+  goes into it instead, to be written once its header is cleaned.
+ -------------------------------------------------------------------------*/
+static void put_line(FILE *fpout, SEASAT_hdr_file *fp_hdr, FILE *fp_qual, long line, int nthreads, const long *slot_bit,
+		     const unsigned char *obuff, SEASAT_line_quality *q, SEASAT_sample_stats *stats,
+		     int hdr_line, long sync_loc, SEASAT_header *s, SEASAT_clean_pipe *pipe)
+{
+  q->line = hdr_line;
+  q->major_sync_loc = sync_loc;
+  if (pipe != NULL) {
+    SEASAT_header_ext h;
+    fill_header_ext(&h,hdr_line,sync_loc,s);
+    clean_line(pipe,&h,nthreads > 1 ? (const void *) slot_bit : (const void *) obuff);
+    memset(q,0,sizeof(SEASAT_line_quality));
+    return;
+  }
+  if (nthreads > 1) queue_line(fileno(fpout),line,slot_bit,fp_qual ? fileno(fp_qual) : -1,q,stats);
+  else {
+    write_line_async(fileno(fpout),obuff);
+    if (fp_qual != NULL) {
+      line_histogram(obuff,SAMPLES_PER_LINE,q->hist);
+      write_quality(fp_qual,q);
+      add_line_stats(stats,q->hist);
+    }
+  }
+  dump_all_headers(fp_hdr,hdr_line,sync_loc,s);
+  if (seg_patches) {
+    SEASAT_header_ext h;
+    fill_header_ext(&h,hdr_line,sync_loc,s);
+    add_segment_line(&h);
+  }
+  memset(q,0,sizeof(SEASAT_line_quality));
+}
+
+/* writes one cleaned line; data is NULL for a blank one */
+static void put_clean_line(void *arg, SEASAT_header_ext *h, const unsigned char *data)
+{
+  clean_out *o = (clean_out *) arg;
+  static long no_slots[SLOTS_PER_LINE];
+  static unsigned char blank[SAMPLES_PER_LINE];
+  int i;
+
+  if (o->nthreads > 1) {
+    if (data == NULL) for (i=0; i<SLOTS_PER_LINE; i++) no_slots[i] = -1;
+    queue_line(fileno(o->fpout),o->lines,data ? (const long *) data : no_slots,-1,NULL,NULL);
+  }
+  else write_line_async(fileno(o->fpout),data ? data : blank);
+  write_header(o->fp_hdr,h);
+  add_segment_line(h);
+  o->lines++;
+}
+
+/* notes a gap filled in, as dis_search does in its .dis file */
+static void put_clean_gap(void *arg, long line, long gap)
+{
+  clean_out *o = (clean_out *) arg;
+
+  if (o->fp_dis == NULL) {
+    o->fp_dis = fopen(o->disname,"w");
+    if (o->fp_dis == NULL) { printf("ERROR: unable to open output file %s\n",o->disname); exit_decoder(1); }
+    fprintf(o->fp_dis,"LINE\tGAP\n");
+  }
+  fprintf(o->fp_dis,"%li\t%li\n",line,gap);
+}
+
+/*-------------------------------------------------------------------------
+  Writes out the lines the clean pipe still holds up.  Returns 0, or -1
+  if the headers could not be cleaned - the output file is no good then.
+ -------------------------------------------------------------------------*/
+static int finish_clean(SEASAT_clean_pipe *pipe, clean_out *o)
+{
+  long n = close_clean_pipe(pipe);
+
+  free(pipe);
+  if (o->fp_dis != NULL) { fclose(o->fp_dis); o->fp_dis = NULL; }
+  if (n < 0) {
+    printf("ERROR: unable to clean the headers - removing the output files\n");
+    remove(o->disname);
+    return(-1);
+  }
+  printf("Cleaned the headers - wrote %li lines with the gaps filled in\n",n);
+  return(0);
+}
+
+/* gives up on the lines the clean pipe holds up, for an output file thrown away */
+static void drop_clean(SEASAT_clean_pipe *pipe, clean_out *o)
+{
+  drop_clean_pipe(pipe);
+  free(pipe);
+  if (o->fp_dis != NULL) { fclose(o->fp_dis); o->fp_dis = NULL; }
+  remove(o->disname);
+}
+
+/* notes a line just written to the header file in the sync index */
+static void index_line(SEASAT_sync_entry *e, int dataset, int line, SEASAT_header *s)
+{
+  e->dataset = dataset;
+  e->line = line;
+  e->msec = s->msec;
+  add_sync_entry(e);
+}
 
 #define MAX_FILE_LENGTH 97600   /* maximum number of lines to write to a data segment */
 				/* estimated at 8 patches * 11,600 + (16k-11,600)     */
@@ -43,14 +296,61 @@ SEASAT_aux a;
 main(int argc,char *argv[])
 {
   unsigned int testval, newval;
-  unsigned char *buf;
-  unsigned char inbuf[INT_FRAME_LEN+1];
+  const unsigned char *buf;
+  const unsigned char *inbuf;
+  int  buf_bit;				/* bit offset of the aux byte within buf */
   char inname[256], outname[256], outheadername[256];
   int  i, optr=0;
+  int  nthreads=1;			/* worker threads for payload decoding	*/
+  const char *hdr_ext="hdr";		/* hdrb to write binary header files	*/
+  int  direct_io=0;			/* write the decoded lines with O_DIRECT */
+  int  packed=0;			/* write packed .pdat files		*/
+  unsigned char pdat_header[PDAT_HEADER_SIZE];
+  const char *index_name=NULL;		/* sync index to write, or read with -l/-m */
+  char *line_range=NULL, *time_range=NULL;
+  int  range_set=0;			/* output file the line range is in	*/
+  long range_first, range_last;
+  long range_lines=0;			/* lines to decode; 0 decodes everything */
+  int  min_lines=10000;			/* shorter output files are thrown away	*/
+  SEASAT_sync_entry *sidx=NULL;
+  long nsidx=0, first_ent=-1, end_ent;
+  SEASAT_sync_entry major_ent;		/* raw file position of the line being decoded */
+  const char *catalog_name=NULL;	/* survey into this catalog instead of decoding */
+  int  stride=1000;			/* survey samples the headers this often */
+  const char *manifest_name=NULL;	/* decode the raw files listed in this	*/
+  int  workers=2;			/* ... this many at once		*/
+  int  io_slots=1;			/* ... with this many writing at once	*/
+  char batch_in[256], batch_base[256];
+  int  ckpt_lines=0;			/* checkpoint this often (lines)	*/
+  int  resume=0;			/* carry on from the checkpoint		*/
+  char ckpt_name[300];
+  SEASAT_checkpoint ck;
+  int  write_qual=0;			/* write a .qual file with each .hdr	*/
+  char qualname[256];
+  FILE *fp_qual=NULL;
+  SEASAT_line_quality q;		/* the line being decoded so far	*/
+  SEASAT_sample_stats qstats;		/* ... and all lines of the .qual file	*/
+  int  clean=0;				/* clean the headers while decoding	*/
+  SEASAT_clean_pipe *cpipe=NULL;	/* ... for the open output file		*/
+  clean_out cout;
+  int  clean_lost=0;			/* ... and they could not be		*/
+  char seg_base[256];			/* <outname>_NNN, the segments are named after */
+  int  stats_period=-1;			/* report the instrumentation this often (sec) */
+  char stats_name[300];
+  long lap=0;				/* start of the stage being timed	*/
+  int  timing=0;			/* ... in this frame			*/
+  int  fixed_before, unfixed_before;	/* frame number repairs before this frame */
+  struct stat st;
+  char *batch_argv[4];
+  long slot_bit[SLOTS_PER_LINE];	/* raw file bit offset behind each 228 sample slot of obuff */
+  long out_lines=0;			/* lines written to the current output file */
   int  headers=1000;
-  FILE *fpin, *fpout=NULL, *fp_hdr=NULL;
+  SEASAT_raw_input in;
+  FILE *fpout=NULL;
+  SEASAT_hdr_file *fp_hdr=NULL;
   FILE *frame_file1, *frame_file2;
-  FILE *fptmp, *fp_time, *fp_all_hdr;
+  FILE *fptmp, *fp_time;
+  SEASAT_hdr_file *fp_all_hdr;
 
   long seeking = 0;			/* keep track of how far we seek to find a sync */
   int found_cnt = 0;			/* number of sync found */
@@ -62,22 +362,18 @@ main(int argc,char *argv[])
   int done = 0;				/* set when we are within one frame of the end of file */
   int lock = 0;				/* set when we have a lock on a dataset */
   int max_consecutive_fills=0;		/* how many fills did we find in a row at most? */
-  long file_length;
   long offset;
   long last_sync=0;
   long this_sync=0;
+  long frame_bit=0;			/* bit offset of the current minor frame in the raw file */
   long major_sync_loc;			/* file location of last major sync */
   int  major_sync_num;			/* sync number of last major sync */
-  unsigned char rtmp1,rtmp2, tmp, tmpc;
+  unsigned char tmp, tmpc;
   unsigned char obuff[SAMPLES_PER_LINE+SAMPLES_PER_FRAME*10];
   double dtmp;
-  int this_frame, next_frame, last_frame=-1;
+  int this_frame, next_frame;
+  SEASAT_frame_fixer fix;		/* frame number repair */
   int expected_frame_no=-1;
-  int frames_this_line=-1;
-  int last_max_frame_no=-1;
-  int fixed_frame_nos=0;
-  int non_fixed_frame_nos=0;
-  int l2_frame=-1, l3_frame=-1;		 /* last last and last last last frame numbers     */
   int dataset_number=0;			 /* which dataset we are working on, starts at 000 */
   long int last_bad=0;			 /* sync location for last sync that was fill data */
   int contiguous_miss=0;		 /* number of contiguous fill data frames read     */
@@ -92,19 +388,80 @@ main(int argc,char *argv[])
   unsigned char DUMP_ALL_SYNCS=0;        /* set to 1 to see all of the sync locations 			*/
   int error = 0;
 
-  int read_cnt;
-  int aligned;
+  SEASAT_frame_tracker track;		/* predicts and checks where each minor frame starts */
 
   julian_date start_date;
  
-  if (argc != 3) {
-    printf("Usage: %s <inname> <outname>\n",argv[0]);
+  while (argc > 2 && argv[1][0]=='-' && argv[1][1]!=0) {
+    if (strcmp(argv[1],"-t")==0) { nthreads = atoi(argv[2]); argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-b")==0) { hdr_ext = "hdrb"; argv++; argc--; }
+    else if (strcmp(argv[1],"-d")==0) { direct_io = 1; argv++; argc--; }
+    else if (strcmp(argv[1],"-p")==0) { packed = 1; argv++; argc--; }
+    else if (strcmp(argv[1],"-x")==0) { index_name = argv[2]; argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-l")==0) { line_range = argv[2]; argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-m")==0) { time_range = argv[2]; argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-s")==0) { catalog_name = argv[2]; argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-k")==0) { stride = atoi(argv[2]); argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-c")==0) { ckpt_lines = atoi(argv[2]); argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-r")==0) { resume = 1; argv++; argc--; }
+    else if (strcmp(argv[1],"-q")==0) { write_qual = 1; argv++; argc--; }
+    else if (strcmp(argv[1],"-F")==0) { clean = 1; argv++; argc--; }
+    else if (strcmp(argv[1],"-S")==0) { seg_patches = atoi(argv[2]); argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-I")==0) { stats_period = atoi(argv[2]); argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-f")==0) { manifest_name = argv[2]; argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-j")==0) { workers = atoi(argv[2]); argv += 2; argc -= 2; }
+    else if (strcmp(argv[1],"-w")==0) { io_slots = atoi(argv[2]); argv += 2; argc -= 2; }
+    else break;
+  }
+  if (catalog_name != NULL && argc >= 2 && stride >= 1) exit(survey_raw_files(catalog_name,stride,argc-1,argv+1) ? 1 : 0);
+  if (manifest_name != NULL && argc == 1 && workers >= 1 && io_slots >= 1 && nthreads >= 1 && index_name == NULL) {
+    /* returns in a worker, which decodes its one file below */
+    run_batch(manifest_name,workers,io_slots,batch_in,batch_base);
+    batch_argv[0] = argv[0];
+    batch_argv[1] = batch_in;
+    batch_argv[2] = batch_base;
+    batch_argv[3] = NULL;
+    argv = batch_argv;
+    argc = 3;
+  }
+  if (argc != 3 || nthreads < 1 || ((line_range || time_range) && index_name==NULL) || (line_range && time_range) ||
+      ckpt_lines < 0 || ((ckpt_lines || resume) && index_name!=NULL) ||
+      (clean && (index_name!=NULL || ckpt_lines || resume || write_qual)) || seg_patches < 0 || (seg_patches && (ckpt_lines || resume))) {
+    printf("Usage: %s [-t threads] [-b] [-d] [-p] [-x index [-l lines | -m times]] [-c lines] [-r] [-q] [-F] [-S patches]\n",argv[0]);
+    printf("       [-I seconds] <inname> <outname>\n");
     printf("\n");
-    printf("inname  \tname of input RAW Seasat file (sync'd)\n");
+    printf("threads \tnumber of threads decoding the payload (default 1)\n");
+    printf("-b      \twrite the headers in binary (.hdrb) instead of ASCII (.hdr)\n");
+    printf("-d      \twrite the decoded lines with direct I/O (O_DIRECT), bypassing the page cache\n");
+    printf("-p      \twrite the decoded lines packed, 8 samples in 5 bytes (.pdat)\n");
+    printf("-x      \twrite a sync index of the raw file; with -l or -m, read it to jump to the range\n");
+    printf("-l      \t[NNN:]first:last - decode only these lines of output file NNN\n");
+    printf("-m      \tstart:end - decode only the lines between these times (msec)\n");
+    printf("-c      \tcheckpoint every lines lines to <outname>.ckpt\n");
+    printf("-r      \tresume from <outname>.ckpt\n");
+    printf("-q      \twrite a quality record for every line (.qual)\n");
+    printf("-F      \tclean the headers and fill in time discontinuities while decoding (not with -x, -c, -r, -q)\n");
+    printf("-S      \talso cut the output files into overlapping segments of patches ROI patches (not with -c, -r)\n");
+    printf("-I      \twrite stage timers and throughput counters to <outname>.stats (JSON) every seconds seconds\n");
+    printf("\n   or: %s -s catalog [-k stride] <inname> [<inname> ...]\n\n",argv[0]);
+    printf("catalog \tsurvey the input files into this catalog of datatakes (CSV, or JSON if it ends in .json)\n");
+    printf("stride  \tdecode the headers of every stride lines (default 1000)\n");
+    printf("\n   or: %s [-t threads] [-b] [-d] [-p] [-c lines] [-r] [-q] [-F] [-S patches] [-I seconds] -f manifest\n",argv[0]);
+    printf("       [-j workers] [-w writers]\n\n");
+    printf("manifest\tdecode the raw files listed in this file, each optionally followed by an output base name\n");
+    printf("workers \tnumber of files decoded at once (default 2)\n");
+    printf("writers \tnumber of workers writing decoded lines at once (default 1)\n");
+    printf("inname  \tname of input RAW Seasat file (sync'd), or - for standard input\n");
     printf("outname \tbase name of output RAW Seasat file (prep'd)\n\n");
     exit(1);
   }
   strcpy(inname,argv[1]);
+  if (packed && direct_io) {
+    /* the file header leaves the packed lines off the block boundaries */
+    printf("WARNING: direct I/O can not be used for packed output - writing through the page cache\n");
+    direct_io = 0;
+  }
+  make_pdat_header(pdat_header);
 
   r.aux0 =(SEASAT_aux_0 *) malloc(sizeof(SEASAT_aux_0));
   r.aux1 =(SEASAT_aux_1 *) malloc(sizeof(SEASAT_aux_1));
@@ -118,15 +475,64 @@ main(int argc,char *argv[])
   r.aux9 =(SEASAT_aux_9 *) malloc(sizeof(SEASAT_aux_9));
 
   for (i=0; i<SAMPLES_PER_LINE; i++) obuff[i] = 0;
+  for (i=0; i<SLOTS_PER_LINE; i++) slot_bit[i] = -1;
   
-  /* open input file and determine file length */
-  fpin = fopen(inname,"rb");
-  if (fpin==NULL) { printf("ERROR: unable to open input file %s\n",inname); exit(1); }
-  fseek(fpin,0L,SEEK_END);
-  file_length = ftell(fpin);
-  fseek(fpin,0L,SEEK_SET);
-  printf("Total file length is %li\n",file_length);
-  printf("Starting at %li\n",ftell(fpin));
+  /* map input file and determine file length */
+  if (open_raw_input(inname,&in)!=0) { printf("ERROR: unable to open input file %s\n",inname); exit(1); }
+  if (in.stream) printf("Reading input as a stream - total length not known yet\n");
+  else printf("Total file length is %li\n",in.length);
+  printf("Starting at %li\n",in.pos);
+
+  /* find the lines asked for in the sync index */
+  if (line_range || time_range) {
+    if (in.stream) { printf("ERROR: a line or time range can only be decoded from a regular file\n"); exit(1); }
+    sidx = read_sync_index(index_name,&nsidx);
+    if (line_range) {
+      if (sscanf(line_range,"%i:%li:%li",&range_set,&range_first,&range_last)!=3) {
+        range_set = 0;
+        if (sscanf(line_range,"%li:%li",&range_first,&range_last)!=2) { printf("ERROR: bad line range %s\n",line_range); exit(1); }
+      }
+      first_ent = find_sync_line(sidx,nsidx,range_set,range_first);
+      if (first_ent < 0) { printf("ERROR: line %li of output file %3.3i is not in %s\n",range_first,range_set,index_name); exit(1); }
+      for (end_ent=first_ent; end_ent<nsidx && sidx[end_ent].dataset==range_set && sidx[end_ent].line<=range_last; end_ent++);
+    } else {
+      if (sscanf(time_range,"%li:%li",&range_first,&range_last)!=2) { printf("ERROR: bad time range %s\n",time_range); exit(1); }
+      first_ent = find_sync_time(sidx,nsidx,0,range_first,range_last,1);
+      if (first_ent >= nsidx) { printf("ERROR: no lines between %li and %li msec in %s\n",range_first,range_last,index_name); exit(1); }
+      end_ent = find_sync_time(sidx,nsidx,first_ent,range_first,range_last,0);
+      while (sidx[end_ent-1].dataset != sidx[first_ent].dataset) end_ent--;
+    }
+    range_lines = end_ent-first_ent;
+    if (range_lines < 1) { printf("ERROR: no lines in range %s\n",line_range ? line_range : time_range); exit(1); }
+    min_lines = 0;
+    printf("Decoding %li lines from output file %3.3i line %i (%li msec), byte %li of the raw file\n",range_lines,
+    	sidx[first_ent].dataset,sidx[first_ent].line,sidx[first_ent].msec,sidx[first_ent].bit>>3);
+  }
+  else if (index_name!=NULL && open_sync_index(index_name)!=0) {
+    printf("ERROR: unable to open sync index %s\n",index_name); exit(1);
+  }
+
+  if (nthreads > 1 && in.stream) {
+    /* the workers read the frames long after the ring has moved on */
+    printf("Streaming input - decoding on a single thread\n");
+    nthreads = 1;
+  }
+  if (nthreads > 1 && direct_io) {
+    /* the workers write each line where it goes, off the block boundaries */
+    printf("WARNING: direct I/O can not be used with -t - writing through the page cache\n");
+    direct_io = 0;
+  }
+  if (direct_io && ckpt_lines % DIRECT_LINES != 0) {
+    /* a checkpoint flushes the lines written so far: keep them whole blocks */
+    ckpt_lines += DIRECT_LINES - ckpt_lines % DIRECT_LINES;
+    printf("Checkpointing every %i lines, a whole number of direct I/O blocks\n",ckpt_lines);
+  }
+  if (nthreads > 1) start_line_writers(&in,nthreads,packed);
+  else start_async_writer(direct_io,packed);
+  if (stats_period >= 0) {
+    sprintf(stats_name,"%s.stats",argv[2]);
+    start_stats(stats_name,stats_period,&track,&fix,&this_sync,&found_cnt,&major_cnt);
+  }
   
   if (DUMP_FIXED_FRAMES==1) {
     frame_file1 = fopen("frames_fixed.out","w");
@@ -142,7 +548,7 @@ main(int argc,char *argv[])
   }
   if (DUMP_ALL_HEADERS==1) {
     sprintf(outname,"%s.headers",argv[2]);
-    fp_all_hdr = fopen(outname,"w");
+    fp_all_hdr = open_hdr_file(outname,"w");
     if (fp_all_hdr==NULL) { printf("ERROR: unable to open output file %s\n"); exit(1);}
   }
   if (DUMP_ALL_SYNCS==1) {  
@@ -150,152 +556,119 @@ main(int argc,char *argv[])
     if (fptmp==NULL) { printf("ERROR: unable to open output file sync_loc.txt\n"); exit(1);}
   }
 
-  read_cnt = 0;
-  aligned = -1;
+  init_frame_fixer(&fix,DISPLAY_FRAME_FIXES,1);
+  if (first_ent >= 0) seek_frame_tracker(&track,sidx[first_ent].bit,sidx[first_ent].cnt);
+  else init_frame_tracker(&track,0);
 
-  /*===========================================================================================
-                                           START MAIN LOOP 
-  ===========================================================================================*/
-  while (!feof(fpin)&&!done&&!error) {
-    long where;
-    this_sync = ftell(fpin);
-    
-    if (read_cnt == 28434) 		/* special case - only 147 byte frame here */
-      { aligned = 2; read_cnt = 0;}
-    else {
-      if (read_cnt%2 == 0) 		/* read in 147.5 byte aligned frame */
-        { aligned = 1; read_cnt++; }
-      else 		 		/* read in 147.5 byte non-aligned frame */
-        { aligned = 0; read_cnt++; }
+  /* pick up where the checkpoint left off */
+  sprintf(ckpt_name,"%s.ckpt",argv[2]);
+  if ((ckpt_lines || resume) && in.stream) { printf("ERROR: checkpoints need a regular <infile>\n"); exit(1); }
+  if (resume && read_checkpoint(ckpt_name,&ck) != 0) {
+    printf("No checkpoint %s - starting from the beginning\n",ckpt_name);
+    resume = 0;
+  }
+  if (resume) {
+    if (ck.in_length != in.length || ck.packed != packed || ck.binary_hdr != (hdr_ext[3]=='b') ||
+        (ck.qual_size >= 0) != write_qual) {
+      printf("ERROR: checkpoint %s is for another raw file or other options\n",ckpt_name); exit(1);
     }
+    if (stat(ck.outname,&st) != 0 || st.st_size < ck.dat_size || stat(ck.outheadername,&st) != 0 || st.st_size < ck.hdr_size) {
+      printf("ERROR: %s or %s is shorter than checkpoint %s says - can not resume\n",ck.outname,ck.outheadername,ckpt_name);
+      exit(1);
+    }
+    /* anything past the checkpoint is written again */
+    if (truncate(ck.outname,ck.dat_size) != 0 || truncate(ck.outheadername,ck.hdr_size) != 0) {
+      printf("ERROR: unable to cut %s back to the checkpoint\n",ck.outname); exit(1);
+    }
+    strcpy(outname,ck.outname);
+    strcpy(outheadername,ck.outheadername);
+    fpout = fopen(outname,"r+b");
+    if (fpout==NULL || lseek(fileno(fpout),0,SEEK_END) != ck.dat_size) { printf("ERROR: unable to open output file %s\n",outname); exit(1); }
+    fp_hdr = open_hdr_file(outheadername,"a");
+    if (fp_hdr==NULL) { printf("ERROR: unable to open output file %s\n",outheadername); exit(1); }
+    if (write_qual) {
+      strcpy(qualname,outname);
+      strcpy(strrchr(qualname,'.'),".qual");
+      if (truncate(qualname,ck.qual_size) != 0 || (fp_qual = fopen(qualname,"r+b")) == NULL ||
+          fseek(fp_qual,0,SEEK_END) != 0 || ftell(fp_qual) != ck.qual_size) {
+        printf("ERROR: unable to open output file %s at the checkpoint\n",qualname); exit(1);
+      }
+    }
+    q = ck.q;
+    qstats = ck.qstats;
 
-    fread(inbuf,INT_FRAME_LEN*sizeof(unsigned char),1,fpin);
-    if (aligned==1 || aligned==2) fseek(fpin,-1L,SEEK_CUR);
+    track = ck.track;
+    fix = ck.fix;
+    s = ck.s;
+    major_ent = ck.line;
+    found_cnt = ck.found_cnt;
+    major_cnt = ck.major_cnt;
+    this_major_cnt = ck.this_major_cnt;
+    pre_cnt = ck.pre_cnt;
+    fill_cnt = ck.fill_cnt;
+    good_cnt = ck.good_cnt;
+    max_consecutive_fills = ck.max_consecutive_fills;
+    contiguous_miss = ck.contiguous_miss;
+    partial_line_cnt = ck.partial_line_cnt;
+    dataset_number = ck.dataset_number;
+    major_sync_num = ck.major_sync_num;
+    last_bad = ck.last_bad;
+    out_lines = ck.out_lines;
+    lock = 1;
 
-    found_cnt++;
+    /* the line's first frame again: its header byte and payload */
+    frame_bit = major_ent.bit;
+    major_sync_loc = last_sync = this_sync = frame_bit >> 3;
+    inbuf = raw_bytes(&in,this_sync,INT_FRAME_LEN);
+    headers = 0;
+    decode_headers(&r,&(inbuf[4]),frame_bit&7,&headers);
+    if (nthreads > 1) { slot_bit[0] = frame_bit + 40; optr = SAMPLES_PER_FRAME; }
+    else decode_payload(&(inbuf[4]),frame_bit&7,obuff,&optr);
+    good_cnt++;
 
-//    if (found_cnt>1 && this_frame != 127) {
-    if (found_cnt>1) {
-        l3_frame = l2_frame;
-	l2_frame = last_frame;
-      	last_frame = this_frame;
-    }
+    printf("==========================================================================\n");
+    printf(" Resuming output file %s at line %i, byte %li of the raw file\n",outname,this_major_cnt,this_sync);
+    printf("==========================================================================\n");
+  }
 
-    /* If we have an aligned sync code, do this to get the frame number */
-    if (aligned==1 || aligned==2) {
-        tmpc = inbuf[3];
-	a.fill_flag = tmpc >> 7;
-	a.frame_no = tmpc & 0177;
-    }
+  if (nthreads > 1) start_frame_scan(&in,nthreads,track.bit);
 
-    /* If we have an unaligned sync code, do this to get the frame number */  	
-    if (aligned==0) {
-        rtmp1 = inbuf[3];
-	rtmp2 = inbuf[4];
-	tmpc = rtmp1 << 4 | rtmp2 >> 4;
-	a.fill_flag = tmpc >> 7;
-	a.frame_no = tmpc & 0177;
-    }
-      
-    this_frame = a.frame_no;
-    next_frame = get_next_frameno(fpin,aligned);
-
-    /* Check for bit errors in frame no 0 as this causes BIG problems 
-     ---------------------------------------------------------------*/
-    if ((this_frame-last_frame)!=1 && this_frame != 0 && (a.frame_no!=127 || next_frame!=127)) {  
-
-	/* if the next frame is 1 and last was either 59 or 60, 
-	   assume this is frame zero... might be a bad assumption???  
-	  ---------------------------------------------------------*/
-	if (next_frame==1 && (last_frame==59 || last_frame==60)) { 
-	    if (DISPLAY_FRAME_FIXES==1)
-	        printf("1: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 000\n",
-	    	l3_frame,l2_frame,last_frame,this_frame,next_frame);
-	    this_frame = 0; fixed_frame_nos++;
-	}
-	
-	/* if  (next_frame-last_frame)==2, put this_frame in sequence 
-	 -----------------------------------------------------------*/
-	else if (next_frame - last_frame == 2) {
-	    if (DISPLAY_FRAME_FIXES==1)
-	        printf("2: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO %3.3i\n",
-	    	l3_frame,l2_frame,last_frame,this_frame,next_frame,last_frame+1);
-	  this_frame = last_frame+1; fixed_frame_nos++;
-	}
-	
-	/* if last two frames are in sequence, put this one in sequence
-	 -------------------------------------------------------------*/
-	else if (((l2_frame-l3_frame==1) || (l2_frame-l3_frame)%59 == 0 || (l2_frame-l3_frame)%60 == 0)
-		 && (last_frame-l2_frame==1)) {
-	  /* - can't ever have two lines in a row that have 60 minor frames
-	     - otherwise, we are good to set this frame into sequence */
-	  if (last_max_frame_no<60 || last_frame < 59) { 
-    	    if (DISPLAY_FRAME_FIXES==1)
-	        printf("3: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO %3.3i\n",
-	    	l3_frame,l2_frame,last_frame,this_frame,next_frame,last_frame+1);
-	    this_frame=last_frame+1; fixed_frame_nos++;
-	  } else { 
-	    /* If the last frame was either 59 or 60, then this HAS to be frame zero
-	     ------------------------------------------------------------------------*/
-    	    if (DISPLAY_FRAME_FIXES==1)
-	        printf("4: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 000\n",
-	    	l3_frame,l2_frame,last_frame,this_frame,next_frame);
-	    this_frame=0; fixed_frame_nos++;
-	  }
-	} 
-	
-	/* if last2 and last3 frames are in sequence and last frame 
-	   is ZERO, then set this frame to 1
-	 ---------------------------------------------------------*/
-	else if ((l2_frame-l3_frame==1) && (last_frame==0)) {
-	  if (DISPLAY_FRAME_FIXES==1)
-            printf("5: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 001\n",
-	    	l3_frame,l2_frame,last_frame,this_frame,next_frame);
-	  this_frame = 1; fixed_frame_nos++;
-	}
-	
-	/* If we got to here, then we did not fix the error
-	 -------------------------------------------------*/
-	else if (lock==1) {
-	    printf("6: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; NOT FIXED!! (Line %i)\n",
-	    	l3_frame,l2_frame,last_frame,this_frame,next_frame,major_cnt);
-	    non_fixed_frame_nos++;
-	}
-    }
-     
-    /* Check for bad frame zeros!  This can only be frame ZERO if the
-       last frame was 59 or greater and the next frame is 1.
-       -- Update - this condition doesn't allow 1/2 lines to exist,
-          but they do exist in the raw files!!!
-     -------------------------------------------------------------- */
-    if (lock==1 && this_frame==0 && abs(this_frame-last_frame)<59 && next_frame!=1) {
-      if (DISPLAY_FRAME_FIXES==1)
-   	  printf("7: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO %3.3i\n",
-   	      l3_frame,l2_frame,last_frame,this_frame,next_frame,last_frame+1);
-      this_frame = last_frame+1; fixed_frame_nos++;
-    }
+  /*===========================================================================================
+                                           START MAIN LOOP 
+  ===========================================================================================*/
+  while (!done&&!error) {
+    timing = stats_on && found_cnt % STAT_SAMPLE == 0;
+    if (timing) lap = stat_begin(STAT_SAMPLE);
+
+    /* 147.5 byte frames alternate between byte and nibble aligned, with
+       a 147 byte frame every 28435 frames; the tracker keeps count */
+    if ((frame_bit = track_next_frame(&track,&in)) < 0) break;
+    if (stats_on) stat_frame(track.errors);
+    if (timing) lap = stat_lap(STAT_SYNC,lap);
+    this_sync = frame_bit >> 3;
+    inbuf = raw_bytes(&in,this_sync,INT_FRAME_LEN);
 
-    if (lock==1) frames_this_line++;
+    found_cnt++;
 
-    /* We can NEVER have a frame number greater than 60!!!
-     ----------------------------------------------------*/
-    if (lock==1 && this_frame > 60 && frames_this_line>59) {
-      if (DISPLAY_FRAME_FIXES==1)
-	    printf("8: L3=%3.3i L2=%3.3i Last=%3.3i This=%3.3i Next=%3.3i; FIXED TO 000\n",
-	    l3_frame,l2_frame,last_frame,this_frame,next_frame);
-	this_frame=0; fixed_frame_nos++;
-    }        
+    /* fill flag and frame number follow the sync code */
+    tmpc = frame_byte_at(&in,frame_bit+24);
+    a.fill_flag = tmpc >> 7;
+    a.frame_no = tmpc & 0177;
+      
+    if ((next_frame = track_next_frameno(&track,&in)) < 0) break;	/* the file ends in the next frame */
+    fixed_before = fix.fixed;
+    unfixed_before = fix.non_fixed;
+    this_frame = fix_frame_no(&fix,a.frame_no,next_frame,lock,major_cnt);
+    if (timing) lap = stat_lap(STAT_FRAME,lap);
+    if (stats_on && this_frame == 0) { timing = 1; lap = stat_begin(1); }	/* lines go out on these */
 
     /* printf("frame no %i; fill flag %i\n",a.frame_no, a.fill_flag); */
     if (DUMP_FIXED_FRAMES==1) { if (this_frame!=0 && lock==1) fprintf(frame_file1,"%2.2i ",this_frame); }
     if (DUMP_NON_FIXED_FRAMES==1) { if (this_frame!=0) fprintf(frame_file2,"%2.2i ",a.frame_no); }
   
-    /* set pointer to data portion of the frame, shift if necessary */
-    if (aligned==1 || aligned==2) buf = &(inbuf[4]); 
-    else /* if (aligned==0) */ { 
-      buf = &(inbuf[5]);
-      shift_buffer(buf,rtmp2); 
-    }
+    /* set pointer to data portion of the frame, unaligned frames start part way into the byte */
+    buf = &(inbuf[4]);
+    buf_bit = frame_bit & 7;
       
     /* start of a new major frame */
     if (this_frame == 0) { 
@@ -303,8 +676,11 @@ main(int argc,char *argv[])
 	major_cnt++;
 	this_major_cnt++;
 	long int last_major_sync_loc = major_sync_loc;
-	major_sync_loc = ftell(fpin)-(INT_FRAME_LEN-1); 
-	if (aligned==0) major_sync_loc--;
+	SEASAT_sync_entry last_major_ent = major_ent;
+	major_sync_loc = this_sync; 
+	major_ent.bit = frame_bit;
+	major_ent.cnt = tracker_frame_cnt(&track);
+	major_ent.aligned = track.aligned;
 	major_sync_num = found_cnt;
 	if (lock == 0) {
           printf("==========================================================================\n");
@@ -312,42 +688,96 @@ main(int argc,char *argv[])
           printf("==========================================================================\n");
           lock = 1;
           end_of_dataset=0;
-	  last_frame = -1;
-	  l2_frame = -1;
-	  l3_frame = -1;
+	  fix.last_frame = -1;
+	  fix.l2_frame = -1;
+	  fix.l3_frame = -1;
+	  memset(&q,0,sizeof(q));
 	} else {
-  	  last_max_frame_no = last_frame;
-  	  if (last_max_frame_no != 59 && last_max_frame_no != 60) {
-	    printf("ERROR: Found range line #%li with %i frames in it!!!\n",this_major_cnt-1,last_max_frame_no);
+  	  fix.last_max_frame_no = fix.last_frame;
+  	  if (fix.last_max_frame_no != 59 && fix.last_max_frame_no != 60) {
+	    printf("ERROR: Found range line #%li with %i frames in it!!!\n",this_major_cnt-1,fix.last_max_frame_no);
 	    partial_line_cnt++;
+	    q.flags |= QUAL_PARTIAL;
 	  }
 	}
 	
 	if (DUMP_FIXED_FRAMES==1) {fprintf(frame_file1,"\n"); fprintf(frame_file1,"%2.2i ",this_frame);}
 	if (DUMP_NON_FIXED_FRAMES==1) {fprintf(frame_file2,"\n"); fprintf(frame_file2,"%2.2i ",a.frame_no);}
-	frames_this_line = 1;
+	fix.frames_this_line = 1;
 	
 	if (this_major_cnt == 1) {
-	  sprintf(outname,"%s_%3.3i.dat",argv[2],dataset_number);
-      	  sprintf(outheadername,"%s_%3.3i.hdr",argv[2],dataset_number);
+	  sprintf(outname,"%s_%3.3i.%s",argv[2],dataset_number,packed ? "pdat" : "dat");
+      	  sprintf(outheadername,"%s_%3.3i.%s",argv[2],dataset_number,hdr_ext);
 	  printf("Opening file %s for output\n",outname);
-	  if (fpout==NULL) fpout = fopen(outname,"wb");
-	  if (fpout==NULL) { printf("ERROR: unable to open output file %s\n",outname); exit(1); }
-	  if (fp_hdr==NULL) fp_hdr = fopen(outheadername,"w");
-	  if (fp_hdr==NULL) { printf("ERROR: unable to open output file %s\n",outheadername); exit(1); }
+	  if (fpout==NULL) {
+	    fpout = fopen(outname,"wb");
+	    if (fpout==NULL) { printf("ERROR: unable to open output file %s\n",outname); exit_decoder(1); }
+	    if (packed && write(fileno(fpout),pdat_header,PDAT_HEADER_SIZE) != PDAT_HEADER_SIZE) {
+	      printf("ERROR: unable to write output file %s\n",outname); exit_decoder(1);
+	    }
+	  }
+	  if (fp_hdr==NULL) fp_hdr = open_hdr_file(outheadername,"w");
+	  if (fp_hdr==NULL) { printf("ERROR: unable to open output file %s\n",outheadername); exit_decoder(1); }
+	  if (write_qual) {
+	    sprintf(qualname,"%s_%3.3i.qual",argv[2],dataset_number);
+	    if (fp_qual==NULL) {
+	      fp_qual = open_qual_file(qualname);
+	      memset(&qstats,0,sizeof(qstats));
+	    }
+	    if (fp_qual==NULL) { printf("ERROR: unable to open output file %s\n",qualname); exit_decoder(1); }
+	  }
+	  if (clean) {
+	    cpipe = (SEASAT_clean_pipe *) malloc(sizeof(SEASAT_clean_pipe));
+	    if (cpipe==NULL) { printf("ERROR: unable to allocate the clean pipe\n"); exit_decoder(1); }
+	    cout.fpout = fpout;
+	    cout.fp_hdr = fp_hdr;
+	    cout.nthreads = nthreads;
+	    cout.lines = 0;
+	    cout.fp_dis = NULL;
+	    sprintf(cout.disname,"%s_%3.3i.dis",argv[2],dataset_number);
+	    remove(cout.disname);	/* one from an earlier run would not go with this file */
+	    open_clean_pipe(cpipe,nthreads > 1 ? SLOTS_PER_LINE*sizeof(long) : SAMPLES_PER_LINE,
+	    		put_clean_line,put_clean_gap,&cout);
+	  }
+	  if (seg_patches) {
+	    sprintf(seg_base,"%s_%3.3i",argv[2],dataset_number);
+	    open_segments(seg_base,outname,seg_patches,packed ? "pdat" : "dat",hdr_ext,packed);
+	  }
+	  out_lines = 0;
 	  dataset_number++;
         }
 
 	/* DUMP OUT LAST BUFFER OF DECODED RAW DATA IF NECESSARY */
 	if (this_major_cnt > 1) {
-	  if (fpout!=NULL) fwrite(obuff,sizeof(unsigned char),SAMPLES_PER_LINE,fpout);
-	  else {printf("ERROR: Unable to write output to unopened file 1\n"); exit(1); }
-          dump_all_headers(fp_hdr,this_major_cnt-1,last_major_sync_loc,&s);
+	  if (fpout==NULL) {printf("ERROR: Unable to write output to unopened file 1\n"); exit_decoder(1); }
+	  put_line(fpout,fp_hdr,fp_qual,out_lines,nthreads,slot_bit,obuff,&q,&qstats,this_major_cnt-1,last_major_sync_loc,&s,cpipe);
+	  out_lines++;
+	  index_line(&last_major_ent,dataset_number-1,this_major_cnt-1,&s);
 	  for (i=0; i<SAMPLES_PER_LINE; i++) obuff[i] = 0;
+	  for (i=0; i<SLOTS_PER_LINE; i++) slot_bit[i] = -1;
 	  optr = 0;
 	}
+
+	/* all of the lines asked for are out */
+	if (range_lines > 0 && this_major_cnt > range_lines) {
+	  close_segments(1);
+	  flush_line_writers(); flush_async_writer();
+	  fclose(fpout);
+	  if (fp_qual!=NULL) { close_qual_file(fp_qual,&qstats); fp_qual=NULL; }
+	  close_hdr_file(fp_hdr);
+	  fpout=NULL;
+	  fp_hdr=NULL;
+	  major_cnt--;
+	  optr = 0;
+          printf("==========================================================================\n");
+          printf("End of Range - Closed output file %s - dumped %li range lines\n",outname,range_lines);
+          printf("==========================================================================\n");
+	  break;
+	}
     }
       
+    if (timing) lap = stat_lap(STAT_OUTPUT,lap);
+
     /* frame #127 seems to be a sentinel...  I'm assuming this is NOT good data.
        So, make this the end of the dataset... */
     if (a.frame_no==127 && next_frame==127) {
@@ -356,7 +786,7 @@ main(int argc,char *argv[])
      }
 
     if (DUMP_ALL_SYNCS) {
-      double ftmp = this_sync; if (aligned==0) ftmp+=0.5;
+      double ftmp = frame_bit/8.0;
       fprintf(fptmp,"%10.10i\t%10.1f\t%8.6i\t%3.3i\n",found_cnt,ftmp,major_cnt,a.frame_no);
     }
 
@@ -366,7 +796,7 @@ main(int argc,char *argv[])
 	    are in sequence. This is done to avoid potential bit errors in 
 	    the frame_no... */
 	
-	decode_headers(&r,buf,&headers);
+	decode_headers(&r,buf,buf_bit,&headers);
 
 	if (headers==10) {
 	  decode_raw(&r,&s);
@@ -395,12 +825,18 @@ main(int argc,char *argv[])
 		this_major_cnt = 0;
 		lock = 0;
 		dataset_number--;
+		drop_sync_entries();
+		if (cpipe!=NULL) { drop_clean(cpipe,&cout); cpipe=NULL; }
+		close_segments(0);
+		flush_line_writers(); flush_async_writer();
 	        fclose(fpout);
-	        fclose(fp_hdr);
+	        if (fp_qual!=NULL) { fclose(fp_qual); fp_qual=NULL; }
+	        close_hdr_file(fp_hdr);
 	        fpout=NULL;
 	        fp_hdr=NULL;
 	        remove(outname);
 	        remove(outheadername);
+	        if (write_qual) remove(qualname);
 		optr = 0;
 	        printf("Bad timing found at start of datatake... trying again...\n");
 	      }
@@ -408,16 +844,34 @@ main(int argc,char *argv[])
 	  }
 	}
     }  /* headers < 10 */
+    if (timing) lap = stat_lap(STAT_HEADER,lap);
       
     /* because of bit errors throwing off the fill flag, we decode ALL frames as long as
        there is a lock...  It used to be this: if (a.fill_flag==0 && lock==1) {   */
       
     if (lock==1) {
 	good_cnt++;
-	int ret = decode_payload(buf,obuff,&optr);
+	if (write_qual) {
+	  q.frames++;
+	  q.fill += a.fill_flag;
+	  q.sync_errors += track.errors;
+	  if (track.errors > BIT_ERRORS) q.missed++;
+	  q.fixed += fix.fixed - fixed_before;
+	  q.unfixed += fix.non_fixed - unfixed_before;
+	}
+	int ret;
+	if (nthreads > 1) {
+	  /* only note where the frame is; the workers decode it when the line is written */
+	  ret = (optr >= SAMPLES_PER_LINE+SAMPLES_PER_FRAME);
+	  if (!ret) {
+	    if (optr < SAMPLES_PER_LINE) slot_bit[optr/SAMPLES_PER_FRAME] = frame_bit + 40;
+	    optr += SAMPLES_PER_FRAME;
+	  }
+	}
+	else ret = decode_payload(buf,buf_bit,obuff,&optr);
 	if (ret != 0)
 	   printf("ERROR: Tried to write past end of obuff - discarding; line=%i a.frame_no=%i L3=%3.3i L2=%3.3i Last=%3.3i\n",
-    	      major_cnt,a.frame_no,l3_frame,l2_frame,last_frame);
+    	      major_cnt,a.frame_no,fix.l3_frame,fix.l2_frame,fix.last_frame);
     }
     else if (a.fill_flag==1) {
 	fill_cnt++;
@@ -430,22 +884,32 @@ main(int argc,char *argv[])
         if (contiguous_miss > MAX_CONTIGUOUS_MISSES) end_of_dataset = 1;
     }
       
+    if (timing) lap = stat_lap(STAT_PAYLOAD,lap);
+      
     if (lock==0) pre_cnt++;
     last_sync = this_sync;
-    if (this_sync+(INT_FRAME_LEN*2) > file_length) {
-	printf("MANUALLY predicted end of the file (%li bytes remain)!\n",file_length-this_sync);
+    if (raw_bytes(&in,this_sync,INT_FRAME_LEN*2) == NULL) {
+	printf("MANUALLY predicted end of the file (%li bytes remain)!\n",in.length-this_sync);
 	done=1;
     }
     
+    if (stats_on && lock == 1 && (error == 1 || end_of_dataset == 1)) { timing = 1; lap = stat_begin(1); }
     if (error==1 && lock ==1) { /* we lost sync, dump data and try to establish it again */
       if (fpout!=NULL) {
-         if (this_major_cnt > 10000) {
-           fwrite(obuff,sizeof(unsigned char),SAMPLES_PER_LINE,fpout);
-	   dump_all_headers(fp_hdr,this_major_cnt,major_sync_loc,&s);
+         if (this_major_cnt > min_lines) {
+	   put_line(fpout,fp_hdr,fp_qual,out_lines,nthreads,slot_bit,obuff,&q,&qstats,this_major_cnt,major_sync_loc,&s,cpipe);
+	   out_lines++;
+	   index_line(&major_ent,dataset_number-1,this_major_cnt,&s);
+	   keep_sync_entries();
+	   if (cpipe!=NULL) { clean_lost = finish_clean(cpipe,&cout); cpipe=NULL; }
+	   close_segments(!clean_lost);
+	   flush_line_writers(); flush_async_writer();
 	   fclose(fpout); 
-	   fclose(fp_hdr);
+	   if (fp_qual!=NULL) { close_qual_file(fp_qual,&qstats); fp_qual=NULL; }
+	   close_hdr_file(fp_hdr);
 	   fpout=NULL; 
 	   fp_hdr=NULL;
+	   if (clean_lost) { remove(outname); remove(outheadername); clean_lost=0; }
 	 
            /* decode_raw(&r,&s); */
 	   display_decoded_header(major_cnt, major_sync_loc, &s, major_sync_num);
@@ -457,12 +921,18 @@ main(int argc,char *argv[])
            printf("==========================================================================\n");
 	 } else {  /* not enough data, throw it out */
 	   dataset_number--;
+	   drop_sync_entries();
+	   if (cpipe!=NULL) { drop_clean(cpipe,&cout); cpipe=NULL; }
+	   close_segments(0);
+	   flush_line_writers(); flush_async_writer();
 	   fclose(fpout);
-	   fclose(fp_hdr);
+	   if (fp_qual!=NULL) { fclose(fp_qual); fp_qual=NULL; }
+	   close_hdr_file(fp_hdr);
 	   fpout=NULL;
 	   fp_hdr=NULL;
 	   remove(outname);
 	   remove(outheadername);
+	   if (write_qual) remove(qualname);
 
            printf("==========================================================================\n");
            printf("Lost Sync - Destroyed output file %s - not enough lines %i\n",outname, this_major_cnt);
@@ -471,10 +941,12 @@ main(int argc,char *argv[])
       } 
       
       for (i=0; i<SAMPLES_PER_LINE; i++) obuff[i] = 0;
+      for (i=0; i<SLOTS_PER_LINE; i++) slot_bit[i] = -1;
       optr = 0;
       lock = 0;
       this_major_cnt=0;
       error = 0;
+      if (range_lines > 0) done = 1;	/* the range ran to the end of its output file */
     }
    
     if (end_of_dataset == 1 && lock == 1) {
@@ -484,14 +956,60 @@ main(int argc,char *argv[])
       
       /*  Do not dump this last buffer, as it contains all fill data!
       if (fpout!=NULL) fwrite(obuff,sizeof(unsigned char),SAMPLES_PER_LINE,fpout);
-      else {printf("ERROR: Unable to write output to unopened file 2\n"); exit(1); }
+      else {printf("ERROR: Unable to write output to unopened file 2\n"); exit_decoder(1); }
       */
-      if (fpout!=NULL) { fclose(fpout); fclose(fp_hdr); fpout=NULL; fp_hdr=NULL; }
+      if (cpipe!=NULL) { clean_lost = finish_clean(cpipe,&cout); cpipe=NULL; }
+      close_segments(!clean_lost);
+      if (fpout!=NULL) { flush_line_writers(); flush_async_writer(); fclose(fpout); close_hdr_file(fp_hdr); fpout=NULL; fp_hdr=NULL; }
+      if (clean_lost) { remove(outname); remove(outheadername); clean_lost=0; }
+      if (fp_qual!=NULL) { close_qual_file(fp_qual,&qstats); fp_qual=NULL; }
+      keep_sync_entries();
       for (i=0; i<SAMPLES_PER_LINE; i++) obuff[i] = 0;
+      for (i=0; i<SLOTS_PER_LINE; i++) slot_bit[i] = -1;
       optr = 0;
       end_of_dataset=0;
       lock = 0;
       this_major_cnt=0;
+      if (range_lines > 0) done = 1;
+    }
+
+    /* checkpoint once a line's first frame is in - all lines before it are written; with
+       direct I/O every ckpt_lines lines written, so the flush leaves only whole buffers */
+    if (ckpt_lines > 0 && this_frame == 0 && lock == 1 && error == 0 && fpout != NULL &&
+        (direct_io ? out_lines > 0 && out_lines % ckpt_lines == 0 : this_major_cnt % ckpt_lines == 0)) {
+      flush_line_writers(); flush_async_writer();
+      memset(&ck,0,sizeof(ck));
+      ck.dat_size = (packed ? PDAT_HEADER_SIZE : 0) + out_lines*(packed ? PACKED_LINE_BYTES : SAMPLES_PER_LINE);
+      if (fdatasync(fileno(fpout)) != 0 || (ck.hdr_size = flush_hdr_file(fp_hdr,1)) < 0 ||
+          (fp_qual != NULL && (fflush(fp_qual) != 0 || fdatasync(fileno(fp_qual)) != 0))) {
+        printf("ERROR: unable to flush output file %s for a checkpoint\n",outname); exit_decoder(1);
+      }
+      ck.qual_size = fp_qual != NULL ? QUAL_HEADER_SIZE + out_lines*QUAL_RECORD_SIZE : -1;
+      ck.q = q;
+      ck.qstats = qstats;
+      ck.in_length = in.length;
+      ck.packed = packed;
+      ck.binary_hdr = (hdr_ext[3]=='b');
+      ck.track = track;
+      ck.fix = fix;
+      ck.line = major_ent;
+      ck.s = s;
+      ck.found_cnt = found_cnt;
+      ck.major_cnt = major_cnt;
+      ck.this_major_cnt = this_major_cnt;
+      ck.pre_cnt = pre_cnt;
+      ck.fill_cnt = fill_cnt;
+      ck.good_cnt = good_cnt-1;		/* the first frame is counted again on resuming */
+      ck.max_consecutive_fills = max_consecutive_fills;
+      ck.contiguous_miss = contiguous_miss;
+      ck.partial_line_cnt = partial_line_cnt;
+      ck.dataset_number = dataset_number;
+      ck.major_sync_num = major_sync_num;
+      ck.last_bad = last_bad;
+      ck.out_lines = out_lines;
+      strcpy(ck.outname,outname);
+      strcpy(ck.outheadername,outheadername);
+      write_checkpoint(ckpt_name,&ck);
     }
     
     /*******************************************************************************************
@@ -519,19 +1037,27 @@ main(int argc,char *argv[])
     }
     ********************************************************************************************/
     
-    
-  }  /* while (!feof(fpin)&&!done&&!error) */
+    if (timing) lap = stat_lap(STAT_OUTPUT,lap);
+    if (stats_on && stat_due()) report_stats(0);
+  }  /* while (!done&&!error) */
 
   /* Write out final line of data */
   if (optr != 0) {
     if (fpout!=NULL) {
-      if (this_major_cnt > 10000) {
-        fwrite(obuff,sizeof(unsigned char),SAMPLES_PER_LINE,fpout);
-	dump_all_headers(fp_hdr,this_major_cnt,major_sync_loc,&s);
+      if (this_major_cnt > min_lines) {
+	put_line(fpout,fp_hdr,fp_qual,out_lines,nthreads,slot_bit,obuff,&q,&qstats,this_major_cnt,major_sync_loc,&s,cpipe);
+	out_lines++;
+	index_line(&major_ent,dataset_number-1,this_major_cnt,&s);
+	keep_sync_entries();
+	if (cpipe!=NULL) { clean_lost = finish_clean(cpipe,&cout); cpipe=NULL; }
+	close_segments(!clean_lost);
+	flush_line_writers(); flush_async_writer();
 	fclose(fpout); 
-	fclose(fp_hdr);
+	if (fp_qual!=NULL) { close_qual_file(fp_qual,&qstats); fp_qual=NULL; }
+	close_hdr_file(fp_hdr);
 	fpout=NULL; 
 	fp_hdr=NULL;
+	if (clean_lost) { remove(outname); remove(outheadername); clean_lost=0; }
         decode_raw(&r,&s);
         // int which = this_major_cnt;
         // print_decoded_header(outheadername,major_cnt,major_sync_loc,&s,major_sync_num,which);
@@ -539,12 +1065,18 @@ main(int argc,char *argv[])
         printf("End of Data - Closed output file %s - dumped %i range lines\n",outname, this_major_cnt);
         printf("==========================================================================\n");
       } else {  /* not enough data, throw it out */
+	drop_sync_entries();
+	if (cpipe!=NULL) { drop_clean(cpipe,&cout); cpipe=NULL; }
+	close_segments(0);
+	flush_line_writers(); flush_async_writer();
 	fclose(fpout);
-	fclose(fp_hdr);
+	if (fp_qual!=NULL) { fclose(fp_qual); fp_qual=NULL; }
+	close_hdr_file(fp_hdr);
 	fpout=NULL;
 	fp_hdr=NULL;
 	remove(outname);
 	remove(outheadername);
+	if (write_qual) remove(qualname);
         printf("==========================================================================\n");
         printf("Lost Sync - Destroyed output file %s - not enough lines %i\n",outname, this_major_cnt);
         printf("==========================================================================\n");
@@ -559,30 +1091,24 @@ main(int argc,char *argv[])
   printf("Found %i syncs in search; %i pre; %i good; %i fill (%i assumed non-fill)\n",found_cnt,pre_cnt,good_cnt,
   	fill_cnt,found_cnt-good_cnt-pre_cnt);
   printf("Found %i consecutive fill frames that were assumed to be good data\n",max_consecutive_fills); 
-  printf("Fixed %i bad frame numbers (%i unfixed)\n",fixed_frame_nos, non_fixed_frame_nos);
+  printf("Fixed %i bad frame numbers (%i unfixed)\n",fix.fixed, fix.non_fixed);
   printf("Found %i partial lines\n",partial_line_cnt);
   printf("Wrote %i lines of output\n",major_cnt);
+  print_tracker_stats(&track);
 
-  fclose(fpin);
+  stop_frame_scan();
+  stop_line_writers();
+  stop_async_writer();
+  stop_stats();
+  close_sync_index();
+  close_raw_input(&in);
 
   if (DUMP_FIXED_FRAMES==1)     fclose(frame_file1);
   if (DUMP_NON_FIXED_FRAMES==1) fclose(frame_file2);
   if (DUMP_TIMES==1)            fclose(fp_time);
-  if (DUMP_ALL_HEADERS==1)      fclose(fp_all_hdr);
+  if (DUMP_ALL_HEADERS==1)      close_hdr_file(fp_all_hdr);
   if (DUMP_ALL_SYNCS==1)        fclose(fptmp);
   
-  exit(1);
+  exit(0);
 }
 
-
-void shift_buffer(unsigned char buf[], unsigned char first_val)
-{
-	unsigned char tbuf[INT_FRAME_LEN];
-	int i;
-	
-	tbuf[0] = first_val << 4 | buf[0] >> 4;
-	for (i=0; i<INT_FRAME_LEN-4; i++)  {   /* TAL - CHECK THIS -4 here!!! */
-	  tbuf[i+1] = buf[i] << 4 | buf[i+1] >> 4;
-	}
-	for (i=0; i<INT_FRAME_LEN; i++) buf[i] = tbuf[i];
-}
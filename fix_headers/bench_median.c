@@ -0,0 +1,158 @@
+/******************************************************************************
+NAME: bench_median - checks and times the sliding window median
+
+SYNOPSIS: bench_median [updates]
+
+DESCRIPTION:
+	Runs median_window.c against a sorted copy of the window, kept by
+	insertion, after every value,
+	for every window size from 1 to 64 and for sizes up to 4096, with
+	random msec-like values, runs of equal values and steps (as a time
+	discontinuity makes).  The median checked is the lower middle value
+	of an even window, the one fix_time's old get_true_median returned.
+	Then times [updates] (default 2000000) values through windows of 400
+	and 5000 lines, against sorting the window each time for the first.
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Sliding window median check and benchmark
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "seasat_clean.h"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec + ts.tv_nsec/1.0e9);
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+  long x = *(const long *) a, y = *(const long *) b;
+  return(x < y ? -1 : x > y);
+}
+
+/* the median of the last n of the values v[0..i], by sorting */
+static long sorted_median(const long *v, int i, int n, long *tmp)
+{
+  int first = i+1 > n ? i+1-n : 0, k = i+1-first;
+
+  memcpy(tmp,v+first,k*sizeof(long));
+  qsort(tmp,k,sizeof(long),cmp_long);
+  return(tmp[(k-1)/2]);
+}
+
+/* where v goes in the n sorted values s */
+static int find_place(const long *s, int n, long v)
+{
+  int lo = 0, hi = n, mid;
+
+  while (lo < hi) {
+    mid = (lo+hi)/2;
+    if (s[mid] < v) lo = mid+1;
+    else hi = mid;
+  }
+  return(lo);
+}
+
+/* the i'th test value of kind */
+static long test_value(int kind, int i)
+{
+  switch (kind) {
+    case 0:  return(43200000 + i*607/1000 + rand()%5 - 2);	/* times on a line */
+    case 1:  return(rand()%4);				/* mostly equal */
+    case 2:  return(i%1000 < 500 ? 23 : 99);			/* steps */
+    default: return(rand() - RAND_MAX/2);			/* anything */
+  }
+}
+
+/* checks a window of size against a sorted window over count values; returns the mismatches */
+static int check_size(int size, int count, long *v, long *sorted)
+{
+  SEASAT_median_window m;
+  int kind, i, p, n, bad = 0;
+  long got, want;
+
+  for (kind=0; kind<4; kind++) {
+    init_median_window(&m,size);
+    for (i=0, n=0; i<count; i++) {
+      v[i] = test_value(kind,i);
+      if (n == size) {			/* the oldest goes out */
+        p = find_place(sorted,n,v[i-size]);
+        memmove(sorted+p,sorted+p+1,(n-p-1)*sizeof(long));
+        n--;
+      }
+      p = find_place(sorted,n,v[i]);
+      memmove(sorted+p+1,sorted+p,(n-p)*sizeof(long));
+      sorted[p] = v[i];
+      n++;
+      median_add(&m,v[i]);
+      got = median_value(&m);
+      want = sorted[(n-1)/2];
+      if (got != want) {
+        if (bad++ < 10) printf("MISMATCH: size %i kind %i value %i: %li, sorted %li\n",size,kind,i,got,want);
+        break;
+      }
+    }
+    free_median_window(&m);
+  }
+  return(bad);
+}
+
+int main(int argc, char *argv[])
+{
+  SEASAT_median_window m;
+  long updates = 2000000, i, *v, *tmp, sum = 0;
+  int size, bad = 0, sizes = 0;
+  double t0, t_sort, t_400, t_5000;
+
+  if (argc > 1) updates = atol(argv[1]);
+  if (updates < 10000) { printf("Usage: %s [updates]\n",argv[0]); exit(1); }
+
+  v   = (long *) malloc(updates*sizeof(long));
+  tmp = (long *) malloc(updates*sizeof(long));
+  if (v == NULL || tmp == NULL) { printf("ERROR: unable to allocate buffers\n"); exit(1); }
+  srand(1978);
+
+  /* Against a sort of the window, filling and then sliding
+   ------------------------------------------------------*/
+  for (size=1; size<=64; size++, sizes++) bad += check_size(size,3*size+50,v,tmp);
+  for (size=100; size<=4096; size=size*3/2+1, sizes++) bad += check_size(size,3*size,v,tmp);
+  bad += check_size(4096,3*4096,v,tmp); sizes++;
+  if (bad) { printf("FAILED: %i mismatches\n",bad); exit(1); }
+  printf("Medians identical to a sorted window for %i window sizes from 1 to 4096\n",sizes);
+
+  /* Timing
+   ------*/
+  for (i=0; i<updates; i++) v[i] = test_value(0,i);
+
+  t0 = now();
+  for (i=0; i<updates/100; i++) sum += sorted_median(v,i,400,tmp);
+  t_sort = (now()-t0)*100;
+
+  t0 = now();
+  init_median_window(&m,400);
+  for (i=0; i<updates; i++) { median_add(&m,v[i]); sum += median_value(&m); }
+  free_median_window(&m);
+  t_400 = now()-t0;
+
+  t0 = now();
+  init_median_window(&m,5000);
+  for (i=0; i<updates; i++) { median_add(&m,v[i]); sum += median_value(&m); }
+  free_median_window(&m);
+  t_5000 = now()-t0;
+
+  printf("sort the window,  400 lines: %8.3f s for %li values (from %li)\n",t_sort,updates,updates/100);
+  printf("median window,    400 lines: %8.3f s (%.0fx)\n",t_400,t_sort/t_400);
+  printf("median window,   5000 lines: %8.3f s\n",t_5000);
+  if (sum == 0) printf("\n");		/* keeps the work */
+
+  free(v); free(tmp);
+  exit(0);
+}
@@ -0,0 +1,170 @@
+/******************************************************************************
+NAME: check_line_fit - checks the time fit, and fix_headers, across time jumps
+
+SYNOPSIS: check_line_fit
+
+DESCRIPTION:
+	Feeds line_fit.c times with a jump of -300, -40, -25, 25, 40 and 300
+	msec halfway along, through windows of 400 lines (fix_headers) and
+	100 lines (fix_time).  A few times in every hundred have a bit
+	flipped or are 0, as decoded headers do.  After every line the fit
+	at the middle of the window is checked against the true time there,
+	on whichever side of the jump it is, and the lines it is more than
+	2 msec out on are counted.  A jump either way has to be followed
+	within a twentieth of the window.
+
+	Then the same lines go through the header cleaner (hdr_clean.c),
+	without a jump, with the times jumping back 40 and 300 msec, and on
+	300 and 500 lines' worth - lines lost.  A jump may leave no more
+	than a tenth of CLEAN_WINDOW lines more with a time over 1 msec from
+	the true one than there are without it, and lines lost have to be
+	found as a discontinuity of that many lines.  Exits with 1 if any
+	case fails.
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Time jump check of line_fit.c and hdr_clean.c
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "seasat_clean.h"
+
+#define CHECK_LINES	20000
+#define JUMP_LINE	(CHECK_LINES/2)
+
+static double pri = 1000.0 / 1647.0;
+
+/* the true time of line x, jump msec on, or lost lines on, from JUMP_LINE */
+static long true_msec(long x, int jump, int lost)
+{
+  if (x <= JUMP_LINE) return(41000000L + (long) (x*pri));
+  return(41000000L + (long) ((x+lost)*pri) + jump);
+}
+
+/* the time line x is read with: now and then a bit flipped, or 0 */
+static long read_msec(long x, int jump, int lost)
+{
+  long y = true_msec(x,jump,lost);
+  double r = rand() / (RAND_MAX+1.0);
+
+  if (r < 0.03) y ^= 1L << (rand()%27);
+  else if (r < 0.035) y = 0;
+  return(y);
+}
+
+/* lines the fit over a window of size is out on across a jump; 0 if all is well */
+static int check_fit(int size, int jump, unsigned int seed)
+{
+  SEASAT_line_fit f;
+  double a, b;
+  long x, m, wrong = 0;
+
+  srand(seed);
+  init_line_fit(&f,size);
+  for (x=1; x<=CHECK_LINES; x++) {
+    fit_point(&f,x,read_msec(x,jump,0));
+    if (!fit_line(&f,&a,&b)) continue;
+    m = x - size/2;
+    if (fabs(a*m+b - true_msec(m,jump,0)) > 2.0) wrong++;
+  }
+
+  printf("window %3i jump %4i: %4li lines off the time line: %s\n",size,jump,wrong,
+         wrong <= size/20 ? "ok" : "FAILED");
+  return(wrong > size/20);
+}
+
+typedef struct {
+	int	jump, lost;
+	long	wrong;		/* lines written out with the wrong time	*/
+	int	found, lines;	/* discontinuities found, and lines in the last	*/
+} hdr_check;
+
+static void check_out(void *arg, SEASAT_header_ext *h)
+{
+  hdr_check *k = (hdr_check *) arg;
+
+  if (labs(h->msec - true_msec(h->major_cnt,k->jump,k->lost)) > 1) k->wrong++;
+}
+
+static void check_dis(void *arg, const SEASAT_discontinuity *d)
+{
+  hdr_check *k = (hdr_check *) arg;
+
+  k->found++;
+  k->lines = d->offset2 - d->offset1;
+}
+
+/*-------------------------------------------------------------------------
+  Cleans headers across a jump of lost lines, or back jump msec, and
+  returns the lines with wrong times; over the lines wrong without a
+  jump, clean, by more than CLEAN_WINDOW/10, or the lines lost not
+  found, it fails.
+ -------------------------------------------------------------------------*/
+static long check_hdr(int lost, int jump, long clean, int *failed)
+{
+  static SEASAT_hdr_cleaner c;
+  SEASAT_header_ext h;
+  hdr_check k;
+  long x;
+  int out, ok;
+
+  memset(&k,0,sizeof(k));
+  k.jump = jump;
+  k.lost = lost;
+  memset(&h,0,sizeof(h));
+  h.lsd_year = 8;
+  h.station_code = 5;
+  h.day_of_year = 188;
+  h.bits_per_sample = 5;
+  h.prf_rate_code = 4;
+
+  srand(1);
+  fflush(stdout);				/* the cleaner says what it does */
+  out = dup(1);
+  dup2(open("/dev/null",O_WRONLY),1);
+  init_hdr_cleaner(&c,check_out,check_dis,&k);
+  for (x=1; x<=CHECK_LINES; x++) {
+    h.major_cnt = x;
+    h.msec = read_msec(x,jump,lost);
+    clean_header(&c,&h);
+  }
+  finish_hdr_cleaner(&c);
+  fflush(stdout);
+  dup2(out,1);
+  close(out);
+
+  ok = k.wrong - clean <= CLEAN_WINDOW/10 && (lost ? k.found == 1 && abs(k.lines-lost) <= 1 : k.found == 0);
+  if (lost) printf("hdr_clean %3i lines lost: %4li lines with wrong times, %i discontinuities (%i lines): %s\n",
+		   lost,k.wrong,k.found,k.lines,ok ? "ok" : "FAILED");
+  else printf("hdr_clean jump %4i: %4li lines with wrong times, %i discontinuities: %s\n",
+	      jump,k.wrong,k.found,ok ? "ok" : "FAILED");
+  if (!ok) (*failed)++;
+  return(k.wrong);
+}
+
+int main(int argc, char *argv[])
+{
+  int jumps[] = { -300, -40, -25, 25, 40, 300 };
+  int sizes[] = { 400, 100 };
+  int i, j, failed = 0;
+  long clean;
+
+  for (i=0; i<2; i++)
+    for (j=0; j<6; j++)
+      failed += check_fit(sizes[i],jumps[j],i*6+j+1);
+
+  clean = check_hdr(0,0,0,&failed);
+  check_hdr(0,-40,clean,&failed);
+  check_hdr(0,-300,clean,&failed);
+  check_hdr(300,0,clean,&failed);
+  check_hdr(500,0,clean,&failed);
+
+  printf("%s\n",failed ? "FAILED" : "All cases passed");
+  exit(failed ? 1 : 0);
+}
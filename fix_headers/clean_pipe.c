@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  The header cleaning stages chained together
+
+  Decoded lines go in one at a time, header and data, and come out with
+  the headers cleaned just as fix_headers, fix_time, fix_stairs and
+  dis_search would have cleaned them, blank lines put in for the
+  discontinuities.  The data of each line is held in a ring until its
+  header comes out of the gap filler, at most PIPE_LINES lines; no stage
+  holds its lines up for longer than that.
+*************************************************************************************/
+
+static void hc_out(void *arg, SEASAT_header_ext *h)
+{
+  SEASAT_clean_pipe *p = (SEASAT_clean_pipe *) arg;
+
+  gap_judged(&p->gf,h->major_cnt);
+  clean_time(&p->tc,h);
+}
+
+static void hc_dis(void *arg, const SEASAT_discontinuity *d)
+{
+  SEASAT_clean_pipe *p = (SEASAT_clean_pipe *) arg;
+
+  note_gap(&p->gf,d);
+}
+
+static void tc_out(void *arg, SEASAT_header_ext *h)
+{
+  SEASAT_clean_pipe *p = (SEASAT_clean_pipe *) arg;
+
+  clean_stairs(&p->sc,h);
+}
+
+static void sc_out(void *arg, SEASAT_header_ext *h)
+{
+  SEASAT_clean_pipe *p = (SEASAT_clean_pipe *) arg;
+
+  fill_gap(&p->gf,h);
+}
+
+static void gf_out(void *arg, SEASAT_header_ext *h, long line)
+{
+  SEASAT_clean_pipe *p = (SEASAT_clean_pipe *) arg;
+
+  p->out(p->arg,h,(line < 0) ? NULL : p->data+(line%PIPE_LINES)*p->data_size);
+  p->lines_out++;
+}
+
+static void gf_gap(void *arg, long line, long gap)
+{
+  SEASAT_clean_pipe *p = (SEASAT_clean_pipe *) arg;
+
+  if (p->gap != NULL) p->gap(p->arg,line,gap);
+}
+
+static int pipe_failed(SEASAT_clean_pipe *p)
+{
+  if (p->hc.failed || p->tc.failed || p->sc.failed || p->gf.failed) p->failed = 1;
+  return(p->failed);
+}
+
+/*-------------------------------------------------------------------------
+  Sets up the chain.  Each line's data is data_size bytes; out gets every
+  cleaned header with its data, or NULL for a blank line, and gap (if
+  not NULL) the output line and length of every gap filled in.
+ -------------------------------------------------------------------------*/
+void open_clean_pipe(SEASAT_clean_pipe *p, int data_size,
+		void (*out)(void *arg, SEASAT_header_ext *h, const unsigned char *data),
+		void (*gap)(void *arg, long line, long gap), void *arg)
+{
+  memset(p,0,sizeof(SEASAT_clean_pipe));
+  p->data = (unsigned char *) malloc((long) PIPE_LINES*data_size);
+  if (p->data == NULL) {printf("ERROR: unable to allocate clean pipe\n"); exit(1);}
+  p->data_size = data_size;
+  p->out = out;
+  p->gap = gap;
+  p->arg = arg;
+  init_hdr_cleaner(&p->hc,hc_out,hc_dis,p);
+  init_time_cleaner(&p->tc,tc_out,p);
+  init_stair_cleaner(&p->sc,sc_out,p);
+  init_gap_filler(&p->gf,gf_out,gf_gap,p);
+}
+
+/*-------------------------------------------------------------------------
+  Takes the next decoded line.  Returns 0, or -1 once a stage has failed
+  or more than PIPE_LINES lines are held up; what it was is printed.
+ -------------------------------------------------------------------------*/
+int clean_line(SEASAT_clean_pipe *p, SEASAT_header_ext *h, const void *data)
+{
+  if (p->failed) return(-1);
+  if (p->lines_in - p->gf.pend_first >= PIPE_LINES) {
+    printf("ERROR: more than %i lines held up cleaning the headers\n",PIPE_LINES);
+    p->failed = 1;
+    return(-1);
+  }
+  memcpy(p->data+(p->lines_in%PIPE_LINES)*p->data_size,data,p->data_size);
+  p->lines_in++;
+  gap_original(&p->gf,h);
+  clean_header(&p->hc,h);
+  return(pipe_failed(p) ? -1 : 0);
+}
+
+/*-------------------------------------------------------------------------
+  Writes out the lines still held up.  Returns the number of lines
+  written in all, or -1 if a stage failed.
+ -------------------------------------------------------------------------*/
+long close_clean_pipe(SEASAT_clean_pipe *p)
+{
+  long n;
+
+  if (!p->failed) {
+    finish_hdr_cleaner(&p->hc);
+    if (!pipe_failed(p)) { all_gaps_noted(&p->gf); finish_time_cleaner(&p->tc); }
+    if (!pipe_failed(p)) finish_stair_cleaner(&p->sc);
+    if (!pipe_failed(p)) finish_gap_filler(&p->gf);
+  }
+  n = pipe_failed(p) ? -1 : p->lines_out;
+  drop_clean_pipe(p);
+  return(n);
+}
+
+/* gives up on the lines held up */
+void drop_clean_pipe(SEASAT_clean_pipe *p)
+{
+  if (p->gf.pend != NULL) {
+    free(p->gf.orig_line); free(p->gf.orig_msec); free(p->gf.pend);
+    p->gf.pend = NULL;
+  }
+  if (p->data != NULL) { free(p->data); p->data = NULL; }
+  p->failed = 1;
+}
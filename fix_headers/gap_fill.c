@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Discontinuity repair as dis_search does it
+
+  fix_headers notes each discontinuity where it first sees the times
+  jump, some lines after the lines were actually lost.  The real start
+  is found by looking back over the original times for the last line
+  that fits the time fit from after the jump.  The cleaned headers are
+  then copied up to the start, the missing time is filled in with blank
+  lines, and the lines from the start to where the jump was noted are
+  given times from the fit.  Every output header gets its output line
+  number as major_cnt.
+
+  dis_search has all the discontinuities before it starts copying.  Here
+  they can also be noted while the headers come in: a cleaned header is
+  held back until no discontinuity still to be noted could start at or
+  before it.  One can not start more than GAP_RANGE lines before the
+  line it is noted at, and the hdr cleaner says (gap_judged) up to which
+  line it has noted them all.
+*************************************************************************************/
+
+#define GAP_COPY	0	/* copying lines up to the next start		*/
+#define GAP_FIX		1	/* retiming the lines after a gap		*/
+
+/*-------------------------------------------------------------------------
+  Looks back from the end of the GAP_RANGE original lines and times read
+  from line seek on for the last line that fits the time fit after the
+  discontinuity d, and sets *start to the line after it.  *start is left
+  alone if no line fits.  Returns -1 if there was no line GAP_SEARCH
+  lines clear of the fit before the first one read - the discontinuity
+  is too long to fix.
+ -------------------------------------------------------------------------*/
+int find_gap_start(const SEASAT_discontinuity *d, long seek, const long *lines, const long *times, long *start)
+{
+  int cnt = 0, ptr = GAP_RANGE;
+  double tval;
+
+  while (cnt < GAP_SEARCH && ptr > 0) {
+      ptr--;
+      tval = d->a*(lines[ptr]+d->offset2)+d->b;
+      if (fabs(tval-times[ptr])<1.5) {
+        cnt = 0;
+        *start = seek+ptr+1;
+      } else { cnt++; }
+  }
+  return(ptr <= 0 ? -1 : 0);
+}
+
+void init_gap_filler(SEASAT_gap_filler *g, void (*out)(void *arg, SEASAT_header_ext *h, long line),
+		void (*gap)(void *arg, long line, long gap), void *arg)
+{
+  memset(g,0,sizeof(SEASAT_gap_filler));
+  g->judged = -1;
+  g->state = GAP_COPY;
+  g->orig_line = (int *) malloc(GAP_KEEP*sizeof(int));
+  g->orig_msec = (long *) malloc(GAP_KEEP*sizeof(long));
+  g->pend = (SEASAT_header_ext *) malloc(PIPE_LINES*sizeof(SEASAT_header_ext));
+  if (g->orig_line == NULL || g->orig_msec == NULL || g->pend == NULL) {
+    printf("ERROR: unable to allocate gap filler\n"); exit(1);
+  }
+  g->out = out;
+  g->gap = gap;
+  g->arg = arg;
+}
+
+/* looks for the start of the next noted discontinuity if its original lines are in */
+static void locate_gaps(SEASAT_gap_filler *g)
+{
+  long lines[GAP_RANGE], times[GAP_RANGE];
+  SEASAT_discontinuity *d;
+  long seek, rec;
+  int i;
+
+  while (!g->failed && g->nfound < g->ngaps) {
+    d = &g->d[g->nfound];
+    seek = d->line - GAP_RANGE;
+    rec = (seek < 0) ? 0 : seek;	/* read from the top, as seek_header does */
+    if (rec+GAP_RANGE > g->orig_cnt && !g->all_noted) return;
+    if (g->orig_cnt == 0 || rec < g->orig_cnt-GAP_KEEP) {
+      printf("ERROR: original lines for discontinuity %i are no longer kept\n",g->nfound);
+      g->failed = 1; return;
+    }
+    printf("\tseeking to line %li\n",seek);
+    printf("\treading %i values\n",GAP_RANGE);
+    for (i=0; i<GAP_RANGE; i++, rec++) {
+      long r = (rec < g->orig_cnt) ? rec : g->orig_cnt-1;	/* past the end the last repeats */
+      lines[i] = g->orig_line[r%GAP_KEEP];
+      times[i] = g->orig_msec[r%GAP_KEEP];
+    }
+    if (find_gap_start(d,seek,lines,times,&g->save) == -1) {
+      printf("ERROR: UNABLE TO FIX THIS DISCONTINUITY - it is too long\n");
+      printf("ERROR: Probably need to increase the RANGE value in this code\n");
+      g->failed = 1; return;
+    }
+    printf("\tDISCONTINUITY #%i: start is %li\n",g->nfound,g->save);
+    g->start[g->nfound++] = g->save;
+  }
+}
+
+/* keeps the major_cnt and time of the next original (uncleaned) header */
+void gap_original(SEASAT_gap_filler *g, const SEASAT_header_ext *h)
+{
+  g->orig_line[g->orig_cnt%GAP_KEEP] = h->major_cnt;
+  g->orig_msec[g->orig_cnt%GAP_KEEP] = h->msec;
+  g->orig_cnt++;
+  if (g->nfound < g->ngaps) locate_gaps(g);
+}
+
+static int new_gap(SEASAT_gap_filler *g, const SEASAT_discontinuity *d)
+{
+  if (g->ngaps == MAX_GAPS) {
+    printf("ERROR: more than %i discontinuities\n",MAX_GAPS);
+    g->failed = 1; return(-1);
+  }
+  g->d[g->ngaps] = *d;
+  g->start[g->ngaps] = -1;
+  return(g->ngaps++);
+}
+
+/*-------------------------------------------------------------------------
+  Notes the discontinuity d, found by the hdr cleaner, and looks for its
+  start in the original headers kept.  The fit is cut to the digits
+  fix_headers writes to its .dis file, so the result is the same as
+  fix_headers followed by dis_search.
+ -------------------------------------------------------------------------*/
+void note_gap(SEASAT_gap_filler *g, const SEASAT_discontinuity *d)
+{
+  SEASAT_discontinuity r = *d;
+  char val[64];
+  int n;
+
+  if (g->failed) return;
+  sprintf(val,"%lf",d->a); r.a = atof(val);
+  sprintf(val,"%lf",d->b); r.b = atof(val);
+  if ((n = new_gap(g,&r)) == -1) return;
+
+  printf("Read discontinuity %i\n",n);
+  printf("\tline   %i\n",r.line);
+  printf("\tstart offset %i\n",r.offset1);
+  printf("\tend offset %i\n",r.offset2);
+  printf("\tCoeffs time = %lf line + %lf\n",r.a,r.b);
+  locate_gaps(g);
+}
+
+/* adds a discontinuity whose start has already been found */
+void add_gap(SEASAT_gap_filler *g, const SEASAT_discontinuity *d, long start)
+{
+  int n;
+
+  if ((n = new_gap(g,d)) == -1) return;
+  g->start[n] = g->save = start;
+  g->nfound = g->ngaps;
+}
+
+/* takes the next held back header as output line curr_line; returns its input line */
+static long next_pend(SEASAT_gap_filler *g)
+{
+  g->last = g->pend[g->pend_first%PIPE_LINES];
+  g->pend_cnt--;
+  g->last.major_cnt = g->curr_line;
+  return(g->pend_first++);
+}
+
+/* first line a discontinuity not found yet could start at */
+static long lowest_start(SEASAT_gap_filler *g)
+{
+  long low = g->all_noted ? -1 : g->judged - GAP_RANGE + 3;
+
+  if (g->applied < g->ngaps) {
+    long s = g->d[g->applied].line - GAP_RANGE + 2;
+    if (low == -1 || s < low) low = s;
+  }
+  return(low);
+}
+
+/* writes out all that can be, and fills in the gaps that can be */
+static void run_gaps(SEASAT_gap_filler *g)
+{
+  SEASAT_discontinuity *d;
+  long j, k;
+
+  while (!g->failed) {
+    if (g->applied < g->nfound) {
+      d = &g->d[g->applied];
+
+      if (g->state == GAP_COPY) {
+        /* read in and write out lines until discontinuity is hit */
+        if (g->pend_first < g->start[g->applied]) {
+          if (g->pend_cnt == 0) return;
+          k = next_pend(g);
+          g->out(g->arg,&g->last,k);
+          g->curr_line++;
+          continue;
+        }
+        printf("\twrote unchanged to line %li\n",g->curr_line);
+
+        /* repeat the header with correct times and insert blanks for length of gap */
+        printf("\tfilling in a gap of %i\n",d->offset2-d->offset1);
+        for (j=g->curr_line; j<g->curr_line+(d->offset2-d->offset1); j++) {
+          g->last.msec = d->a*(j-g->cum_off+d->offset1) + d->b;  /* a,b are referenced to original lines */
+          g->last.major_cnt = j;
+          g->out(g->arg,&g->last,-1);
+        }
+        g->curr_line = j;
+        printf("\twrote fill values to line %li\n",g->curr_line);
+        printf("\tchanging times for next %li lines\n",d->line-g->start[g->applied]);
+        g->fix_left = d->line-g->start[g->applied];
+        g->state = GAP_FIX;
+      }
+
+      /* write out the rest of this discontinuity fixing lines and times as we go */
+      if (g->fix_left > 0) {
+        if (g->pend_cnt == 0) return;
+        k = next_pend(g);
+        g->last.msec = d->a*(g->curr_line-g->cum_off+d->offset1) + d->b;
+        g->out(g->arg,&g->last,k);
+        g->curr_line++;
+        g->fix_left--;
+        continue;
+      }
+      if (g->gap != NULL) g->gap(g->arg,g->start[g->applied]+g->cum_off,d->offset2-d->offset1);
+      g->cum_off = g->cum_off + d->offset2 - d->offset1;
+      printf("\twrote fixed values to line %li (formerly %li)\n",g->curr_line,g->curr_line-g->cum_off);
+      g->applied++;
+      g->state = GAP_COPY;
+      continue;
+    }
+
+    if (g->all_noted && g->applied == g->ngaps && !g->done) {
+      printf("Done with discontinuities, reading/writing rest of the file\n");
+      g->done = 1;
+    }
+    if (g->pend_cnt == 0) return;
+    if (!g->done && g->pend_first >= lowest_start(g)) return;
+    k = next_pend(g);
+    g->out(g->arg,&g->last,k);
+    g->curr_line++;
+  }
+}
+
+/* no discontinuity will be noted at or before line from now on */
+void gap_judged(SEASAT_gap_filler *g, long line)
+{
+  if (line > g->judged) g->judged = line;
+}
+
+/* no more discontinuities will be noted */
+void all_gaps_noted(SEASAT_gap_filler *g)
+{
+  g->all_noted = 1;
+  locate_gaps(g);
+  run_gaps(g);
+}
+
+/* takes the next cleaned header */
+void fill_gap(SEASAT_gap_filler *g, SEASAT_header_ext *h)
+{
+  if (g->failed) return;
+  if (g->pend_cnt == PIPE_LINES) {
+    printf("ERROR: more than %i lines held back for discontinuities\n",PIPE_LINES);
+    g->failed = 1; return;
+  }
+  g->pend[(g->pend_first+g->pend_cnt)%PIPE_LINES] = *h;
+  g->pend_cnt++;
+  run_gaps(g);
+}
+
+/* writes out the rest; a discontinuity past the end of the input is left out */
+void finish_gap_filler(SEASAT_gap_filler *g)
+{
+  all_gaps_noted(g);
+  if (!g->failed && g->applied < g->ngaps)
+    printf("WARNING: input ended before discontinuity %i could be filled in\n",g->applied);
+  free(g->orig_line);
+  free(g->orig_msec);
+  free(g->pend);
+  g->pend = NULL;
+}
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Header cleaning as fix_headers does it
+
+  The first CLEAN_WINDOW lines are read in before any are written.  From
+  then on each line is written once CLEAN_WINDOW/2 more lines have come
+  in after it, with the slowly changing fields set to their histogram
+  medians (the most common value) over the CLEAN_WINDOW lines around it,
+  kept up to date line by line in mode windows (mode_window.c),
+  and its time checked against a linear fit of time to line (line_fit.c),
+  taken up every CLEAN_WINDOW/20 lines.  A run of
+  times off the fit by the same amount is a discontinuity - lines lost
+  in the decoding - which is noted for the gap filler.
+*************************************************************************************/
+
+#define TOLERANCE  2		/* how far off a time value can be from estimate */
+#define SHIFT_GAP  5
+
+
+/* keeps the values in range of the histograms */
+static void clamp_values(SEASAT_header_ext *s)
+{
+  if(s->station_code    >=16) s->station_code=15;
+  if(s->day_of_year    >=400) s->day_of_year=399;
+  if(s->clock_drift>=MAX_CLOCK_DRIFT) s->clock_drift=MAX_CLOCK_DRIFT-1;
+  if(s->delay   >= MAX_DELAY) s->delay=MAX_DELAY-1;
+  if(s->lsd_year        >=16) s->lsd_year=15;
+  if(s->bits_per_sample >=16) s->bits_per_sample=15;
+  if(s->prf_rate_code   >=16) s->prf_rate_code=15;
+}
+
+static void add_values(SEASAT_hdr_cleaner *c, SEASAT_header_ext *s)
+{
+  mode_add(&c->station_code_mode,s->station_code);
+  mode_add(&c->doy_mode,s->day_of_year);
+  mode_add(&c->clock_drift_mode,s->clock_drift);
+  mode_add(&c->delay_mode,s->delay);
+  mode_add(&c->lsd_year_mode,s->lsd_year);
+  mode_add(&c->bits_per_sample_mode,s->bits_per_sample);
+  mode_add(&c->prf_rate_code_mode,s->prf_rate_code);
+}
+
+static void remove_values(SEASAT_hdr_cleaner *c, SEASAT_header_ext *s)
+{
+  mode_remove(&c->station_code_mode,s->station_code);
+  mode_remove(&c->doy_mode,s->day_of_year);
+  mode_remove(&c->clock_drift_mode,s->clock_drift);
+  mode_remove(&c->delay_mode,s->delay);
+  mode_remove(&c->lsd_year_mode,s->lsd_year);
+  mode_remove(&c->bits_per_sample_mode,s->bits_per_sample);
+  mode_remove(&c->prf_rate_code_mode,s->prf_rate_code);
+}
+
+/* the histogram medians - the most common values (mode_window.c) */
+static void get_medians(SEASAT_hdr_cleaner *c)
+{
+  c->station_code_median    = mode_value(&c->station_code_mode);
+  c->doy_median             = mode_value(&c->doy_mode);
+  c->clock_drift_median     = mode_value(&c->clock_drift_mode);
+  c->lsd_year_median        = mode_value(&c->lsd_year_mode);
+  c->bits_per_sample_median = mode_value(&c->bits_per_sample_mode);
+  c->prf_rate_code_median   = mode_value(&c->prf_rate_code_mode);
+  c->delay_median           = mode_value(&c->delay_mode);
+}
+
+/* hands on one line, with the cleaned values in place of the read ones */
+static void put_values(SEASAT_hdr_cleaner *c, SEASAT_header_ext *s, long int msec)
+{
+  SEASAT_header_ext out = *s;
+
+  out.station_code    = c->station_code_median;
+  out.lsd_year        = c->lsd_year_median;
+  out.day_of_year     = c->doy_median;
+  out.msec            = msec;
+  out.clock_drift     = c->clock_drift_median;
+  out.bits_per_sample = c->bits_per_sample_median;
+  out.prf_rate_code   = c->prf_rate_code_median;
+  out.delay           = c->delay_median;
+  c->out(c->arg,&out);
+  c->ocnt++;
+}
+
+void init_hdr_cleaner(SEASAT_hdr_cleaner *c, hdr_sink out,
+		void (*dis)(void *arg, const SEASAT_discontinuity *d), void *arg)
+{
+  printf("\tinitializing histograms...\n");
+  memset(c,0,sizeof(SEASAT_hdr_cleaner));
+  c->optr = CLEAN_WINDOW/2;
+  c->out = out;
+  c->dis = dis;
+  c->arg = arg;
+  init_line_fit(&c->fit,CLEAN_WINDOW);
+  init_mode_window(&c->station_code_mode,c->station_code_hist,16);
+  init_mode_window(&c->doy_mode,c->doy_hist,400);
+  init_mode_window(&c->clock_drift_mode,c->clock_drift_hist,MAX_CLOCK_DRIFT);
+  init_mode_window(&c->delay_mode,c->delay_hist,MAX_DELAY);
+  init_mode_window(&c->lsd_year_mode,c->lsd_year_hist,16);
+  init_mode_window(&c->bits_per_sample_mode,c->bits_per_sample_hist,16);
+  init_mode_window(&c->prf_rate_code_mode,c->prf_rate_code_hist,16);
+}
+
+/* the first CLEAN_WINDOW lines are in: get going */
+static void first_window(SEASAT_hdr_cleaner *c)
+{
+  int i;
+  long int msec;
+
+  printf("\tgetting first median values\n");
+  get_medians(c);
+
+  printf("\t\tstation_code_median    = %i \n",c->station_code_median	);
+  printf("\t\tdoy_median             = %li\n",c->doy_median		);
+  printf("\t\tclock_drift_median     = %i \n",c->clock_drift_median	);
+  printf("\t\tlsd_year_median        = %i \n",c->lsd_year_median	);
+  printf("\t\tbits_per_sample_median = %i \n",c->bits_per_sample_median);
+  printf("\t\tprf_rate_code_median   = %i \n",c->prf_rate_code_median  );
+  printf("\t\tdelay_median           = %i \n",c->delay_median  	);
+
+  fit_line(&c->fit,&c->a,&c->b);
+
+  /* Now, dump out the first CLEAN_WINDOW/2 values (corrected)
+   ==========================================================*/
+  printf("\tdumping initial lines to output file\n");
+  for(i=0; i<CLEAN_WINDOW/2; i++) {
+    double tmp = c->a*c->hdr[i].major_cnt+c->b;
+    if (fabs(tmp - c->hdr[i].msec) > TOLERANCE) {
+      printf("At %i bad value %li fixed value %lf\n",c->hdr[i].major_cnt,c->hdr[i].msec,tmp);
+      msec = (long int) (tmp+0.5);
+    } else msec = c->hdr[i].msec;
+    put_values(c,&c->hdr[i],msec);
+  }
+}
+
+/* what fix_headers does before reading each line after the first CLEAN_WINDOW */
+static void next_line(SEASAT_hdr_cleaner *c)
+{
+  if ((c->icnt%10000)==0) {printf("\tcleaning line %i\n",c->icnt);}
+
+  /* Take up the time linear regression every so often; it holds
+     still in between for a discontinuity to be slid over
+   -----------------------------------------------------------*/
+  if (c->icnt%(CLEAN_WINDOW/20)==0) {
+    double old_a = c->a;
+    double old_b = c->b;
+    long x = c->hdr[c->optr].major_cnt;
+    double moved;
+    fit_line(&c->fit,&c->a,&c->b);
+    if (c->a > 0.6073 || c->a < 0.607 ) { /* BAD slope do not use, but take the time it has got to */
+      c->b = c->a*x+c->b - old_a*x;
+      c->a = old_a;
+    }
+
+    /* the fit has jumped to the times after a discontinuity: go with it
+       once the middle line has got there, if it jumped back; a jump on -
+       lines lost - is left for the window to slide over */
+    moved = c->a*x+c->b - (old_a*(x+c->offset)+old_b);
+    if (fabs(moved) > TOLERANCE && (moved > 0 || c->bad_cnt == 0 || fabs(c->save_diff+moved) > 0.9))
+      { c->a=old_a;c->b=old_b; }
+    else c->offset = 0;
+  }
+}
+
+/*-------------------------------------------------------------------------
+  Takes the next line.  The values out of range of the histograms are
+  cut back first, as fix_headers reads them.
+ -------------------------------------------------------------------------*/
+void clean_header(SEASAT_hdr_cleaner *c, SEASAT_header_ext *h)
+{
+  SEASAT_header_ext *s;
+  long int msec;
+  double diff;
+
+  if (c->failed) return;
+  if (c->icnt < CLEAN_WINDOW) {
+    s = &c->hdr[c->icnt];
+    *s = *h;
+    clamp_values(s);
+    add_values(c,s);
+    fit_point(&c->fit,s->major_cnt,s->msec);
+    c->icnt++;
+    if (c->icnt == CLEAN_WINDOW) first_window(c);
+    return;
+  }
+
+  /* take the oldest line out of the histograms and this one in
+   -----------------------------------------------------------*/
+  next_line(c);
+  remove_values(c,&c->hdr[c->curr]);
+  s = &c->hdr[c->curr];
+  *s = *h;
+  clamp_values(s);
+  c->icnt++;
+  add_values(c,s);
+  fit_point(&c->fit,s->major_cnt,s->msec);
+  get_medians(c);
+
+  /* and hand on the middle one
+   ---------------------------*/
+  s = &c->hdr[c->optr];
+  double tmp = c->a*(s->major_cnt+c->offset)+c->b;
+  diff = fabs(tmp - s->msec);
+  double sdiff = tmp - s->msec;
+
+  if (diff > TOLERANCE) {
+    printf("At %i bad value %li diff %lf cnt %i\n",s->major_cnt,s->msec,sdiff,c->bad_cnt);
+    if (c->bad_cnt > SHIFT_GAP && (fabs(sdiff-c->save_diff)<0.9))
+      {
+       printf("\tSliding time window to fit possible discontinuity...last diff %lf this diff %lf\n",
+      		c->save_diff,sdiff);
+       int dir = -1.0*(tmp - s->msec)/diff;
+       printf("\tdirection is %i\n",dir);
+       int save_offset = c->offset;
+
+       if (diff > 4000.0) {
+	 printf("ERROR: Unable to fix a gap of size %lf\n",diff);
+	 printf("ERROR: This is equivalent to %lf seconds (%.0lf lines) of missing data!!!\n\n\n",
+		 diff/1000.0,diff/1000.0*1647.0);
+	 c->failed = 1;
+	 return;
+       }
+       while (diff > 1.0 && dir==1) {
+	 c->offset+=dir;
+	 tmp = c->a*(s->major_cnt+c->offset)+c->b;
+	 diff = fabs(tmp - s->msec);
+         printf("\tat offset %i: fixed value %lf diff %lf\n",c->offset,
+	      s->major_cnt,s->msec,tmp,tmp-(double)s->msec);
+       }
+       /* the fit runs through the middle of the time steps, so the
+          next offset can be nearer still */
+       if (dir==1 && fabs(c->a*(s->major_cnt+c->offset+1)+c->b - s->msec) < diff) {
+	 c->offset++;
+	 tmp = c->a*(s->major_cnt+c->offset)+c->b;
+	 diff = fabs(tmp - s->msec);
+         printf("\tat offset %i: nearer, diff %lf\n",c->offset,tmp-(double)s->msec);
+       }
+
+       if (dir==1 && c->offset > 5) {
+	 SEASAT_discontinuity d;
+	 printf("LOCATED DISCONTINUITY AT: %i ; LINES: %i \n",s->major_cnt,c->offset);
+	 d.line = s->major_cnt;
+	 d.offset1 = save_offset;
+	 d.offset2 = c->offset;
+	 d.a = c->a;
+	 d.b = c->b;
+	 if (c->dis != NULL) c->dis(c->arg,&d);
+       }
+       c->bad_cnt = 0;
+      }
+    else
+      {
+        if (c->bad_cnt==0) { c->save_diff = sdiff; c->bad_cnt++; }
+        else {
+          if (fabs(sdiff-c->save_diff)<0.9) { c->save_diff=sdiff; c->bad_cnt++; }
+	  else { c->save_diff = sdiff; c->bad_cnt = 1; }
+        }
+      }
+    msec = (long int) (tmp+0.5);
+  } else { c->bad_cnt=0; msec = s->msec;}
+
+  c->curr = (c->curr+1)%CLEAN_WINDOW;
+  put_values(c,s,msec);
+  c->optr = (c->optr+1)%CLEAN_WINDOW;
+}
+
+/* hands on the last CLEAN_WINDOW/2 lines; fails if there were too few lines */
+void finish_hdr_cleaner(SEASAT_hdr_cleaner *c)
+{
+  int i;
+
+  if (c->failed) return;
+  if (c->icnt < CLEAN_WINDOW) {printf("ERROR: can't read from input file\n"); c->failed = 1; return;}
+  next_line(c);
+
+  printf("\tdumping final lines to output file\n");
+  for(i=0; i<CLEAN_WINDOW/2; i++) {
+    put_values(c,&c->hdr[c->optr],c->hdr[c->optr].msec);
+    c->optr = (c->optr+1)%CLEAN_WINDOW;
+  }
+}
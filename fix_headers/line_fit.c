@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Sliding window line fit of time to line
+
+  fix_headers and fix_time check each time against a straight line
+  fitted to the times of the lines around it.  yaxb fits it by least
+  squares, culls the worst point and fits again until what is left lies
+  on a line, all over from scratch at every refit: some CLEAN_WINDOW^2
+  steps each time.  A line fit keeps the least squares sums of the
+  points in the window that are on the line instead, so a refit is no
+  more than a divide:
+
+	points		the last size (major_cnt,msec), a ring
+	in[i]		point i is in the sums, that is, it was within
+			FIT_TOLERANCE of the fit when it came in
+	cnt,sx,...	the sums, kept exactly as integers from an
+			origin (x0,y0) that is moved up as the window goes
+
+  A point going out of the window comes out of the sums.  The points
+  that are off the line (bad times) are kept out of them.  A jump in
+  the times, either way, puts the points after it on another line
+  parallel to this one, so the points off the line are also checked
+  for one they agree on:
+
+	off[i]		how far point i was off the line when it came in
+	alt[i]		point i is on the other line, alt_off off this one
+	alt_cnt,asx,...	its sums, from the same origin
+
+  The lines share the slope, so it is fitted to the points on both,
+  each about its own middle; a slope from half a window would wander
+  further than fix_headers lets a fit be taken up.  Once more points
+  are on the other line than on this one, that is the line, and this
+  the other one - just as the points are half and half either side of
+  the jump, whichever way it goes.  yaxb is run on the whole window
+  only when the window has just filled, or when more than half of it
+  is on neither line (the times have drifted off it); then it is not
+  run again until a quarter of the window has gone by.
+*************************************************************************************/
+
+#define RESEED_GAP(f)	((f)->size/4)	/* points between runs of yaxb, at least */
+
+static void yaxb(double x_vec[], double y_vec[],int n, double * a,double * b);
+
+static void sum_point(SEASAT_line_fit *f, int i, int sign)
+{
+  long x = f->x[i] - f->x0, y = f->y[i] - f->y0;
+
+  f->cnt += sign;
+  f->sx  += sign*x;
+  f->sy  += sign*y;
+  f->sxx += sign*x*x;
+  f->sxy += sign*x*y;
+}
+
+/* as sum_point, for a point on the other line */
+static void sum_other(SEASAT_line_fit *f, int i, int sign)
+{
+  long x = f->x[i] - f->x0, y = f->y[i] - f->y0;
+
+  f->alt_cnt += sign;
+  f->asx  += sign*x;
+  f->asy  += sign*y;
+  f->asxx += sign*x*x;
+  f->asxy += sign*x*y;
+}
+
+/* the least squares line through the points in the sums, the slope shared with the other line */
+static void solve(SEASAT_line_fit *f)
+{
+  long double n = f->cnt, m = f->alt_cnt, d, at, a, b;
+
+  if (f->cnt < 2) return;		/* keep the line there was */
+  d  = n*f->sxx - (long double) f->sx*f->sx;
+  at = n*f->sxy - (long double) f->sx*f->sy;
+  if (f->alt_cnt >= 2) {
+    d  = m*d  + n*(m*f->asxx - (long double) f->asx*f->asx);
+    at = m*at + n*(m*f->asxy - (long double) f->asx*f->asy);
+  }
+  if (d == 0) return;
+  a = at/d;
+  b = (f->sy - a*f->sx)/n;
+  f->a = a;
+  f->b = f->y0 + b - a*f->x0;
+  if (f->alt_cnt > 0) f->alt_off = (f->asy - a*f->asx)/m - b;
+}
+
+/* sums the points in again from the oldest one */
+static void resum(SEASAT_line_fit *f)
+{
+  int i, j;
+
+  f->x0 = f->x[f->first];
+  f->y0 = f->y[f->first];
+  f->cnt = f->sx = f->sy = f->sxx = f->sxy = 0;
+  f->alt_cnt = f->asx = f->asy = f->asxx = f->asxy = 0;
+  for (j=0; j<f->n; j++) {
+    i = (f->first+j)%f->size;
+    if (f->in[i]) sum_point(f,i,1);
+    if (f->alt[i]) sum_other(f,i,1);
+  }
+  f->since_sum = 0;
+}
+
+/* is point i, off the line, as far off it as the other line? */
+static int on_other_line(SEASAT_line_fit *f, int i, double off)
+{
+  return(!f->in[i] && f->x[i] != 0 && fabs(f->off[i] - off) <= FIT_TOLERANCE);
+}
+
+/* sorts the points out against the line, and the other line if there is one, and sums them in again */
+static void sort_points(SEASAT_line_fit *f)
+{
+  int i, j, other = f->alt_cnt > 0;
+
+  f->outliers = 0;
+  for (j=0; j<f->n; j++) {
+    i = (f->first+j)%f->size;
+    f->off[i] = f->y[i] - (f->a*f->x[i]+f->b);
+    f->in[i] = f->x[i] != 0 && fabs(f->off[i]) <= FIT_TOLERANCE;
+    f->alt[i] = other && on_other_line(f,i,f->alt_off);
+    if (!f->in[i]) f->outliers++;
+  }
+  resum(f);
+  solve(f);
+}
+
+/* finds the line again with yaxb, and which points are on it */
+static void reseed(SEASAT_line_fit *f)
+{
+  double x[FIT_WINDOW], y[FIT_WINDOW];
+  int i, j;
+
+  for (j=0; j<f->n; j++) {
+    i = (f->first+j)%f->size;
+    x[j] = f->x[i];
+    y[j] = f->y[i];
+  }
+  yaxb(x,y,f->n,&f->a,&f->b);
+  f->alt_cnt = 0;
+  sort_points(f);
+  f->seeded = 1;
+  f->since_seed = 0;
+}
+
+/*-------------------------------------------------------------------------
+  Point i has come in off the line.  It is one more on the other line if
+  it is as far off as that, otherwise the points as far off as it is
+  are counted, and they are the other line if there are more of them.
+ -------------------------------------------------------------------------*/
+static void other_line(SEASAT_line_fit *f, int i)
+{
+  int j, k, cnt = 0;
+
+  if (f->x[i] == 0) return;
+  if (f->alt_cnt > 0 && on_other_line(f,i,f->alt_off)) { f->alt[i] = 1; sum_other(f,i,1); return; }
+  for (j=0; j<f->n; j++) if (on_other_line(f,(f->first+j)%f->size,f->off[i])) cnt++;
+  if (cnt <= f->alt_cnt) return;
+  f->alt_off = f->off[i];
+  for (j=0; j<f->n; j++) {
+    k = (f->first+j)%f->size;
+    f->alt[k] = on_other_line(f,k,f->alt_off);
+  }
+  resum(f);
+}
+
+/*-------------------------------------------------------------------------
+  More points are on the other line than on the line: it is the line
+  now, and the line the other one.  The points are sorted out against
+  it moved up, and again against it as fitted.
+ -------------------------------------------------------------------------*/
+static void take_other_line(SEASAT_line_fit *f)
+{
+  f->b += f->alt_off;
+  f->alt_off = -f->alt_off;
+  sort_points(f);
+  sort_points(f);
+  f->since_seed = 0;
+}
+
+/* starts a fit over a window of the last size points, size at most FIT_WINDOW */
+void init_line_fit(SEASAT_line_fit *f, int size)
+{
+  memset(f,0,sizeof(SEASAT_line_fit));
+  f->size = size;
+}
+
+/*-------------------------------------------------------------------------
+  Puts the time y of line x into the window, and the oldest point out of
+  it once the window is full.  A line numbered 0 never counts.
+ -------------------------------------------------------------------------*/
+void fit_point(SEASAT_line_fit *f, long x, long y)
+{
+  int i;
+
+  if (f->n == f->size) {
+    i = f->first;
+    if (f->in[i]) sum_point(f,i,-1);
+    else f->outliers--;
+    if (f->alt[i]) sum_other(f,i,-1);
+    f->first = (f->first+1)%f->size;
+    f->n--;
+  }
+  i = (f->first+f->n)%f->size;
+  f->x[i] = x;
+  f->y[i] = y;
+  f->n++;
+  if (f->n == 1) { f->x0 = x; f->y0 = y; }
+  f->off[i] = f->seeded ? y - (f->a*x+f->b) : 0;
+  f->in[i] = x != 0 && (!f->seeded || fabs(f->off[i]) <= FIT_TOLERANCE);
+  f->alt[i] = 0;
+  if (f->in[i]) sum_point(f,i,1);
+  else {
+    f->outliers++;
+    if (f->seeded) other_line(f,i);
+  }
+  f->since_seed++;
+
+  if (f->n < f->size) return;
+  if (!f->seeded) { reseed(f); return; }
+  if (f->alt_cnt > f->cnt) { take_other_line(f); return; }
+  if (2*(f->outliers-f->alt_cnt) > f->n && f->since_seed >= RESEED_GAP(f)) { reseed(f); return; }
+  if (++f->since_sum >= f->size) resum(f);	/* keeps the sums small */
+  solve(f);
+}
+
+/* the line fitted, time = a*line + b; 0 until the window has filled */
+int fit_line(SEASAT_line_fit *f, double *a, double *b)
+{
+  if (!f->seeded) return(0);
+  *a = f->a;
+  *b = f->b;
+  return(1);
+}
+
+/******************************************************************************
+NAME: yaxb.c
+
+SYNOPSIS:	yaxb(double x_vec[], double y_vec[], int n, double *a, double *b)
+
+DESCRIPTION:	Computes a and b for y = ax + b using linear regression
+		given double vectors y and x of length n.  Points with
+		x 0 are left out, and the worst points are culled until
+		the rest lie on the line.
+
+HISTORY:       Borowed from ASF tools and converted to double - T. Logan 10/12
+
+ALGORITHM REF:  Cheney, Ward & D. Kincaid, Numerical Mathematics and Computing,
+            2nd Editn. pp 360-362. Brooks/Cole Pub. Co., Pacific Grove, Ca.
+******************************************************************************/
+
+static void yaxb(double x_vec[], double y_vec[],int n, double * a,double * b)
+{
+ double sum_x, sum_xx, sum_xy, sum_y;
+ double d, at, bt;
+ int   i, cnt;
+ double res = 100.0;
+ double max_val, tmp, diff;
+ int    max_loc;
+
+ while (res > 0.01) {
+   sum_x = 0.0; sum_xx = 0.0;
+   sum_y = 0.0; sum_xy = 0.0;
+   cnt = 0;
+
+   for (i=0; i<n; i++) {
+      if (x_vec[i] != 0.0) {
+        sum_x += x_vec[i]; sum_y += y_vec[i];
+        sum_xx += x_vec[i] * x_vec[i];
+        sum_xy += x_vec[i] * y_vec[i];
+        cnt++;
+      }
+   }
+
+   d =  cnt * sum_xx - sum_x*sum_x;
+   at = cnt * sum_xy - sum_x*sum_y;
+   bt = sum_xx * sum_y - sum_x * sum_xy;
+   *a = at/d;
+   *b = bt/d;
+   max_val = 0.0;
+   max_loc = -1;
+
+   /* check the regression, throwing out the one input that has the highest error */
+   for (i=0; i<n; i++) {
+     if (x_vec[i] != 0.0) {
+       tmp = *a * x_vec[i] + *b;
+       diff = fabs(y_vec[i]-tmp);
+       if (diff > max_val) { max_val = diff; max_loc = i; }
+     }
+   }
+
+   if (max_loc != -1) {
+     x_vec[max_loc]=0.0;
+     y_vec[max_loc]=0.0;
+     res = max_val;
+   }
+   else  res = 0.0;
+ }
+
+ if (isnan(*a) || isnan(*b)) (*a) = (*b) = 0.0;
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Sliding window medians
+
+  A true median of msec, delay or day of year over a window of lines,
+  kept up to date as the lines go by instead of sorting the window every
+  line.  The window is a ring of slots, one a line, and each slot is in
+  one of two heaps:
+
+	lo	a max-heap of the smaller half of the values, (n+1)/2 of them
+	hi	a min-heap of the larger half, n/2 of them
+
+  so the median - the lower of the middle two for an even window, as
+  fix_time's get_true_median had it - is always at the top of lo.  Once
+  the window is full a new line takes over the slot of the oldest one,
+  where it sits in its heap, and is sifted into place; if that leaves the
+  tops of the two heaps out of order they are swapped over.  The heaps
+  stay the same size, and each line costs O(log n), so windows of
+  thousands of lines are no dearer than one of a hundred.
+*************************************************************************************/
+
+#define LO(p)	(p)		/* where[] of a slot at lo[p]	*/
+#define HI(p)	(-(p)-1)	/* ... and at hi[p]		*/
+
+static void put_lo(SEASAT_median_window *m, int p, int s) { m->lo[p] = s; m->where[s] = LO(p); }
+static void put_hi(SEASAT_median_window *m, int p, int s) { m->hi[p] = s; m->where[s] = HI(p); }
+
+/* moves the slot at lo[p] up or down to where it belongs in the max-heap */
+static void sift_lo(SEASAT_median_window *m, int p)
+{
+  int s = m->lo[p], c;
+  long v = m->v[s];
+
+  while (p > 0 && m->v[m->lo[(p-1)/2]] < v) { put_lo(m,p,m->lo[(p-1)/2]); p = (p-1)/2; }
+  while ((c = 2*p+1) < m->nlo) {
+    if (c+1 < m->nlo && m->v[m->lo[c+1]] > m->v[m->lo[c]]) c++;
+    if (m->v[m->lo[c]] <= v) break;
+    put_lo(m,p,m->lo[c]);
+    p = c;
+  }
+  put_lo(m,p,s);
+}
+
+/* moves the slot at hi[p] up or down to where it belongs in the min-heap */
+static void sift_hi(SEASAT_median_window *m, int p)
+{
+  int s = m->hi[p], c;
+  long v = m->v[s];
+
+  while (p > 0 && m->v[m->hi[(p-1)/2]] > v) { put_hi(m,p,m->hi[(p-1)/2]); p = (p-1)/2; }
+  while ((c = 2*p+1) < m->nhi) {
+    if (c+1 < m->nhi && m->v[m->hi[c+1]] < m->v[m->hi[c]]) c++;
+    if (m->v[m->hi[c]] >= v) break;
+    put_hi(m,p,m->hi[c]);
+    p = c;
+  }
+  put_hi(m,p,s);
+}
+
+/* swaps the tops of the heaps over if the larger half has the smaller value */
+static void order_tops(SEASAT_median_window *m)
+{
+  int s;
+
+  if (m->nhi == 0 || m->v[m->lo[0]] <= m->v[m->hi[0]]) return;
+  s = m->lo[0];
+  put_lo(m,0,m->hi[0]);
+  put_hi(m,0,s);
+  sift_lo(m,0);
+  sift_hi(m,0);
+}
+
+/* starts a window of the last size values; exits if it can not be had */
+void init_median_window(SEASAT_median_window *m, int size)
+{
+  memset(m,0,sizeof(SEASAT_median_window));
+  m->size = size;
+  m->v = (long *) malloc(size*sizeof(long));
+  m->where = (int *) malloc(size*sizeof(int));
+  m->lo = (int *) malloc(((size+1)/2)*sizeof(int));
+  m->hi = (int *) malloc((size/2+1)*sizeof(int));
+  if (m->v == NULL || m->where == NULL || m->lo == NULL || m->hi == NULL) {
+    printf("ERROR: unable to allocate median window\n"); exit(1);
+  }
+}
+
+void free_median_window(SEASAT_median_window *m)
+{
+  free(m->v);
+  free(m->where);
+  free(m->lo);
+  free(m->hi);
+  memset(m,0,sizeof(SEASAT_median_window));
+}
+
+/* the next value comes into the window, and the oldest goes out once it is full */
+void median_add(SEASAT_median_window *m, long v)
+{
+  int s, p;
+
+  if (m->n == m->size) {
+    s = m->first;
+    m->first = (m->first+1)%m->size;
+    m->v[s] = v;
+    p = m->where[s];
+    if (p >= 0) sift_lo(m,p);
+    else sift_hi(m,-p-1);
+    order_tops(m);
+    return;
+  }
+
+  s = (m->first+m->n)%m->size;
+  m->v[s] = v;
+  m->n++;
+  if (m->nlo == m->nhi) {		/* lo takes one more */
+    put_lo(m,m->nlo++,s);
+    sift_lo(m,m->nlo-1);
+  } else {
+    put_hi(m,m->nhi++,s);
+    sift_hi(m,m->nhi-1);
+  }
+  order_tops(m);
+}
+
+/* the median of the values in the window, the lower middle one of an even number */
+long median_value(SEASAT_median_window *m)
+{
+  if (m->n == 0) { printf("Error getting median value of an empty window\n"); exit(1); }
+  return(m->v[m->lo[0]]);
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Sliding window modes
+
+  The header cleaners set the slowly changing fields to their histogram
+  "median" - the most common value over a window of lines, the smallest
+  such value if there is a tie.  Finding it by scanning the histogram
+  costs a look at every bin for every line, over 4000 of them for the
+  clock drift.  A mode window keeps the answer up to date instead, as
+  lines come into and go out of the window:
+
+	count[v]	lines in the window with value v (the histogram)
+	nfreq[n]	values that n lines in the window have
+	top		the highest count
+	mode		the smallest value with the top count
+
+  A line coming in can only raise its value's count by one, so either
+  its value is the new mode or the mode stays put.  A line going out of
+  the mode's count either leaves the mode with the top count to itself
+  (nfreq says whether) or ties it with other values; only then, rarely
+  for a header field, is the histogram scanned for the smallest of them,
+  and not until the mode is next asked for.
+*************************************************************************************/
+
+/* starts a window over the values 0..size-1, keeping counts in count[size] */
+void init_mode_window(SEASAT_mode_window *w, int *count, int size)
+{
+  memset(w,0,sizeof(SEASAT_mode_window));
+  memset(count,0,size*sizeof(int));
+  w->count = count;
+  w->size = size;
+  w->mode = -1;
+}
+
+/* a line with value v comes into the window */
+void mode_add(SEASAT_mode_window *w, int v)
+{
+  int n = ++w->count[v];
+
+  w->nfreq[n-1]--;
+  w->nfreq[n]++;
+  if (n > w->top) { w->top = n; w->mode = v; w->stale = 0; }
+  else if (n == w->top && !w->stale && v < w->mode) w->mode = v;
+}
+
+/* a line with value v goes out of the window */
+void mode_remove(SEASAT_mode_window *w, int v)
+{
+  int n = w->count[v]--;
+
+  w->nfreq[n]--;
+  w->nfreq[n-1]++;
+  if (n != w->top) return;
+  if (w->nfreq[n] == 0) {
+    w->top = n-1;
+    if (w->top == 0 || w->nfreq[n-1] == 1) { w->mode = w->top ? v : -1; w->stale = 0; }
+    else w->stale = 1;
+  } else if (v == w->mode) w->stale = 1;
+}
+
+/* the most common value in the window, the smallest of them on a tie */
+int mode_value(SEASAT_mode_window *w)
+{
+  int i;
+
+  if (w->stale) {
+    for (i=0; w->count[i] != w->top; i++);
+    w->mode = i;
+    w->stale = 0;
+  }
+  if (w->mode == -1) { printf("Error getting histogram median value\n"); exit(1); }
+  return(w->mode);
+}
@@ -7,24 +7,31 @@ SYNOPSIS: fix_dis <indiscon> <indat> <inorghdr> <incleanhdr> <outdat> <outhdr>
 
 DESCRIPTION:
 	<indiscon> 	input discontinuity file
-	<in>    	original input data and header files
+	<in>    	original input data and header files (<in>.hdrb is
+			used instead of <in>.hdr if it is there)
 	<incleanhdr> 	already cleaned header file to use values from
-	<out> 		output data and header files with fill lines
+	<out> 		output data and header files with fill lines; the
+			header file is <out>.hdrb if <incleanhdr> is binary
+	The data file is <in>.pdat if there is one, <in>.dat otherwise, and
+	the output data file takes the same form (<out>.pdat or <out>.dat).
 	
 This program follows the following algorithm:
+    READ the line numbers and times of the original header file, once
     FOR each discontinuity from indiscon:
-	read in RANGE lines before the discontinuity
+	take the GAP_RANGE lines before the discontinuity from those
 	scan backwards from discontinuity to find actual start
 	save result
     FOR each discontinuity start found:
-    	read in/write out data and header until discontinuity start
+    	copy data and write out header until discontinuity start
 	for length of discontinuity offset gap:
 		write out header with corrected time and line
-		insert blank line into output data file
+		leave a blank line in the output data file
 	for length of run from start to previously found location:
 		write out header with corrected time and line
-		read in/write out data line
+		copy data line
     WRITE out the rest of the file
+    The data lines are copied a run at a time by the kernel (copy_file_range,
+    see copy_dat_lines), and the blank lines are left as holes in the file.
     
 
 EXTERNAL ASSOCIATES:
@@ -39,6 +46,11 @@ PROGRAM HISTORY:
     VERS:   DATE:  AUTHOR:      PURPOSE:
     ---------------------------------------------------------------
     1.0	    11/12   T. Logan     Seasat Proof of Concept Project - ASF
+    1.1	    10/26  	        Reads and writes .hdr or .hdrb header files
+    1.2	    10/26  	        Reads and writes packed .pdat data files
+    1.3	    10/26  	        Search and repair moved to gap_fill.c, shared with seasat_decoder -F
+    1.4	    10/26  	        Original header file read once, not once a discontinuity
+    1.5	    10/26  	        Data lines copied in runs with copy_file_range, blank lines left as holes
     
 HARDWARE/SOFTWARE LIMITATIONS:
 
@@ -76,61 +88,125 @@ BUGS:
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include "seasat_clean.h"
+#include "seasat_dat.h"
 
-typedef struct {
-        int      major_cnt;
-	long int  major_sync_loc;
-	int     lsd_year;
-	int     station_code;
-	long int msec;
-	int      day_of_year;
-	int      clock_drift;  
-	int     no_scan_indicator_bit;
-	int     bits_per_sample;
-	int     mfr_lock_bit;
-	int     prf_rate_code;
-	int     delay;
-	int     scu_bit;
-	int     sdf_bit;
-	int     adc_bit;
-	int     time_gate_bit;
-	int     local_prf_bit;
-	int     auto_prf_bit;
-	int     prf_lock_bit;
-	int     local_delay_bit;
-}  SEASAT_header_ext;
+#define SAMPLES_PER_LINE 13680		/* decoded samples per output line */
 
-int get_values(FILE *fp,SEASAT_header_ext *s);
-void write_values(FILE *fp,SEASAT_header_ext *s);
+static SEASAT_dat_file *fpin_dat, *fpout_dat;
+static SEASAT_hdr_file *fpout_hdr;
+static FILE *fpdis;
+static int total=0;
 
-#define RANGE 	     3000
-#define SEARCH 	     200
-#define MAX_DISCONS  1000
-#define SAMPLES_PER_LINE 13680		/* decoded samples per output line */
+/* The output data lines waiting to go out: a run of input lines to copy,
+   or of blank lines */
+static long in_next = 0;		/* the next input line */
+static long run_from, run_n = 0;	/* copy run_n input lines from run_from */
+static long blank_n = 0;		/* ... or leave blank_n blank lines */
+static long last_in = -1;		/* the input line last copied, -1 a blank */
+static int  past_end = 0;		/* gone past the end of the input lines */
+
+/* writes out the waiting run of lines */
+static void put_run(void)
+{
+  if (run_n > 0) copy_dat_lines(fpin_dat,run_from,fpout_dat,total-run_n-blank_n,run_n);
+  if (blank_n > 0) blank_dat_lines(fpout_dat,total-blank_n,blank_n);
+  run_n = blank_n = 0;
+}
+
+/*-------------------------------------------------------------------------
+  Past the end of the input data file a line is whatever read_dat_line
+  leaves in the buffer, as it was when every line was read in and written
+  out: the last line read or blanked, or the start of a short last line.
+  These are still read and written one at a time.
+ -------------------------------------------------------------------------*/
+static void put_past_end(long line)
+{
+  static unsigned char buf[SAMPLES_PER_LINE];
+
+  if (!past_end) {
+    if (last_in >= 0) { seek_dat_line(fpin_dat,last_in); read_dat_line(fpin_dat,buf); }
+    seek_dat_line(fpin_dat,count_dat_lines(fpin_dat));
+    past_end = 1;
+  }
+  if (line >= 0) read_dat_line(fpin_dat,buf);
+  else memset(buf,0,SAMPLES_PER_LINE);
+  seek_dat_line(fpout_dat,total);
+  write_dat_line(fpout_dat,buf);
+}
+
+/* writes out one line: the next input line, or a blank one if line is -1 */
+static void put_line(void *arg, SEASAT_header_ext *h, long line)
+{
+  if (!past_end && line >= 0 && in_next < count_dat_lines(fpin_dat)) {
+    if (blank_n > 0) put_run();
+    if (run_n == 0) run_from = in_next;
+    last_in = in_next++;
+    run_n++;
+  } else if (!past_end && line < 0) {
+    if (run_n > 0) put_run();
+    last_in = -1;
+    blank_n++;
+  } else {
+    put_run();
+    put_past_end(line);
+  }
+  total++;
+  write_header(fpout_hdr,h);
+}
+
+static void put_gap(void *arg, long line, long gap)
+{
+  fprintf(fpdis,"%li\t%li\n",line,gap);
+}
+
+/*-------------------------------------------------------------------------
+  Reads the major_cnt and msec of every line of the original header file
+  name into *lines and *times, and returns the number of lines.  Exits if
+  the file can not be read or has no lines.
+ -------------------------------------------------------------------------*/
+static long read_times(const char *name, long **lines, long **times)
+{
+  SEASAT_hdr_file *fp;
+  SEASAT_header_ext h;
+  long n = 0, size;
+
+  fp = open_hdr_file(name,"r");
+  if (fp == NULL) {printf("ERROR: Unable to open original input header file %s\n",name); exit(1);}
+  size = count_headers(fp);
+  if (size < 1) size = 65536;
+  *lines = (long *) malloc(size*sizeof(long));
+  *times = (long *) malloc(size*sizeof(long));
+  while (*lines != NULL && *times != NULL && read_header(fp,&h) == 20) {
+    if (n == size) {
+      size *= 2;
+      *lines = (long *) realloc(*lines,size*sizeof(long));
+      *times = (long *) realloc(*times,size*sizeof(long));
+      if (*lines == NULL || *times == NULL) break;
+    }
+    (*lines)[n] = h.major_cnt;
+    (*times)[n] = h.msec;
+    n++;
+  }
+  if (*lines == NULL || *times == NULL) {printf("ERROR: unable to allocate original header times\n"); exit(1);}
+  if (n == 0) {printf("ERROR: no lines in original input header file %s\n",name); exit(1);}
+  close_hdr_file(fp);
+  return(n);
+}
 
 main (int argc, char *argv[])
 {
-  double a[MAX_DISCONS];
-  double b[MAX_DISCONS];
-  int line[MAX_DISCONS];
-  int start[MAX_DISCONS];
-  int offset1[MAX_DISCONS];
-  int offset2[MAX_DISCONS];
+  SEASAT_discontinuity d[MAX_GAPS];
+  long int start[MAX_GAPS];
   
-  int i, j, seek, val, dcnt = 0;
-  int curr_line, cum_off;
+  int i, seek, dcnt = 0;
   SEASAT_header_ext *hdr;
-  long int tbuff[RANGE];
-  long int lbuff[RANGE];
-  FILE *fpdis, *fpin;
-  FILE *fpin_dat, *fpin_hdr;
-  FILE *fpout_dat, *fpout_hdr;
-  int cnt, ptr;
+  long int tbuff[GAP_RANGE];
+  long int lbuff[GAP_RANGE];
+  long int *orig_line = NULL, *orig_msec = NULL, norig = 0, rec;
+  SEASAT_hdr_file *fpin_hdr;
+  SEASAT_gap_filler *g;
   long int save;
-  double tval;
-  char cmd[256];
-  unsigned char buf[SAMPLES_PER_LINE];
-  int  total=0;
   
   char indat[256], inhdr[256];
   char outdat[256], outhdr[256], outdis[256];
@@ -145,10 +221,8 @@ main (int argc, char *argv[])
      exit(1);
   }
 
-  strcpy(indat,argv[2]); strcat(indat,".dat");
-  strcpy(inhdr,argv[2]); strcat(inhdr,".hdr");
-  strcpy(outdat,argv[4]); strcat(outdat,".dat");
-  strcpy(outhdr,argv[4]); strcat(outhdr,".hdr");
+  find_dat_file(argv[2],indat);
+  find_hdr_file(argv[2],inhdr);
   strcpy(outdis,argv[4]); strcat(outdis,".dis");
 
   hdr = (SEASAT_header_ext *) malloc(sizeof(SEASAT_header_ext));
@@ -156,64 +230,54 @@ main (int argc, char *argv[])
   fpdis = fopen(argv[1],"r");
   if (fpdis==NULL) { printf("WARNING: no discontinuity file found, assuming none needed\n"); }
   else { 
-    while (fscanf(fpdis,"%i %i %i %lf %lf\n",&line[dcnt],&offset1[dcnt],&offset2[dcnt],&a[dcnt],&b[dcnt])==5) {
+    while (dcnt < MAX_GAPS &&
+           fscanf(fpdis,"%i %i %i %lf %lf\n",&d[dcnt].line,&d[dcnt].offset1,&d[dcnt].offset2,&d[dcnt].a,&d[dcnt].b)==5) {
       printf("Read discontinuity %i\n",dcnt);
-      printf("\tline   %i\n",line[dcnt]);
-      printf("\tstart offset %i\n",offset1[dcnt]);
-      printf("\tend offset %i\n",offset2[dcnt]);
-      printf("\tCoeffs time = %lf line + %lf\n",a[dcnt],b[dcnt]);
+      printf("\tline   %i\n",d[dcnt].line);
+      printf("\tstart offset %i\n",d[dcnt].offset1);
+      printf("\tend offset %i\n",d[dcnt].offset2);
+      printf("\tCoeffs time = %lf line + %lf\n",d[dcnt].a,d[dcnt].b);
 
-      /* Read in RANGE lines before the discontinuity from the original (uncleaned) header file */  
-      fpin = fopen(inhdr,"r");
-      if (fpin == NULL) {printf("ERROR: Unable to open original input header file %s\n",inhdr); exit(1);}
-      seek = line[dcnt] - RANGE;
+      /* Take the GAP_RANGE lines before the discontinuity from the original (uncleaned) header file,
+         read in the first time through; from the top if that is past it, the last again past the end */
+      if (norig == 0) norig = read_times(inhdr,&orig_line,&orig_msec);
+      seek = d[dcnt].line - GAP_RANGE;
       printf("\tseeking to line %i\n",seek);
-      for (i=0;i<seek;i++) get_values(fpin,hdr);
-      printf("\treading %i values\n",RANGE);
-      for (i=0;i<RANGE;i++) {
-        get_values(fpin,hdr);
-	lbuff[i] = hdr->major_cnt;
-	tbuff[i] = hdr->msec;
+      printf("\treading %i values\n",GAP_RANGE);
+      rec = (seek < 0) ? 0 : seek;
+      for (i=0;i<GAP_RANGE;i++,rec++) {
+	lbuff[i] = orig_line[rec < norig ? rec : norig-1];
+	tbuff[i] = orig_msec[rec < norig ? rec : norig-1];
       }
       
       /* Scan backwards to find the start of this discontinuity */
-      cnt = 0;
-      ptr = RANGE;
-      while (cnt < SEARCH && ptr > 0) {
-          ptr--;
-	  tval = a[dcnt]*(lbuff[ptr]+offset2[dcnt])+b[dcnt];
-	  // printf("At %i, time=%li calc=%lf diff %lf cnt %i\n",
-	  //  seek+ptr,tbuff[ptr],tval,fabs(tval-tbuff[ptr]),cnt);
-	  if (fabs(tval-tbuff[ptr])<1.5) {
-	    cnt = 0;
-	    save = seek+ptr+1;
-	  } else { cnt++; }
-      }
-
-      if (ptr <= 0) { 
+      if (find_gap_start(&d[dcnt],seek,lbuff,tbuff,&save) == -1) { 
         printf("ERROR: UNABLE TO FIX THIS DISCONTINUITY - it is too long\n");
 	printf("ERROR: Probably need to increase the RANGE value in this code\n");
 	exit(1);
       }
       
-      printf("\tDISCONTINUITY #%i: start is %i\n",dcnt,save);
+      printf("\tDISCONTINUITY #%i: start is %li\n",dcnt,save);
       start[dcnt]=save;
-      fclose(fpin);
       dcnt++;
     }
     fclose(fpdis);
+    free(orig_line);
+    free(orig_msec);
   }
   printf("Finished finding discontinuity starting points...\n");
   printf("Applying results to data and header files...\n");
   
   /* Now apply each of the discontinuities to the .dat and .hdr files */
-  fpin_hdr = fopen(argv[3],"r");
+  fpin_hdr = open_hdr_file(argv[3],"r");
   if (fpin_hdr == NULL) {printf("ERROR: Unable to open input cleaned header file %s\n",argv[3]); exit(1);}
-  fpin_dat = fopen(indat,"rb");
+  fpin_dat = open_dat_file(indat,"r");
   if (fpin_dat == NULL) {printf("ERROR: Unable to open input data file %s\n",indat); exit(1);}  
-  fpout_hdr = fopen(outhdr,"w");
+  strcpy(outhdr,argv[4]); strcat(outhdr,fpin_hdr->binary ? ".hdrb" : ".hdr");
+  fpout_hdr = open_hdr_file(outhdr,"w");
   if (fpout_hdr == NULL) {printf("ERROR: Unable to open output header file %s\n",outhdr); exit(1);}
-  fpout_dat = fopen(outdat,"wb");
+  strcpy(outdat,argv[4]); strcat(outdat,fpin_dat->packed ? ".pdat" : ".dat");
+  fpout_dat = open_dat_file(outdat,"w");
   if (fpout_dat == NULL) {printf("ERROR: Unable to open output data file %s\n",outdat); exit(1);}  
   
   if (dcnt>0) {
@@ -222,97 +286,26 @@ main (int argc, char *argv[])
     fprintf(fpdis,"LINE\tGAP\n");
   }
 
-  curr_line = 0; cum_off = 0;
-  
-  /* Deal with the discontinuities one at a time */
-  for (i=0; i<dcnt; i++) {
-    /* read in and write out lines until discontinuity is hit */
-    for (j=curr_line; j<start[i]+cum_off; j++) {
-      fread(buf,SAMPLES_PER_LINE,1,fpin_dat);
-      fwrite(buf,SAMPLES_PER_LINE,1,fpout_dat); total++;
-      get_values(fpin_hdr,hdr);
-      hdr->major_cnt=j;
-      write_values(fpout_hdr,hdr);
-    }
-    curr_line = j;
-    printf("\twrote unchanged to line %i\n",curr_line);
-    for (j=0; j<SAMPLES_PER_LINE; j++) buf[j] = 0;
-    
-    /* repeat the header with correct times and insert blanks for length of gap */
-    printf("\tfilling in a gap of %i\n",offset2[i]-offset1[i]);
-    for (j=curr_line; j<curr_line+(offset2[i]-offset1[i]); j++) {
-      fwrite(buf,SAMPLES_PER_LINE,1,fpout_dat); total++;
-      hdr->msec = a[i]*(j-cum_off+offset1[i]) + b[i];  /* correct for fact that a,b are referenced to original lines */
-      hdr->major_cnt = j;
-      write_values(fpout_hdr,hdr);
-    }
-    curr_line = j;
-    printf("\twrote fill values to line %i\n",curr_line);
-    printf("\tchanging times for next %i lines\n",line[i]-start[i]);
-   
-    /* read in and write out the rest of this discontinuity fixing lines and times as we go */   
-    for (j=curr_line; j<curr_line+(line[i]-start[i]); j++)  {
-      fread(buf,SAMPLES_PER_LINE,1,fpin_dat);
-      fwrite(buf,SAMPLES_PER_LINE,1,fpout_dat); total++;
-      get_values(fpin_hdr,hdr);
-      hdr->major_cnt=j;
-      hdr->msec = a[i]*(j-cum_off+offset1[i]) + b[i];
-      write_values(fpout_hdr,hdr);
-    }
-    curr_line = j;
-    fprintf(fpdis,"%i\t%i\n",start[i]+cum_off,offset2[i]-offset1[i]);
-    cum_off = cum_off + offset2[i] - offset1[i];
-    printf("\twrote fixed values to line %i (formerly %i)\n",curr_line,curr_line-cum_off);
-    
-  }
+  /* Copy the cleaned lines over, putting in the gaps (see gap_fill.c) */
+  g = (SEASAT_gap_filler *) malloc(sizeof(SEASAT_gap_filler));
+  if (g == NULL) {printf("ERROR: unable to allocate gap filler\n"); exit(1);}
+  init_gap_filler(g,put_line,put_gap,NULL);
+  for (i=0; i<dcnt; i++) add_gap(g,&d[i],start[i]);
+  all_gaps_noted(g);
+  while (read_header(fpin_hdr,hdr) == 20) fill_gap(g,hdr);
+  finish_gap_filler(g);
+  if (g->failed) exit(1);
+  put_run();
   
   if (dcnt>0) {fclose(fpdis);}
   
-  /* Deal with the rest of the file */
-  printf("Done with discontinuities, reading/writing rest of the file\n");  
-  val = get_values(fpin_hdr,hdr);
-  while (val==20) {
-    fread(buf,SAMPLES_PER_LINE,1,fpin_dat);
-    fwrite(buf,SAMPLES_PER_LINE,1,fpout_dat); total++;
-    hdr->major_cnt = curr_line;
-    write_values(fpout_hdr,hdr);
-    val = get_values(fpin_hdr,hdr);
-    curr_line++;
-  }
-  
   printf("\n");
   printf("Done correcting file, wrote %i lines of output\n\n",total);
 
-  fclose(fpin_dat);
-  fclose(fpin_hdr);
-  fclose(fpout_dat);
-  fclose(fpout_hdr);
+  close_dat_file(fpin_dat);
+  close_hdr_file(fpin_hdr);
+  close_dat_file(fpout_dat);
+  close_hdr_file(fpout_hdr);
 
   exit(0);
 }
-
-
-int get_values(FILE *fp,SEASAT_header_ext *s) {
-  int val;
-  if (s==NULL) {printf("empty pointer passed to get_values\n"); exit(1);}
-  val = fscanf(fp,"%i %li %i %i %i %li %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n",
-    &(s->major_cnt),&(s->major_sync_loc),&(s->station_code),&(s->lsd_year),
-    &(s->day_of_year),&(s->msec),&(s->clock_drift),&(s->no_scan_indicator_bit),
-    &(s->bits_per_sample),&(s->mfr_lock_bit),&(s->prf_rate_code),&(s->delay),
-    &(s->scu_bit),&(s->sdf_bit),&(s->adc_bit),&(s->time_gate_bit),&(s->local_prf_bit),
-    &(s->auto_prf_bit),&(s->prf_lock_bit),&(s->local_delay_bit));
-  return(val);
-}
-
-void write_values(FILE *fp,SEASAT_header_ext *s) {
-  if (s==NULL) {printf("empty pointer passed to write values\n"); exit(1);}
-  if (fp==NULL) {printf("null file pointer passed to write values\n"); exit(1);}
-  fprintf(fp,"%i %li %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n",
-    s->major_cnt,s->major_sync_loc,s->station_code,s->lsd_year,
-    s->day_of_year,s->msec,s->clock_drift,s->no_scan_indicator_bit,
-    s->bits_per_sample,s->mfr_lock_bit,s->prf_rate_code,s->delay,
-    s->scu_bit,s->sdf_bit,s->adc_bit,s->time_gate_bit,s->local_prf_bit,
-    s->auto_prf_bit,s->prf_lock_bit,s->local_delay_bit);
-}
-
-	
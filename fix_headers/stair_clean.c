@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Stair cleaning as fix_stairs does it
+
+  The satellite clock only ticks every few lines, so the decoded times
+  come in runs of one value.  Each line after the first of a run is given
+  the run's time plus the PRI for every line it is into the run.
+*************************************************************************************/
+
+void init_stair_cleaner(SEASAT_stair_cleaner *c, hdr_sink out, void *arg)
+{
+  memset(c,0,sizeof(SEASAT_stair_cleaner));
+  c->out = out;
+  c->arg = arg;
+}
+
+void clean_stairs(SEASAT_stair_cleaner *c, SEASAT_header_ext *h)
+{
+  double pri = 1000* (1.0 / 1647.0);
+
+  if (c->failed) return;
+  c->icnt++;
+  if (c->n > 0 && h->msec == c->base.msec) {
+    SEASAT_header_ext out = *h;
+    double offset = pri*(double)c->n;
+    out.msec = c->base.msec + (int) offset;
+    c->out(c->arg,&out);
+    c->ocnt++;
+    c->n++;
+    if ((int)offset>=1) c->fcnt++;
+    return;
+  }
+
+  /* a new time starts a new run
+   ----------------------------*/
+  if ((c->icnt%10000)==0) {printf("\tcleaning line %i\n",c->icnt);}
+  c->base = *h;
+  c->out(c->arg,h);
+  c->ocnt++;
+  c->n = 1;
+}
+
+/* fails if there were no lines at all */
+void finish_stair_cleaner(SEASAT_stair_cleaner *c)
+{
+  if (c->failed) return;
+  if (c->icnt == 0) {printf("ERROR: can't read from input file\n"); c->failed = 1;}
+}
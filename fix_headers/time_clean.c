@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "seasat_clean.h"
+
+/*************************************************************************************
+  Time cleaning as fix_time does it
+
+  Each line's time is checked against a robust linear fit of time to
+  line over the TIME_WINDOW lines around it (line_fit.c), taken up
+  every RECALC_SIZE lines.  A time too far off the fit is mended, in
+  order of preference, by putting back a single flipped bit, by taking
+  the time of the line before if it and the line after agree, or from
+  the fit itself.
+*************************************************************************************/
+
+#define RECALC_SIZE     1	/* the line fit keeps up line by line */
+#define TOLERANCE  513		/* how far off a time value can be from estimate */
+#define PRI  0.60716454159
+
+#define DISPLAY_FITS 0  /* set to 1 if you want to see each linear fit */
+#define SAVE_FITS    0  /* set to 1 if you want to create the line_fits.txt file */
+
+static int bitfix(double sdiff,long int *msec);
+
+/* hands on one line with its time replaced by msec */
+static void put_values(SEASAT_time_cleaner *c, SEASAT_header_ext *s, long int msec)
+{
+  SEASAT_header_ext out = *s;
+
+  out.msec = msec;
+  c->out(c->arg,&out);
+  c->ocnt++;
+}
+
+void init_time_cleaner(SEASAT_time_cleaner *c, hdr_sink out, void *arg)
+{
+  memset(c,0,sizeof(SEASAT_time_cleaner));
+  c->optr = TIME_WINDOW/2;
+  c->out = out;
+  c->arg = arg;
+  init_line_fit(&c->fit,TIME_WINDOW);
+  if (SAVE_FITS==1) {
+    c->fpfit=fopen("line_fits.txt","w");
+    if (c->fpfit==NULL) {printf("ERROR: Unable to open output file line_fits.txt\n"); exit(1);}
+  }
+}
+
+/* mends the times of the TIME_WINDOW/2 lines from optr on that are off the fit */
+static void dump_lines(SEASAT_time_cleaner *c, int i0)
+{
+  SEASAT_header_ext *s;
+  long int msec;
+  double tmp;
+  int i;
+
+  for(i=0; i<TIME_WINDOW/2; i++) {
+    s = &c->hdr[(i0+i)%TIME_WINDOW];
+    tmp = c->a*s->major_cnt+c->b;
+    if (fabs(tmp - s->msec) > TOLERANCE) {
+      msec = (long int) (tmp+0.5);
+      printf("At %i bad value %li fixed value %li\n",s->major_cnt,s->msec,msec);
+      s->msec = msec;
+      c->fcnt++;
+    } else { msec = s->msec; }
+
+    put_values(c,s,msec);
+  }
+}
+
+/* what fix_time does before reading each line after the first TIME_WINDOW */
+static void next_line(SEASAT_time_cleaner *c)
+{
+  if ((c->icnt%10000)==0) {printf("\tcleaning line %i\n",c->icnt);}
+
+  /* Redo the time linear regression every so often
+   -----------------------------------------------*/
+  if ( (c->icnt%RECALC_SIZE) == 0 ) {
+    double old_a = c->a;
+    double old_b = c->b;
+    if (DISPLAY_FITS==1) printf("ICNT %i: ",c->icnt);
+    fit_line(&c->fit,&c->a,&c->b);
+    if (DISPLAY_FITS==1) printf("Found coefficients y = %lf x + %lf ",c->a,c->b);
+    if (c->a > 0.6073 || c->a < 0.607 ) {  /* BAD do not use*/
+      if (old_a > 0.6073 || old_a < 0.607) { /* last were bad too! */
+        if (fabs(old_a-PRI)<fabs(c->a-PRI)) { /* this is worse, don't use it */
+          c->a=old_a;
+	  c->b=old_b;
+	  if (DISPLAY_FITS==1) printf("\tDiscarded\n");
+	} else {
+	  if (DISPLAY_FITS==1) printf("\tUsed\n");
+	  if (SAVE_FITS==1) fprintf(c->fpfit,"OK: %i %lf %lf\n",c->icnt,c->a,c->b);
+	  c->offset = 0;
+	}
+      } else {
+        c->a=old_a;
+	c->b=old_b;
+	if (DISPLAY_FITS==1) printf("\tDiscarded\n");
+      }
+    } else {
+      if (DISPLAY_FITS==1) printf("\tUsed\n");
+      if (SAVE_FITS==1) fprintf(c->fpfit,"GOOD: %i %lf %lf\n",c->icnt,c->a,c->b);
+      c->offset = 0;
+    }
+  }
+}
+
+void clean_time(SEASAT_time_cleaner *c, SEASAT_header_ext *h)
+{
+  SEASAT_header_ext *s;
+  long int msec;
+  double diff, sdiff, tmp;
+
+  if (c->failed) return;
+  if (c->icnt < TIME_WINDOW) {
+    c->hdr[c->icnt] = *h;
+    fit_point(&c->fit,h->major_cnt,h->msec);
+    c->icnt++;
+    if (c->icnt == TIME_WINDOW) {
+      fit_line(&c->fit,&c->a,&c->b);
+
+      /* Now, dump out the first TIME_WINDOW/2 values (corrected)
+       =========================================================*/
+      printf("\tdumping initial lines to output file\n");
+      dump_lines(c,0);
+    }
+    return;
+  }
+
+  next_line(c);
+  c->hdr[c->curr] = *h;
+  fit_point(&c->fit,h->major_cnt,h->msec);
+  c->icnt++;
+
+  s = &c->hdr[c->optr];
+  tmp = c->a*(s->major_cnt+c->offset)+c->b;
+  diff = fabs(tmp - s->msec);
+  sdiff = tmp - s->msec;
+  msec = s->msec;
+
+  if (diff > TOLERANCE) {
+    if (bitfix(sdiff,&msec) == 1) {
+      printf("At %i bad value %li fixed value %li diff %lf (bit fix fill)\n",
+        s->major_cnt,s->msec,msec,sdiff);
+	c->bit_cnt++; c->fcnt++;
+    } else {
+      SEASAT_header_ext *minus1 = &c->hdr[(c->optr-1+TIME_WINDOW)%TIME_WINDOW];
+      SEASAT_header_ext *plus1  = &c->hdr[(c->optr+1)%TIME_WINDOW];
+      if (minus1->msec!=s->msec &&    /* this is not the same as last */
+          minus1->msec==plus1->msec &&   /* next is the same as last     */
+          ((double)minus1->msec-tmp)<20) {    /* within +20 of the linear trend */
+        msec = minus1->msec;  // fills in gaps in flat lines
+        printf("At %6i bad value %9li fixed value %9li diff %9li (gap fill %9.6lf)\n",
+          s->major_cnt,s->msec,msec,s->msec-msec,((double)minus1->msec-tmp) );
+        c->fill_cnt++; c->fcnt++;
+      } else {
+        msec = (long int) (tmp+0.5);
+        printf("At %i bad value %li fixed value %li diff %li (linear fill)\n",
+          s->major_cnt,s->msec,msec,s->msec-msec);
+        c->line_cnt++; c->fcnt++;
+      }
+    }
+  }
+
+  c->curr = (c->curr+1)%TIME_WINDOW;
+  put_values(c,s,msec);
+  c->optr = (c->optr+1)%TIME_WINDOW;
+}
+
+/* mends and hands on the last TIME_WINDOW/2 lines; fails if there were too few lines */
+void finish_time_cleaner(SEASAT_time_cleaner *c)
+{
+  if (c->failed) return;
+  if (c->icnt < TIME_WINDOW) {printf("ERROR: can't read from input file\n"); c->failed = 1; return;}
+  next_line(c);
+
+  /* Finally, dump out the last TIME_WINDOW/2 values (corrected)
+   =============================================================*/
+  printf("\tdumping final lines to output file\n");
+  dump_lines(c,c->optr);
+  if (SAVE_FITS==1) fclose(c->fpfit);
+}
+
+static int bitfix(double sdiff,long int *msec)
+{
+  long int target=16;
+  int n;
+  for (n=4; n<34; n++) {
+    target = target * 2;
+    if (fabs(fabs(sdiff)-(double)target)<2.0) {
+      if (sdiff<0) *msec=*msec-target;
+      else *msec=*msec+target;
+      return(1);
+    }
+  }
+  return(0);
+}
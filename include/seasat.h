@@ -4,8 +4,26 @@
 #define INT_FRAME_LEN	 148
 #define SAMPLES_PER_LINE 13680		/* decoded samples per output line */
 #define SAMPLES_PER_FRAME 228		/* encoded samples per minor frame - this should be calculated? */
+#define SLOTS_PER_LINE	 60		/* minor frames that make up one output line */
 #define BIT_ERRORS	 7		/* number of allowable bit errors in the sync code */
 #define MAX_CONTIGUOUS_MISSES 60	/* number of allowable fill data frames before the end of a dataset */
+#define PATCH_LINES	 16384		/* azimuth FFT block of an ROI processing patch */
+#define PATCH_GOOD	 11600		/* ... of which this many lines are good */
+
+#define STAT_SYNC	 0		/* decoder stages timed with -I (stats.c) */
+#define STAT_FRAME	 1
+#define STAT_HEADER	 2
+#define STAT_PAYLOAD	 3
+#define STAT_OUTPUT	 4
+#define STAT_UNPACK	 5		/* ... and on the writer threads */
+#define STAT_WRITE	 6
+#define STAT_STAGES	 7
+#define STAT_SAMPLE	 16		/* the main loop times one frame in this many */
+
+#include "seasat_hdr.h"		/* decoded header files, .hdr and .hdrb */
+#include "seasat_dat.h"		/* decoded data files, .dat and .pdat */
+#include "seasat_qual.h"		/* per line quality files, .qual */
+#include "seasat_clean.h"		/* header cleaning stages */
 
 typedef struct {
     int year;/*Gregorian year (e.g. 1998)*/
@@ -147,26 +165,165 @@ typedef struct {
 	unsigned char     local_delay_bit;
 }  SEASAT_header;
 
-int find_sync(FILE *fp);
-int find_sync_no_advance(FILE *fp, int *be);
-int find_unaligned_sync_no_advance(FILE *fp, int *be);
-int find_one_sync(FILE *fp);
+/***************************************************************************************
+  Raw input file, mapped into memory for the frame walker or read as a stream
+***************************************************************************************/
+
+typedef struct {
+	unsigned char *data;	/* start of the mapped raw file, or the stream ring */
+	long	       length;	/* total length of the raw file in bytes; for a	*/
+				/* stream, the bytes read so far		*/
+	long	       pos;	/* current byte offset, used by the sync search */
+	int	       fd;
+	int	       stream;	/* set when reading a pipe through the ring	*/
+	int	       eof;	/* set once length is the whole file		*/
+} SEASAT_raw_input;
+
+typedef struct {
+	long	bit;		/* bit offset of the line's first minor frame	*/
+	long	msec;		/* time of the line				*/
+	int	dataset;	/* output file number (_NNN)			*/
+	int	line;		/* line number as in the header file		*/
+	int	cnt;		/* frames since the last 147 byte frame		*/
+	int	aligned;	/* 1 byte aligned, 0 nibble aligned, 2 147 bytes */
+} SEASAT_sync_entry;	/* one line of the raw file sync index (.sidx)	*/
+
+typedef struct {
+	long	bit;		/* bit offset of the sync code in the raw file	*/
+	int	errors;		/* number of bits that differ from the sync code */
+} SEASAT_sync_hit;
+
+typedef struct {
+	long	bit;		/* predicted bit offset of the next minor frame	 */
+	int	cnt;		/* frames since the last 147 byte frame		 */
+	int	aligned;	/* 1 byte aligned, 0 nibble aligned, 2 147 bytes */
+	int	misses;		/* consecutive syncs that were not there	 */
+	int	rephase;	/* cnt is not known since the last reacquire	 */
+	int	errors;		/* sync code bit errors of the frame handed out	 */
+	long	frames;		/* frames handed out				 */
+	long	verified;	/* ... with the sync code where it was predicted */
+	long	missed;		/* ... carried through without one		 */
+	int	losses;		/* times TRACK_MAX_MISSES was reached		 */
+	int	reacquired;	/* times the frames were found again		 */
+	long	skipped_bits;	/* total distance jumped when reacquiring	 */
+} SEASAT_frame_tracker;
+
+typedef struct {
+	int	this_frame;	/* frame number as repaired			 */
+	int	last_frame, l2_frame, l3_frame;	/* the three before that	 */
+	int	last_max_frame_no; /* last frame number of the line before	 */
+	int	frames_this_line;
+	long	frames;		/* frame numbers looked at			 */
+	int	fixed;		/* frame numbers repaired			 */
+	int	non_fixed;	/* ... found bad but left alone			 */
+	int	display;	/* print each repair				 */
+	int	report;		/* print the ones left alone			 */
+} SEASAT_frame_fixer;
+
+typedef struct {
+	long	in_length;	/* length of the raw file			*/
+	int	packed;		/* writing .pdat files				*/
+	int	binary_hdr;	/* writing .hdrb files				*/
+	SEASAT_frame_tracker track;	/* just past the line's first frame	*/
+	SEASAT_frame_fixer fix;
+	SEASAT_sync_entry line;	/* the line's first frame			*/
+	SEASAT_header s;	/* last headers decoded				*/
+	int	found_cnt, major_cnt, this_major_cnt;
+	int	pre_cnt, fill_cnt, good_cnt;
+	int	max_consecutive_fills, contiguous_miss, partial_line_cnt;
+	int	dataset_number, major_sync_num;
+	long	last_bad;
+	long	out_lines;	/* lines in the output file			*/
+	long	dat_size;	/* length of the output file with them		*/
+	long	hdr_size;	/* ... and of its header file			*/
+	long	qual_size;	/* ... and of its quality file, if there is one	*/
+	SEASAT_line_quality q;	/* the line so far				*/
+	SEASAT_sample_stats qstats; /* the lines before it			*/
+	char	outname[256], outheadername[256];
+} SEASAT_checkpoint;	/* where the decoder stood at the start of a line */
+
+int open_raw_input(const char *name, SEASAT_raw_input *in);
+const unsigned char *raw_bytes(SEASAT_raw_input *in, long loc, int len);
+int raw_byte_at(SEASAT_raw_input *in, long bit);
+void close_raw_input(SEASAT_raw_input *in);
+
+int find_sync(SEASAT_raw_input *in);
+int find_sync_no_advance(SEASAT_raw_input *in, int *be);
+int find_unaligned_sync_no_advance(SEASAT_raw_input *in, int *be);
+int find_one_sync(SEASAT_raw_input *in);
+int scan_syncs(SEASAT_raw_input *in, long start_bit, long end_bit, SEASAT_sync_hit *hits, int max_hits);
+long find_next_sync(SEASAT_raw_input *in, long start_bit, int *be);
+const char *sync_scan_kernel_name(void);
+int use_sync_scan_kernel(const char *name);
+int sync_errors_at(SEASAT_raw_input *in, long bit);
+long find_confirmed_sync(SEASAT_raw_input *in, long bit);
+void init_frame_tracker(SEASAT_frame_tracker *t, long start_bit);
+long track_next_frame(SEASAT_frame_tracker *t, SEASAT_raw_input *in);
+int track_next_frameno(SEASAT_frame_tracker *t, SEASAT_raw_input *in);
+void print_tracker_stats(SEASAT_frame_tracker *t);
+void seek_frame_tracker(SEASAT_frame_tracker *t, long bit, int cnt);
+int tracker_frame_cnt(SEASAT_frame_tracker *t);
+void init_frame_fixer(SEASAT_frame_fixer *f, int display, int report);
+int fix_frame_no(SEASAT_frame_fixer *f, int frame_no, int next_frame, int lock, int line);
+int open_sync_index(const char *name);
+void add_sync_entry(const SEASAT_sync_entry *e);
+void keep_sync_entries(void);
+void drop_sync_entries(void);
+void close_sync_index(void);
+SEASAT_sync_entry *read_sync_index(const char *name, long *n);
+long find_sync_line(const SEASAT_sync_entry *e, long n, int dataset, int line);
+long find_sync_time(const SEASAT_sync_entry *e, long n, long from, long start, long end, int inside);
+int survey_raw_files(const char *catalog, int stride, int nfiles, char **files);
 int bit_errors(unsigned char ref, unsigned char pat);
-void shift_buffer(unsigned char *buf, unsigned char first_val);
 void display_aux(SEASAT_raw_header *r, int field);
 void decode_raw(SEASAT_raw_header *r, SEASAT_header *s);
 void display_decoded_header(int major_cnt, long int this_sync, SEASAT_header *s, int found_cnt);
 void print_decoded_header(char *outheadername,int major_cnt,long int this_sync,
 			SEASAT_header *s,int found_cnt, int which);
-int get_next_frameno(FILE *fpin, int aligned);
+int get_next_frameno(SEASAT_raw_input *in, long bit);
 void create_input_tle_file(julian_date target_date,hms_time target_time,const char *ofile);
 void get_next_tle_time(FILE *fpin, int *this_year, int *this_day, int *this_msec);
 int time2rev(julian_date target_date,hms_time target_time);
 void propagate_state_vector(const char* infile);
-void decode_headers(SEASAT_raw_header *r, unsigned char *buf, int *header);
-int decode_payload(unsigned char *buf, unsigned char *obuff, int *optr);
+void decode_headers(SEASAT_raw_header *r, const unsigned char *buf, int bit_offset, int *header);
+int decode_payload(const unsigned char *buf, int bit_offset, unsigned char *obuff, int *optr);
+void start_line_writers(SEASAT_raw_input *in, int nthreads, int packed);
+void queue_line(int fd, long line, const long *slot_bit, int qual_fd, const SEASAT_line_quality *q,
+		SEASAT_sample_stats *stats);
+void flush_line_writers(void);
+void stop_line_writers(void);
+void start_frame_scan(SEASAT_raw_input *in, int nthreads, long start_bit);
+int frame_sync_errors(SEASAT_raw_input *in, long bit);
+int frame_byte_at(SEASAT_raw_input *in, long bit);
+void stop_frame_scan(void);
+#define DIRECT_LINES 256		/* lines in a whole number of 4096 byte blocks */
+void start_async_writer(int direct, int packed);
+void write_line_async(int fd, const unsigned char *line);
+void flush_async_writer(void);
+void stop_async_writer(void);
+void run_batch(const char *manifest, int workers, int io_slots, char *inname, char *outbase);
+void io_throttle_begin(void);
+void io_throttle_end(void);
+void write_checkpoint(const char *name, const SEASAT_checkpoint *c);
+int read_checkpoint(const char *name, SEASAT_checkpoint *c);
 void fix_state_vectors(int year, int julianDay, int hour, int min, double sec);
-void dump_all_headers(FILE *fp_all_hdrs,int major_cnt,long int major_sync_loc,SEASAT_header *s);
+void fill_header_ext(SEASAT_header_ext *h,int major_cnt,long int major_sync_loc,SEASAT_header *s);
+void dump_all_headers(SEASAT_hdr_file *fp_all_hdrs,int major_cnt,long int major_sync_loc,SEASAT_header *s);
+void open_segments(const char *base, const char *datname, int patches, const char *dat_ext,
+		   const char *hdr_ext, int packed);
+void add_segment_line(const SEASAT_header_ext *h);
+int close_segments(int keep);
+extern int stats_on;
+long stat_clock(void);
+void start_stats(const char *name, int period, const SEASAT_frame_tracker *t, const SEASAT_frame_fixer *f,
+		 const long *in_pos, const int *frames, const int *lines);
+long stat_begin(int w);
+long stat_lap(int stage, long lap);
+void stat_thread_time(int stage, long start, long bytes);
+void stat_frame(int errors);
+int stat_due(void);
+void report_stats(int final);
+void stop_stats(void);
 
 
 
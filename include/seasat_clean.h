@@ -0,0 +1,230 @@
+/***************************************************************************************
+  Header cleaning stages
+
+	fix_headers, fix_time, fix_stairs and dis_search each clean up the
+	decoded headers one way.  Their algorithms are kept here as stages
+	that take one header at a time and hand each cleaned header on as
+	soon as it is settled, so they can run one file at a time in the
+	tools or be chained in memory over a few thousand lines while the
+	data is decoded (seasat_decoder -F, clean_pipe.c):
+
+	    hdr cleaner	  (fix_headers) moving histogram medians of the
+			  slowly changing fields, times checked against a
+			  robust linear fit, time discontinuities noted
+	    time cleaner  (fix_time) bad times mended by a bit fix, a gap
+			  fill or the linear fit
+	    stair cleaner (fix_stairs) runs of one time spread out over
+			  the PRI
+	    gap filler	  (dis_search) finds where each discontinuity
+			  starts and puts in blank lines for the time missing
+
+	Every stage gives its out function the headers it is done with, in
+	order.  The gap filler also says which input line goes with each
+	header, or -1 for an inserted blank line.  A stage that fails sets
+	failed and ignores the rest of its input.
+***************************************************************************************/
+
+#ifndef SEASAT_CLEAN_H
+#define SEASAT_CLEAN_H
+
+#include "seasat_hdr.h"
+
+#define CLEAN_WINDOW	400	/* lines the hdr cleaner takes medians over	*/
+#define TIME_WINDOW	100	/* lines the time cleaner fits times over	*/
+#define GAP_RANGE	3000	/* lines looked back over for a gap's start	*/
+#define GAP_SEARCH	200	/* lines off the fit that end the look back	*/
+#define GAP_KEEP	8192	/* original headers the gap filler keeps	*/
+#define MAX_GAPS	1000	/* discontinuities in one file			*/
+#define PIPE_LINES	4096	/* lines held up in a clean_pipe at most	*/
+#define MODE_WINDOW	CLEAN_WINDOW	/* lines a mode window holds at most	*/
+#define FIT_WINDOW	CLEAN_WINDOW	/* lines a line fit holds at most	*/
+#define FIT_TOLERANCE	2.0	/* msec off the line a time can be and count	*/
+
+#define MAX_DOY	  400		/* day of year, but close enough!       */
+#define MAX_DELAY 64    	/* one extra because we are not 1 based */
+#define MAX_CLOCK_DRIFT  4097	/* 12 bit field */
+
+typedef void (*hdr_sink)(void *arg, SEASAT_header_ext *h);
+
+typedef struct {
+	int	line;		/* major_cnt the discontinuity was found at	*/
+	int	offset1;	/* line offset of the time fit before it ...	*/
+	int	offset2;	/* ... and after it				*/
+	double	a, b;		/* time = a*(major_cnt+offset) + b		*/
+} SEASAT_discontinuity;
+
+typedef struct {
+	int	*count;		/* lines in the window with each value		*/
+	int	size;		/* values 0..size-1				*/
+	int	nfreq[MODE_WINDOW+1];	/* values with each count		*/
+	int	top, mode;	/* highest count, and the smallest value with it */
+	int	stale;		/* mode to be looked for again			*/
+} SEASAT_mode_window;
+
+typedef struct {
+	long	*v;		/* values of the lines in the window, a ring	*/
+	int	*where;		/* ... where each is in the heaps		*/
+	int	*lo, *hi;	/* max-heap of the smaller half, min-heap of the larger */
+	int	nlo, nhi;
+	int	size, n, first;	/* window length, values in it, oldest		*/
+} SEASAT_median_window;
+
+typedef struct {
+	long	x[FIT_WINDOW], y[FIT_WINDOW];	/* line and time of the points, a ring */
+	char	in[FIT_WINDOW];	/* ... and whether each is in the sums		*/
+	double	off[FIT_WINDOW];	/* ... how far each was off the line	*/
+	char	alt[FIT_WINDOW];	/* ... whether each is on the other line */
+	int	size, n, first;	/* window length, points in it, oldest		*/
+	int	outliers;	/* points not in the sums			*/
+	double	alt_off;	/* the other line: the line moved up this much	*/
+	long	alt_cnt, asx, asy, asxx, asxy;	/* ... and the sums of its points */
+	long	x0, y0;		/* origin of the sums				*/
+	long	cnt, sx, sy, sxx, sxy;
+	double	a, b;		/* time = a*line + b				*/
+	int	seeded;		/* the line has been found			*/
+	int	since_seed, since_sum;	/* points since yaxb, and since resumming */
+} SEASAT_line_fit;
+
+typedef struct {
+	SEASAT_header_ext hdr[CLEAN_WINDOW];
+	int	icnt, ocnt, curr, optr;
+	int	station_code_hist[16], doy_hist[MAX_DOY], clock_drift_hist[MAX_CLOCK_DRIFT];
+	int	delay_hist[MAX_DELAY], lsd_year_hist[16], bits_per_sample_hist[16], prf_rate_code_hist[16];
+	SEASAT_mode_window station_code_mode, doy_mode, clock_drift_mode, delay_mode;
+	SEASAT_mode_window lsd_year_mode, bits_per_sample_mode, prf_rate_code_mode;
+	int	station_code_median, doy_median, clock_drift_median, lsd_year_median;
+	int	bits_per_sample_median, prf_rate_code_median, delay_median;
+	SEASAT_line_fit fit;
+	double	a, b, save_diff;
+	int	offset, bad_cnt;
+	int	failed;
+	hdr_sink out;
+	void	(*dis)(void *arg, const SEASAT_discontinuity *d);
+	void	*arg;
+} SEASAT_hdr_cleaner;
+
+typedef struct {
+	SEASAT_header_ext hdr[TIME_WINDOW];
+	int	icnt, ocnt, curr, optr;
+	int	fcnt, bit_cnt, fill_cnt, line_cnt;	/* times fixed, and how	*/
+	SEASAT_line_fit fit;
+	double	a, b;
+	int	offset;
+	int	failed;
+	FILE	*fpfit;
+	hdr_sink out;
+	void	*arg;
+} SEASAT_time_cleaner;
+
+typedef struct {
+	SEASAT_header_ext base;	/* first line of the current run of one time	*/
+	int	n;		/* lines in the run so far			*/
+	int	icnt, ocnt, fcnt;
+	int	failed;
+	hdr_sink out;
+	void	*arg;
+} SEASAT_stair_cleaner;
+
+typedef struct {
+	SEASAT_discontinuity d[MAX_GAPS];
+	long	start[MAX_GAPS];	/* first line of each, -1 until found	*/
+	int	ngaps;			/* noted				*/
+	int	nfound;			/* ... and their starts found		*/
+	int	applied;		/* ... and filled in			*/
+	int	all_noted;		/* no more will be noted		*/
+	int	done;			/* ... and all of them filled in	*/
+	long	judged;			/* no discontinuity will be noted at or
+					   before this major_cnt		*/
+	long	save;			/* last start found			*/
+	int	*orig_line;		/* major_cnt and msec of the last	*/
+	long	*orig_msec;		/* GAP_KEEP original headers		*/
+	long	orig_cnt;
+	SEASAT_header_ext *pend;	/* cleaned headers not yet placed, a	*/
+	long	pend_first, pend_cnt;	/* ring of PIPE_LINES			*/
+	SEASAT_header_ext last;		/* header last written for a line	*/
+	int	state;
+	long	fix_left;		/* lines left to retime			*/
+	long	curr_line;		/* output lines so far			*/
+	long	cum_off;		/* blank lines put in so far		*/
+	int	failed;
+	void	(*out)(void *arg, SEASAT_header_ext *h, long line);
+	void	(*gap)(void *arg, long line, long gap);
+	void	*arg;
+} SEASAT_gap_filler;
+
+typedef struct {
+	SEASAT_hdr_cleaner   hc;
+	SEASAT_time_cleaner  tc;
+	SEASAT_stair_cleaner sc;
+	SEASAT_gap_filler    gf;
+	unsigned char *data;		/* the lines held up, a ring		*/
+	int	data_size;		/* bytes of each			*/
+	long	lines_in, lines_out;
+	int	failed;
+	void	(*out)(void *arg, SEASAT_header_ext *h, const unsigned char *data);
+	void	(*gap)(void *arg, long line, long gap);
+	void	*arg;
+} SEASAT_clean_pipe;
+
+/* moving modes - mode_window.c
+ ------------------------------*/
+void init_mode_window(SEASAT_mode_window *w, int *count, int size);
+void mode_add(SEASAT_mode_window *w, int v);
+void mode_remove(SEASAT_mode_window *w, int v);
+int  mode_value(SEASAT_mode_window *w);
+
+/* moving medians - median_window.c
+ ----------------------------------*/
+void init_median_window(SEASAT_median_window *m, int size);
+void free_median_window(SEASAT_median_window *m);
+void median_add(SEASAT_median_window *m, long v);
+long median_value(SEASAT_median_window *m);
+
+/* time to line fits - line_fit.c
+ --------------------------------*/
+void init_line_fit(SEASAT_line_fit *f, int size);
+void fit_point(SEASAT_line_fit *f, long x, long y);
+int  fit_line(SEASAT_line_fit *f, double *a, double *b);
+
+/* fix_headers - hdr_clean.c
+ --------------------------*/
+void init_hdr_cleaner(SEASAT_hdr_cleaner *c, hdr_sink out,
+		void (*dis)(void *arg, const SEASAT_discontinuity *d), void *arg);
+void clean_header(SEASAT_hdr_cleaner *c, SEASAT_header_ext *h);
+void finish_hdr_cleaner(SEASAT_hdr_cleaner *c);
+
+/* fix_time - time_clean.c
+ ------------------------*/
+void init_time_cleaner(SEASAT_time_cleaner *c, hdr_sink out, void *arg);
+void clean_time(SEASAT_time_cleaner *c, SEASAT_header_ext *h);
+void finish_time_cleaner(SEASAT_time_cleaner *c);
+
+/* fix_stairs - stair_clean.c
+ ---------------------------*/
+void init_stair_cleaner(SEASAT_stair_cleaner *c, hdr_sink out, void *arg);
+void clean_stairs(SEASAT_stair_cleaner *c, SEASAT_header_ext *h);
+void finish_stair_cleaner(SEASAT_stair_cleaner *c);
+
+/* dis_search - gap_fill.c
+ ------------------------*/
+int  find_gap_start(const SEASAT_discontinuity *d, long seek, const long *lines, const long *times, long *start);
+void init_gap_filler(SEASAT_gap_filler *g, void (*out)(void *arg, SEASAT_header_ext *h, long line),
+		void (*gap)(void *arg, long line, long gap), void *arg);
+void gap_original(SEASAT_gap_filler *g, const SEASAT_header_ext *h);
+void note_gap(SEASAT_gap_filler *g, const SEASAT_discontinuity *d);
+void add_gap(SEASAT_gap_filler *g, const SEASAT_discontinuity *d, long start);
+void gap_judged(SEASAT_gap_filler *g, long line);
+void all_gaps_noted(SEASAT_gap_filler *g);
+void fill_gap(SEASAT_gap_filler *g, SEASAT_header_ext *h);
+void finish_gap_filler(SEASAT_gap_filler *g);
+
+/* all four chained - clean_pipe.c
+ --------------------------------*/
+void open_clean_pipe(SEASAT_clean_pipe *p, int data_size,
+		void (*out)(void *arg, SEASAT_header_ext *h, const unsigned char *data),
+		void (*gap)(void *arg, long line, long gap), void *arg);
+int  clean_line(SEASAT_clean_pipe *p, SEASAT_header_ext *h, const void *data);
+long close_clean_pipe(SEASAT_clean_pipe *p);
+void drop_clean_pipe(SEASAT_clean_pipe *p);
+
+#endif
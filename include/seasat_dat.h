@@ -0,0 +1,72 @@
+/***************************************************************************************
+  Decoded SEASAT data files
+
+	A decoded range line is SAMPLES_PER_LINE 5-bit samples.  The original
+	.dat file holds each sample in a byte, SAMPLES_PER_LINE bytes a line,
+	with nothing else in the file.  The packed .pdat form holds the same
+	lines with the samples packed MSB first, 8 samples to every 5 bytes -
+	the same packing as in the raw SEASAT frames:
+
+	    file header, 32 bytes:
+		char  magic[8]		"SEASATP5"
+		int32 version		PDAT_VERSION
+		int32 header_size	32
+		int32 samples_per_line	13680
+		int32 bytes_per_line	8550
+		int64 spare
+
+	    lines, PACKED_LINE_BYTES each
+
+	All binary values are little endian.  Every line has the same size,
+	so line n starts at byte PDAT_HEADER_SIZE + n*PACKED_LINE_BYTES and
+	any line can be read directly.  Readers tell the two forms apart by
+	the magic number; writers use the packed form when the file name ends
+	in .pdat.
+***************************************************************************************/
+
+#ifndef SEASAT_DAT_H
+#define SEASAT_DAT_H
+
+#include <stdio.h>
+
+#ifndef SAMPLES_PER_LINE
+#define SAMPLES_PER_LINE 13680		/* decoded samples per output line */
+#endif
+#define PACKED_LINE_BYTES (SAMPLES_PER_LINE/8*5)
+#define PDAT_MAGIC	  "SEASATP5"
+#define PDAT_VERSION	  1
+#define PDAT_HEADER_SIZE  32
+
+typedef struct {
+	FILE	*fp;
+	int	 packed;
+	int	 writing;
+	long	 line_bytes;	/* bytes a line takes in the file	*/
+	long	 data_start;	/* byte offset of the first line	*/
+	long	 nlines;	/* lines in a file being read		*/
+	unsigned char *pbuf;	/* one packed line			*/
+	char	 name[256];
+} SEASAT_dat_file;
+
+/* Data file access - dat_io.c
+ ----------------------------*/
+SEASAT_dat_file *open_dat_file(const char *name, const char *mode);
+void close_dat_file(SEASAT_dat_file *f);
+int  read_dat_line(SEASAT_dat_file *f, unsigned char *line);
+void write_dat_line(SEASAT_dat_file *f, const unsigned char *line);
+int  seek_dat_line(SEASAT_dat_file *f, long line);
+long count_dat_lines(SEASAT_dat_file *f);
+int  copy_file_bytes(int fd_in, long in_off, int fd_out, long out_off, long n);
+void copy_dat_lines(SEASAT_dat_file *in, long from, SEASAT_dat_file *out, long to, long n);
+void blank_dat_lines(SEASAT_dat_file *f, long to, long n);
+char *find_dat_file(const char *base, char *name);
+int  is_pdat_name(const char *name);
+void make_pdat_header(unsigned char *h);
+void pack_samples(const unsigned char *src, unsigned char *dst, int n);
+
+/* 5-bit sample unpacking - unpack.c
+ ----------------------------------*/
+void unpack_samples(const unsigned char *src, int bit_offset, unsigned char *dst, int n);
+const char *unpack_kernel_name(void);
+
+#endif
@@ -0,0 +1,93 @@
+/***************************************************************************************
+  Decoded SEASAT header files
+
+	One record per decoded range line, 20 values in this order:
+
+	major_cnt, major_sync_loc, station_code, lsd_year, day_of_year, msec,
+	clock_drift, no_scan_indicator_bit, bits_per_sample, mfr_lock_bit,
+	prf_rate_code, delay, scu_bit, sdf_bit, adc_bit, time_gate_bit,
+	local_prf_bit, auto_prf_bit, prf_lock_bit, local_delay_bit
+
+	Header files come in two forms.  The original .hdr is ASCII text with
+	one line of 20 whitespace separated integers per record.  The .hdrb
+	form holds the same records in binary:
+
+	    file header, 32 bytes:
+		char  magic[8]		"SEASATHB"
+		int32 version		HDRB_VERSION
+		int32 header_size	32
+		int32 record_size	56
+		int32 spare
+		int64 nrecs		number of records (0 if not known)
+
+	    records, 56 bytes each:
+		int64 major_sync_loc,  int64 msec,  int32 major_cnt,
+		int16 station_code, lsd_year, day_of_year, clock_drift,
+		      no_scan_indicator_bit, bits_per_sample, mfr_lock_bit,
+		      prf_rate_code, delay, scu_bit, sdf_bit, adc_bit,
+		      time_gate_bit, local_prf_bit, auto_prf_bit, prf_lock_bit,
+		      local_delay_bit, spare
+
+	All binary values are little endian.  Readers tell the two forms apart
+	by the magic number; writers use the binary form when the file name
+	ends in .hdrb.
+***************************************************************************************/
+
+#ifndef SEASAT_HDR_H
+#define SEASAT_HDR_H
+
+#include <stdio.h>
+
+#define HDR_VALUES	  20		/* values in one header record			*/
+#define HDRB_MAGIC	  "SEASATHB"
+#define HDRB_VERSION	  1
+#define HDRB_HEADER_SIZE  32
+#define HDRB_RECORD_SIZE  56
+
+typedef struct {
+        int      major_cnt;
+	long int  major_sync_loc;
+	int     lsd_year;
+	int     station_code;
+	long int msec;
+	int      day_of_year;
+	int      clock_drift;
+	int     no_scan_indicator_bit;
+	int     bits_per_sample;
+	int     mfr_lock_bit;
+	int     prf_rate_code;
+	int     delay;
+	int     scu_bit;
+	int     sdf_bit;
+	int     adc_bit;
+	int     time_gate_bit;
+	int     local_prf_bit;
+	int     auto_prf_bit;
+	int     prf_lock_bit;
+	int     local_delay_bit;
+}  SEASAT_header_ext;
+
+typedef struct {
+	FILE	*fp;		/* ASCII file, or binary file being written	*/
+	const unsigned char *map;	/* binary file being read		*/
+	long	 map_len;
+	long	 nrecs;		/* records in the file; -1 if not known	*/
+	long	 next;		/* record read_header hands out next	*/
+	int	 binary;
+	int	 writing;
+	char	 name[256];
+} SEASAT_hdr_file;
+
+/* Header file access - hdr_io.c
+ ------------------------------*/
+SEASAT_hdr_file *open_hdr_file(const char *name, const char *mode);
+void close_hdr_file(SEASAT_hdr_file *h);
+long flush_hdr_file(SEASAT_hdr_file *h, int sync);
+int  read_header(SEASAT_hdr_file *h, SEASAT_header_ext *s);
+void write_header(SEASAT_hdr_file *h, SEASAT_header_ext *s);
+int  seek_header(SEASAT_hdr_file *h, long rec);
+long count_headers(SEASAT_hdr_file *h);
+char *find_hdr_file(const char *base, char *name);
+int  is_hdrb_name(const char *name);
+
+#endif
@@ -0,0 +1,91 @@
+/***************************************************************************************
+  Per line quality files
+
+	While it decodes, seasat_decoder -q writes a quality file next to each
+	header file, <outfile>_NNN.qual, with one record per range line in
+	the same order as the data and header files.  Each record says how
+	the line's minor frames came in, so later tools can pass over bad
+	stretches without reading the data:
+
+	    file header, 320 bytes:
+		char  magic[8]		"SEASATLQ"
+		int32 version		QUAL_VERSION
+		int32 header_size	320
+		int32 record_size	96
+		int32 bins		32 (histogram bins)
+		int64 lines		lines summed up below; 0 until the
+					decoder closes the file
+		int64 hist[32]		samples of each value, all lines
+		float64 mean		of the samples
+		float64 variance
+		float64 saturated	fraction of samples at 0 or 31
+		int64 spare
+
+	    records, 96 bytes each:
+		int64 major_sync_loc	byte of the line's first minor frame
+		int32 line		line number as in the header file
+		int16 frames		minor frames in the line
+		int16 fixed		frame numbers repaired
+		int16 unfixed		bad frame numbers left alone
+		int16 fill		frames with the fill flag set
+		int16 missed		frames without a sync code where one
+					was due (more than BIT_ERRORS errors)
+		int16 flags		QUAL_PARTIAL
+		int32 sync_errors	bit errors in the sync codes, all frames
+		int32 spare
+		int16 hist[32]		number of samples of each value 0..31
+
+	All values are little endian, the float64s IEEE doubles.  Every record
+	is the same size, so the record of line n is at byte QUAL_HEADER_SIZE
+	+ n*QUAL_RECORD_SIZE.  The summary in the file header lets a tool like
+	create_roi_in have the sample statistics of the whole file without
+	reading any data.
+***************************************************************************************/
+
+#ifndef SEASAT_QUAL_H
+#define SEASAT_QUAL_H
+
+#include <stdio.h>
+
+#define QUAL_MAGIC	  "SEASATLQ"
+#define QUAL_VERSION	  2
+#define QUAL_HEADER_SIZE  320
+#define QUAL_RECORD_SIZE  96
+#define QUAL_BINS	  32		/* one for each 5-bit sample value		*/
+
+#define QUAL_PARTIAL	  1		/* the line did not end on frame 59 or 60	*/
+
+typedef struct {
+	long	major_sync_loc;
+	int	line;
+	int	frames;
+	int	fixed;
+	int	unfixed;
+	int	fill;
+	int	missed;
+	int	flags;
+	int	sync_errors;
+	int	hist[QUAL_BINS];
+} SEASAT_line_quality;
+
+typedef struct {
+	long	lines;
+	long	hist[QUAL_BINS];
+} SEASAT_sample_stats;	/* the samples of many lines */
+
+/* Quality file access - qual_io.c
+ --------------------------------*/
+FILE *open_qual_file(const char *name);
+void line_histogram(const unsigned char *line, int n, int *hist);
+void encode_quality(const SEASAT_line_quality *q, unsigned char *p);
+void write_quality(FILE *fp, const SEASAT_line_quality *q);
+void pwrite_quality(int fd, long first_line, const SEASAT_line_quality *q, int n);
+void add_line_stats(SEASAT_sample_stats *s, const int *hist);
+void sample_moments(const SEASAT_sample_stats *s, double *mean, double *variance, double *saturated);
+void close_qual_file(FILE *fp, const SEASAT_sample_stats *s);
+SEASAT_line_quality *read_qual_file(const char *name, long *n);
+int  read_qual_stats(const char *name, SEASAT_sample_stats *s);
+FILE *open_qual_reader(const char *name);
+int  read_quality(FILE *fp, SEASAT_line_quality *q);
+
+#endif
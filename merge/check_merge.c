@@ -0,0 +1,114 @@
+/******************************************************************************
+NAME: check_merge - checks how merge_takes lines up overlapping datatakes
+
+SYNOPSIS: check_merge [merge_takes]
+
+DESCRIPTION:
+	Writes two small datatakes of one pass, check_a and check_b, with
+	the second starting 0, 2 and 500 lines after the first, and merges
+	them with [merge_takes] (default ./merge_takes).  Each time the
+	second has to be lined up with the first by its times - one that
+	starts at the same line as an earlier one included - and every line
+	of the merged product has to be the line of the pass it is in.
+	Every line carries its line number of the pass in its first samples,
+	so a line taken from the wrong place shows.  Exits with 1 if any
+	case fails.
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Datatake line up check
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "seasat_hdr.h"
+#include "seasat_dat.h"
+
+#define TAKE_LINES	3000		/* enough for merge_takes to compare ALIGN_LINES */
+
+static double pri = 1000.0 / 1647.0;
+
+/* writes lines first to first+n-1 of the pass as datatake base */
+static void write_take(const char *base, long first, long n, int station)
+{
+  SEASAT_dat_file *dat;
+  SEASAT_hdr_file *hdr;
+  SEASAT_header_ext h;
+  unsigned char line[SAMPLES_PER_LINE];
+  char name[300];
+  long i, k;
+
+  sprintf(name,"%s.dat",base);
+  if ((dat = open_dat_file(name,"w")) == NULL) {printf("ERROR: unable to open output file %s\n",name); exit(1);}
+  sprintf(name,"%s.hdr",base);
+  if ((hdr = open_hdr_file(name,"w")) == NULL) {printf("ERROR: unable to open output file %s\n",name); exit(1);}
+  sprintf(name,"%s.qual",base);
+  remove(name);
+
+  memset(&h,0,sizeof(h));
+  h.lsd_year = 8;
+  h.station_code = station;
+  h.day_of_year = 200;
+  h.bits_per_sample = 5;
+  memset(line,0,SAMPLES_PER_LINE);
+  for (i=0; i<n; i++) {
+    k = first+i;
+    h.major_cnt = i;
+    h.major_sync_loc = 1000 + i*8850;
+    h.msec = 36000000L + lround(k*pri);
+    write_header(hdr,&h);
+    line[0] = k & 31; line[1] = (k>>5) & 31; line[2] = (k>>10) & 31;
+    line[3] = station;
+    write_dat_line(dat,line);
+  }
+  close_dat_file(dat);
+  close_hdr_file(hdr);
+}
+
+/* merges check_a and check_b, the second starting start lines into the first; 0 if all is well */
+static int check_case(const char *merge, long start)
+{
+  SEASAT_dat_file *dat;
+  unsigned char line[SAMPLES_PER_LINE];
+  char cmd[400], out[400];
+  FILE *fp;
+  long k, n, bad = 0, want = start+TAKE_LINES > TAKE_LINES ? start+TAKE_LINES : TAKE_LINES;
+  int lined_up = 0;
+
+  write_take("check_a",0,TAKE_LINES,1);
+  write_take("check_b",start,TAKE_LINES,2);
+  sprintf(cmd,"%s check_out check_a check_b",merge);
+  if ((fp = popen(cmd,"r")) == NULL) {printf("ERROR: unable to run %s\n",cmd); exit(1);}
+  while (fgets(out,sizeof(out),fp) != NULL)
+    if (strstr(out,"check_b lined up with check_a") != NULL && strstr(out,"moved 0 lines") != NULL) lined_up = 1;
+  if (pclose(fp) != 0) {printf("start %4li: FAILED - %s did not finish\n",start,merge); return(1);}
+
+  if ((dat = open_dat_file("check_out.dat","r")) == NULL) {printf("start %4li: FAILED - no check_out.dat\n",start); return(1);}
+  n = count_dat_lines(dat);
+  for (k=0; k<n && read_dat_line(dat,line); k++)
+    if (line[0] != (k & 31) || line[1] != ((k>>5) & 31) || line[2] != ((k>>10) & 31)) bad++;
+  close_dat_file(dat);
+
+  printf("start %4li: %s by times, %li lines (%li expected), %li out of place: %s\n",start,
+         lined_up ? "lined up" : "NOT lined up",n,want,bad,lined_up && n == want && bad == 0 ? "ok" : "FAILED");
+  return(!(lined_up && n == want && bad == 0));
+}
+
+int main(int argc, char *argv[])
+{
+  const char *merge = argc > 1 ? argv[1] : "./merge_takes";
+  int failed = 0;
+
+  failed += check_case(merge,0);
+  failed += check_case(merge,2);
+  failed += check_case(merge,500);
+
+  remove("check_a.dat"); remove("check_a.hdr");
+  remove("check_b.dat"); remove("check_b.hdr");
+  remove("check_out.dat"); remove("check_out.hdr");
+  printf("%s\n",failed ? "FAILED" : "All cases passed");
+  exit(failed ? 1 : 0);
+}
@@ -0,0 +1,379 @@
+/******************************************************************************
+NAME: merge_takes - merges decoded datatakes of the same pass recorded by
+	more than one station into one product
+
+SYNOPSIS: merge_takes [-p] [-b] <outbase> <inbase> <inbase> [<inbase> ...]
+
+DESCRIPTION:
+	<inbase>	base name of a decoded datatake with cleaned headers
+			(fix_headers, fix_time, fix_stairs and dis_search, or
+			seasat_decoder -F): <inbase>.dat or .pdat, <inbase>.hdr
+			or .hdrb, and if there is one <inbase>.qual
+	<outbase>	base name of the merged product: <outbase>.dat and
+			<outbase>.hdr, and <outbase>.qual if every datatake
+			has a quality file
+
+	-p		write the merged lines packed (<outbase>.pdat)
+	-b		write the merged headers in binary (<outbase>.hdrb)
+
+	The same orbit was often recorded by more than one station, so the
+	archive holds overlapping datatakes with duplicate or complementary
+	lines.  The datatakes are lined up on one grid of range lines by
+	their times, and each output line is taken from the copy with the
+	best quality: the fewest sync code bit errors and repaired, missed
+	or bad frames (from the .qual files), never a blank line put in for
+	a discontinuity if another station has the line.  Copies of equal
+	quality go to the datatake the line before came from, and then to
+	the one named first.  Lines no datatake has are written blank.
+
+EXTERNAL ASSOCIATES:
+    NAME:               USAGE:
+    ---------------------------------------------------------------
+
+FILE REFERENCES:
+    NAME:               USAGE:
+    ---------------------------------------------------------------
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Multi station merge of overlapping datatakes
+
+HARDWARE/SOFTWARE LIMITATIONS:
+	The headers have to be cleaned, so that the times run smoothly and
+	every gap is filled in.  All datatakes must be of one year.
+	Lines are only picked by quality where there are .qual files, and
+	seasat_decoder -F does not write them (it does not take -q).  To
+	merge by quality, decode with -q and clean the headers with
+	fix_headers, fix_time, fix_stairs and dis_search instead.  The lines
+	of a datatake without a .qual file all count as perfect.
+
+ALGORITHM DESCRIPTION:
+	The times in the headers come down from the satellite, so two
+	stations' copies of a line carry the same time, and after cleaning
+	the same times line for line.  Each datatake's start is first
+	estimated from the median of time - line*PRI over its first lines.
+	Where it starts inside a datatake that starts earlier, it is then
+	slid up to ALIGN_SLIP lines either way to where the most times of
+	the two agree exactly.
+
+	The merge is a streaming k-way merge: every datatake is read once,
+	front to back, a header (and quality record) at a time, and only
+	the data line picked is read.  Nothing is held in memory but the
+	current line of each datatake.
+
+	Blank lines put in for a discontinuity repeat the header (and so the
+	major_sync_loc) of the line before; that is how they are told from
+	real lines.  The quality records go with the lines by major_sync_loc
+	too, since the .qual file has none for the blank lines.
+
+ALGORITHM REFERENCES:
+
+BUGS:
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "seasat_hdr.h"
+#include "seasat_dat.h"
+#include "seasat_qual.h"
+
+#define MAX_TAKES	16
+#define ALIGN_LINES	2000		/* headers used to line up two datatakes	*/
+#define ALIGN_SKIP	200		/* ... after the first of these, where cleaning may differ */
+#define ALIGN_SLIP	3		/* lines either way of the estimate tried	*/
+#define MAX_MERGE_GAP	16470		/* blank lines allowed between datatakes (10 sec) */
+#define FRAME_COST	8		/* a repaired, missed or bad frame costs as much as this many bit errors */
+#define PARTIAL_COST	1000		/* ... a line that did not end on frame 59 or 60 */
+#define MISSING		LONG_MAX	/* a blank line put in for a discontinuity	*/
+
+typedef struct {
+  char   base[256];
+  int    order;				/* named order-th on the command line	*/
+  SEASAT_dat_file *dat;
+  SEASAT_hdr_file *hdr;
+  FILE   *qual;				/* NULL without a .qual file		*/
+  long   nlines;
+  double t0;				/* estimated time of line 0 (msec)	*/
+  long   offset;			/* output line of its line 0		*/
+  long   next;				/* next line of the header file		*/
+  long   dat_next;			/* ... and of the data file		*/
+  SEASAT_header_ext h;			/* the line for the output line		*/
+  long   last_loc;			/* major_sync_loc of the line before	*/
+  SEASAT_line_quality q;		/* the next quality record		*/
+  int    q_more;			/* ... there is one			*/
+  int    have_q;			/* ... it is h's			*/
+  long   score;
+  long   used;				/* lines of it written			*/
+} take;
+
+static double pri = 1000.0 / 1647.0;
+
+static long line_time(const SEASAT_header_ext *h)
+{
+  return((long) h->day_of_year*86400000L + h->msec);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return((x > y) - (x < y));
+}
+
+/* reads the times of lines first to first+n-1 of t into times; returns how many there were */
+static int read_times(take *t, long first, int n, long *times)
+{
+  SEASAT_header_ext h;
+  int i;
+
+  if (seek_header(t->hdr,first) != 0) return(0);
+  for (i=0; i<n && first+i<t->nlines; i++) {
+    if (read_header(t->hdr,&h) != HDR_VALUES) break;
+    times[i] = line_time(&h);
+  }
+  return(i);
+}
+
+/* median of time - line*PRI over the first lines of t */
+static double start_time(take *t)
+{
+  static long times[ALIGN_LINES];
+  static double v[ALIGN_LINES];
+  int i, n;
+
+  n = read_times(t,0,ALIGN_LINES,times);
+  if (n == 0) {printf("ERROR: unable to read headers from %s\n",t->base); exit(1);}
+  for (i=0; i<n; i++) v[i] = times[i] - i*pri;
+  qsort(v,n,sizeof(double),cmp_double);
+  return(v[n/2]);
+}
+
+/*-------------------------------------------------------------------------
+  Slides t, estimated to start at line est of ref, up to ALIGN_SLIP lines
+  either way to where most of their times agree.  Returns the slide, and
+  in *agree how many agree of the *tried compared.
+ -------------------------------------------------------------------------*/
+static int slide_times(take *ref, long est, take *t, int *agree, int *tried)
+{
+  static long tt[ALIGN_LINES], rt[ALIGN_LINES+2*ALIGN_SLIP];
+  int n, nr, i, d, cnt, best = 0;
+
+  n = read_times(t,ALIGN_SKIP,ALIGN_LINES-ALIGN_SKIP,tt);
+  nr = read_times(ref,est+ALIGN_SKIP-ALIGN_SLIP,n+2*ALIGN_SLIP,rt);
+  *agree = -1;
+  *tried = n;
+  for (d=-ALIGN_SLIP; d<=ALIGN_SLIP; d++) {
+    cnt = 0;
+    for (i=0; i<n && i+d+ALIGN_SLIP<nr; i++) if (tt[i] == rt[i+d+ALIGN_SLIP]) cnt++;
+    if (cnt > *agree) { *agree = cnt; best = d; }
+  }
+  return(best);
+}
+
+/* places the datatakes on one grid of output lines */
+static void line_up(take **t, int n)
+{
+  take *tmp;
+  long est, end;
+  int i, j, d, agree, tried;
+
+  for (i=0; i<n; i++) t[i]->t0 = start_time(t[i]);
+  for (i=1; i<n; i++)		/* by start, keeping the order they were named in */
+    for (j=i; j>0 && t[j]->t0 < t[j-1]->t0; j--) { tmp = t[j]; t[j] = t[j-1]; t[j-1] = tmp; }
+
+  t[0]->offset = 0;
+  for (i=1; i<n; i++) {
+    est = lround((t[i]->t0 - t[0]->t0) / pri);
+    t[i]->offset = est;
+    for (j=0; j<i; j++) {
+      /* one that covers the lines compared, which slide_times reads from ALIGN_SKIP on */
+      if (est-t[j]->offset+ALIGN_SKIP-ALIGN_SLIP < 0 || est-t[j]->offset+ALIGN_LINES+ALIGN_SLIP > t[j]->nlines) continue;
+      d = slide_times(t[j],est-t[j]->offset,t[i],&agree,&tried);
+      if (2*agree < tried) {
+        printf("WARNING: times of %s do not agree with %s (%i of %i) - placed by its start time only\n",
+               t[i]->base,t[j]->base,agree,tried);
+      } else {
+        t[i]->offset = est + d;
+        printf("\t%s lined up with %s: %i of %i times agree, moved %i lines\n",t[i]->base,t[j]->base,agree,tried,d);
+      }
+      break;
+    }
+    if (j == i) printf("\t%s overlaps no datatake before it - placed by its start time\n",t[i]->base);
+  }
+
+  /* lines all after 0, and no long stretch without any */
+  for (i=1; i<n; i++)
+    for (j=i; j>0 && t[j]->offset < t[j-1]->offset; j--) { tmp = t[j]; t[j] = t[j-1]; t[j-1] = tmp; }
+  for (i=n-1; i>=0; i--) t[i]->offset -= t[0]->offset;
+  end = t[0]->nlines;
+  for (i=1; i<n; i++) {
+    if (t[i]->offset - end > MAX_MERGE_GAP) {
+      printf("ERROR: %s starts %li lines after the datatakes before it end - not of the same pass?\n",
+             t[i]->base,t[i]->offset-end);
+      exit(1);
+    }
+    if (t[i]->offset + t[i]->nlines > end) end = t[i]->offset + t[i]->nlines;
+  }
+  for (i=0; i<n; i++) {
+    seek_header(t[i]->hdr,0);
+    printf("\t%s: lines %li to %li of %li, station %i\n",t[i]->base,t[i]->offset,t[i]->offset+t[i]->nlines-1,
+           end,t[i]->h.station_code);
+  }
+}
+
+/* reads the next line of t, its quality record and what it would cost to use it */
+static void next_take_line(take *t)
+{
+  int missing;
+
+  if (read_header(t->hdr,&t->h) != HDR_VALUES) {printf("ERROR: %s is short\n",t->base); exit(1);}
+  missing = (t->next > 0 && t->h.major_sync_loc == t->last_loc);
+  t->last_loc = t->h.major_sync_loc;
+  t->next++;
+
+  t->have_q = 0;
+  if (t->qual != NULL && !missing) {
+    while (t->q_more && t->q.major_sync_loc < t->h.major_sync_loc) t->q_more = read_quality(t->qual,&t->q);
+    t->have_q = (t->q_more && t->q.major_sync_loc == t->h.major_sync_loc);
+  }
+
+  if (missing) t->score = MISSING;
+  else if (t->have_q) t->score = t->q.sync_errors + FRAME_COST*(t->q.fixed+t->q.unfixed+t->q.missed) +
+  			       ((t->q.flags & QUAL_PARTIAL) ? PARTIAL_COST : 0);
+  else t->score = 0;
+}
+
+int main(int argc, char *argv[])
+{
+  take *t[MAX_TAKES], *best, *prev=NULL;
+  int  ntakes, i;
+  int  packed=0, binary=0, all_qual=1;
+  char name[300];
+  SEASAT_dat_file *fpout;
+  SEASAT_hdr_file *fphdr;
+  FILE *fpqual=NULL;
+  SEASAT_sample_stats stats;
+  SEASAT_line_quality q;
+  SEASAT_header_ext hdr;
+  unsigned char line[SAMPLES_PER_LINE], blank[SAMPLES_PER_LINE];
+  long k, end, last_k=-1, blank_cnt=0, switches=0;
+
+  while (argc > 1 && argv[1][0]=='-') {
+    if (strcmp(argv[1],"-p")==0) packed = 1;
+    else if (strcmp(argv[1],"-b")==0) binary = 1;
+    else break;
+    argv++; argc--;
+  }
+  if (argc < 4 || argc-2 > MAX_TAKES) {
+    printf("Usage: %s [-p] [-b] <outbase> <inbase> <inbase> [<inbase> ...]\n\n",argv[0]);
+    printf("-p\twrite the merged lines packed (.pdat)\n");
+    printf("-b\twrite the merged headers in binary (.hdrb)\n");
+    printf("<outbase>\tBase name of the merged product\n");
+    printf("<inbase>\tBase name of a decoded datatake with cleaned headers (up to %i)",MAX_TAKES);
+    printf("\n\n");
+    exit(1);
+  }
+
+  printf("\n\nSEASAT MULTI STATION DATATAKE MERGE\n\n");
+  printf("\topening files...\n");
+  ntakes = argc-2;
+  for (i=0; i<ntakes; i++) {
+    t[i] = (take *) calloc(1,sizeof(take));
+    if (t[i] == NULL) {printf("ERROR: unable to allocate datatake\n"); exit(1);}
+    strcpy(t[i]->base,argv[i+2]);
+    t[i]->order = i;
+    t[i]->dat = open_dat_file(find_dat_file(t[i]->base,name),"r");
+    if (t[i]->dat == NULL) {printf("ERROR: Unable to open input file %s\n",name); exit(1);}
+    t[i]->hdr = open_hdr_file(find_hdr_file(t[i]->base,name),"r");
+    if (t[i]->hdr == NULL) {printf("ERROR: Unable to open input file %s\n",name); exit(1);}
+    sprintf(name,"%s.qual",t[i]->base);
+    t[i]->qual = open_qual_reader(name);
+    if (t[i]->qual == NULL) all_qual = 0;
+    else t[i]->q_more = read_quality(t[i]->qual,&t[i]->q);
+    t[i]->nlines = count_dat_lines(t[i]->dat);
+    if (t[i]->nlines == 0) {printf("ERROR: %s has no lines\n",t[i]->base); exit(1);}
+    if (read_header(t[i]->hdr,&t[i]->h) != HDR_VALUES) {printf("ERROR: unable to read headers from %s\n",t[i]->base); exit(1);}
+  }
+
+  printf("\tlining up the datatakes...\n");
+  line_up(t,ntakes);
+  for (end=0, i=0; i<ntakes; i++) if (t[i]->offset+t[i]->nlines > end) end = t[i]->offset+t[i]->nlines;
+
+  sprintf(name,"%s.%s",argv[1],packed ? "pdat" : "dat");
+  fpout = open_dat_file(name,"w");
+  if (fpout==NULL) {printf("ERROR: Unable to open output file %s\n",name); exit(1);}
+  sprintf(name,"%s.%s",argv[1],binary ? "hdrb" : "hdr");
+  fphdr = open_hdr_file(name,"w");
+  if (fphdr==NULL) {printf("ERROR: Unable to open output file %s\n",name); exit(1);}
+  if (all_qual) {
+    sprintf(name,"%s.qual",argv[1]);
+    fpqual = open_qual_file(name);
+    if (fpqual==NULL) {printf("ERROR: Unable to open output file %s\n",name); exit(1);}
+    memset(&stats,0,sizeof(stats));
+  }
+  memset(blank,0,SAMPLES_PER_LINE);
+
+  /* Merge the datatakes line by line
+   =================================*/
+  printf("\tmerging %li lines...\n",end);
+  for (k=0; k<end; k++) {
+    if ((k%100000)==0) printf("\tmerging line %li\n",k);
+    best = NULL;
+    for (i=0; i<ntakes; i++) {
+      if (k < t[i]->offset || k >= t[i]->offset+t[i]->nlines) continue;
+      next_take_line(t[i]);
+      if (best == NULL || t[i]->score < best->score || (t[i]->score == best->score && t[i]->order < best->order))
+        best = t[i];
+    }
+    if (best != NULL && prev != NULL && prev != best && k >= prev->offset && k < prev->offset+prev->nlines &&
+        prev->score == best->score) best = prev;
+
+    if (best != NULL && best->score != MISSING) {
+      if (best->dat_next != k-best->offset) seek_dat_line(best->dat,k-best->offset);
+      if (!read_dat_line(best->dat,line)) {printf("ERROR: %s is short\n",best->base); exit(1);}
+      best->dat_next = k-best->offset+1;
+      write_dat_line(fpout,line);
+      hdr = best->h;
+      best->used++;
+      if (prev != NULL && prev != best) switches++;
+      prev = best;
+    } else {
+      /* no station has this line */
+      if (best != NULL) hdr = best->h;
+      else hdr.msec += (long) ((k-last_k)*pri) - (long) ((k-1-last_k)*pri);
+      write_dat_line(fpout,blank);
+      blank_cnt++;
+    }
+    if (best != NULL) last_k = k;
+    hdr.major_cnt = k;
+    write_header(fphdr,&hdr);
+
+    if (fpqual != NULL) {
+      if (best != NULL && best->score != MISSING && best->have_q) q = best->q;
+      else {
+        memset(&q,0,sizeof(q));
+        line_histogram(blank,SAMPLES_PER_LINE,q.hist);
+      }
+      q.line = k;
+      q.major_sync_loc = hdr.major_sync_loc;
+      write_quality(fpqual,&q);
+      add_line_stats(&stats,q.hist);
+    }
+  }
+
+  for (i=0; i<ntakes; i++) {
+    printf("\t%s: %li lines used\n",t[i]->base,t[i]->used);
+    close_dat_file(t[i]->dat);
+    close_hdr_file(t[i]->hdr);
+    if (t[i]->qual != NULL) fclose(t[i]->qual);
+    free(t[i]);
+  }
+  printf("\n\nDone merging - wrote %li lines, %li of them blank, switching datatakes %li times\n\n",end,blank_cnt,switches);
+  close_dat_file(fpout);
+  close_hdr_file(fphdr);
+  if (fpqual != NULL) close_qual_file(fpqual,&stats);
+  exit(0);
+}
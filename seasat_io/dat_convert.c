@@ -0,0 +1,69 @@
+/******************************************************************************
+NAME: dat_convert - converts decoded SEASAT data files between the byte per
+	sample .dat and the packed .pdat forms
+
+SYNOPSIS: dat_convert <infile> <outfile>
+
+DESCRIPTION:
+	<infile> 	input data file, either form
+	<outfile>	output data file; packed if the name ends in .pdat,
+			one sample per byte otherwise
+
+	Converting a file to the other form and back gives the file that
+	was started with.
+
+EXTERNAL ASSOCIATES:
+    NAME:               USAGE:
+    ---------------------------------------------------------------
+
+FILE REFERENCES:
+    NAME:               USAGE:
+    ---------------------------------------------------------------
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Packed data file format
+
+HARDWARE/SOFTWARE LIMITATIONS:
+
+ALGORITHM DESCRIPTION:
+
+ALGORITHM REFERENCES:
+
+BUGS:
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "seasat_dat.h"
+
+int main(int argc, char *argv[])
+{
+  SEASAT_dat_file *fpin, *fpout;
+  unsigned char line[SAMPLES_PER_LINE];
+  long cnt = 0;
+
+  if (argc!=3) {
+    printf("Usage: %s <in_data_file> <out_data_file>\n\n",argv[0]);
+    printf("<in>\tName of input data file (.dat or .pdat)\n");
+    printf("<out>\tName of output data file; packed if it ends in .pdat\n");
+    printf("\n\n");
+    exit(1);
+  }
+
+  fpin=open_dat_file(argv[1],"r");
+  if (fpin==NULL) {printf("ERROR: Unable to open input file %s\n",argv[1]); exit(1);}
+  fpout=open_dat_file(argv[2],"w");
+  if (fpout==NULL) {printf("ERROR: Unable to open output file %s\n",argv[2]); exit(1);}
+
+  while (read_dat_line(fpin,line)) {
+    write_dat_line(fpout,line);
+    cnt++;
+  }
+
+  printf("Converted %li lines from %s to %s\n",cnt,argv[1],argv[2]);
+  close_dat_file(fpin);
+  close_dat_file(fpout);
+  exit(0);
+}
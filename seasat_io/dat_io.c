@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "seasat.h"
+
+#define COPY_CHUNK	(4<<20)		/* bytes copied at a time without copy_file_range */
+
+/*************************************************************************************
+  Reader and writer for decoded SEASAT data files
+
+  Tools that read or write decoded range lines (seasat_decoder,
+  dis_search, create_roi_in's Doppler and spectra estimates) go through
+  these routines so they take either the byte per sample .dat or the
+  packed .pdat form (see seasat_dat.h).  Lines always come back with one
+  sample per byte; packed lines are unpacked with the same SIMD kernels
+  the decoder uses on the raw frames.
+
+  Lines that only have to be moved from one file to another of the same
+  form need not come through memory at all: copy_dat_lines has the
+  kernel copy them (sharing the blocks where the file system can), and
+  blank_dat_lines leaves a hole that reads back as zeros.
+*************************************************************************************/
+
+static void put_le(unsigned char *p, long v, int n)
+{
+	int i;
+	for (i=0; i<n; i++) { p[i] = v & 0377; v >>= 8; }
+}
+
+static long get_le(const unsigned char *p, int n)
+{
+	long v = 0;
+	int i;
+	for (i=n-1; i>=0; i--) v = (v << 8) | p[i];
+	return(v);
+}
+
+/* 1 if name ends in .pdat */
+int is_pdat_name(const char *name)
+{
+	int n = strlen(name);
+	return(n >= 5 && strcmp(name+n-5,".pdat") == 0);
+}
+
+/*-------------------------------------------------------------------------
+  Fills in name with the data file that goes with base name base:
+  base.pdat if there is one, base.dat otherwise.
+ -------------------------------------------------------------------------*/
+char *find_dat_file(const char *base, char *name)
+{
+	sprintf(name,"%s.pdat",base);
+	if (access(name,R_OK) == 0) return(name);
+	sprintf(name,"%s.dat",base);
+	return(name);
+}
+
+/* fills in the PDAT_HEADER_SIZE byte header of a packed file */
+void make_pdat_header(unsigned char *h)
+{
+	memset(h,0,PDAT_HEADER_SIZE);
+	memcpy(h,PDAT_MAGIC,8);
+	put_le(h+8,PDAT_VERSION,4);
+	put_le(h+12,PDAT_HEADER_SIZE,4);
+	put_le(h+16,SAMPLES_PER_LINE,4);
+	put_le(h+20,PACKED_LINE_BYTES,4);
+}
+
+/*-------------------------------------------------------------------------
+  Packs n samples (n a multiple of 8) of 5 bits, MSB first, 8 samples to
+  every 5 bytes.
+ -------------------------------------------------------------------------*/
+void pack_samples(const unsigned char *src, unsigned char *dst, int n)
+{
+	unsigned long long v;
+	int i, j;
+
+	for (i=0; i<n; i+=8, src+=8, dst+=5) {
+	  v = 0;
+	  for (j=0; j<8; j++) v = (v << 5) | (src[j] & 037);
+	  dst[0] = v >> 32;
+	  dst[1] = v >> 24;
+	  dst[2] = v >> 16;
+	  dst[3] = v >> 8;
+	  dst[4] = v;
+	}
+}
+
+/*-------------------------------------------------------------------------
+  Opens a data file for reading (mode "r") or writing (mode "w").  A file
+  being read may be in either form.  A file being written is packed if
+  its name ends in .pdat.  Returns NULL if the file can not be opened.
+ -------------------------------------------------------------------------*/
+SEASAT_dat_file *open_dat_file(const char *name, const char *mode)
+{
+	SEASAT_dat_file *f;
+	unsigned char h[PDAT_HEADER_SIZE];
+	long size;
+
+	f = (SEASAT_dat_file *) calloc(1,sizeof(SEASAT_dat_file));
+	if (f == NULL) { printf("ERROR: unable to allocate data file %s\n",name); exit(1); }
+	strncpy(f->name,name,sizeof(f->name)-1);
+	f->pbuf = (unsigned char *) malloc(PACKED_LINE_BYTES);
+	if (f->pbuf == NULL) { printf("ERROR: unable to allocate data file %s\n",name); exit(1); }
+
+	if (mode[0] == 'w') {
+	  f->writing = 1;
+	  f->packed = is_pdat_name(name);
+	  f->fp = fopen(name,"wb");
+	  if (f->fp == NULL) { free(f->pbuf); free(f); return(NULL); }
+	} else {
+	  f->fp = fopen(name,"rb");
+	  if (f->fp == NULL) { free(f->pbuf); free(f); return(NULL); }
+	  if (fread(h,1,PDAT_HEADER_SIZE,f->fp) == PDAT_HEADER_SIZE && memcmp(h,PDAT_MAGIC,8) == 0) {
+	    if (get_le(h+8,4) != PDAT_VERSION || get_le(h+16,4) != SAMPLES_PER_LINE ||
+	        get_le(h+20,4) != PACKED_LINE_BYTES) {
+	      printf("ERROR: %s is a version %li packed data file with %li samples a line; expected version %i with %i\n",
+	      	name,get_le(h+8,4),get_le(h+16,4),PDAT_VERSION,SAMPLES_PER_LINE);
+	      exit(1);
+	    }
+	    f->packed = 1;
+	  }
+	}
+
+	f->line_bytes = f->packed ? PACKED_LINE_BYTES : SAMPLES_PER_LINE;
+	f->data_start = f->packed ? PDAT_HEADER_SIZE : 0;
+	if (f->writing) {
+	  if (f->packed) { make_pdat_header(h); fwrite(h,PDAT_HEADER_SIZE,1,f->fp); }
+	} else {
+	  fseek(f->fp,0,SEEK_END);
+	  size = ftell(f->fp);
+	  f->nlines = (size - f->data_start) / f->line_bytes;
+	  fseek(f->fp,f->data_start,SEEK_SET);
+	}
+	return(f);
+}
+
+void close_dat_file(SEASAT_dat_file *f)
+{
+	if (f == NULL) return;
+	fclose(f->fp);
+	free(f->pbuf);
+	free(f);
+}
+
+/*-------------------------------------------------------------------------
+  Reads the next line into line, one sample per byte.  Returns 1, or 0
+  at the end of the file.
+ -------------------------------------------------------------------------*/
+int read_dat_line(SEASAT_dat_file *f, unsigned char *line)
+{
+	if (!f->packed) return(fread(line,SAMPLES_PER_LINE,1,f->fp) == 1);
+	if (fread(f->pbuf,PACKED_LINE_BYTES,1,f->fp) != 1) return(0);
+	unpack_samples(f->pbuf,0,line,SAMPLES_PER_LINE);
+	return(1);
+}
+
+/* writes one line given with one sample per byte */
+void write_dat_line(SEASAT_dat_file *f, const unsigned char *line)
+{
+	int ok;
+
+	if (f->packed) {
+	  pack_samples(line,f->pbuf,SAMPLES_PER_LINE);
+	  ok = fwrite(f->pbuf,PACKED_LINE_BYTES,1,f->fp);
+	} else ok = fwrite(line,SAMPLES_PER_LINE,1,f->fp);
+	if (ok != 1) { printf("ERROR: unable to write to data file %s\n",f->name); exit(1); }
+}
+
+/*-------------------------------------------------------------------------
+  Makes line (counting from 0) the next one read_dat_line returns.  Every
+  line is the same size, so this is a single seek.  Returns 0, or -1 if
+  the seek fails.
+ -------------------------------------------------------------------------*/
+int seek_dat_line(SEASAT_dat_file *f, long line)
+{
+	if (line < 0) return(-1);
+	return(fseek(f->fp,f->data_start + line*f->line_bytes,SEEK_SET) == 0 ? 0 : -1);
+}
+
+/* number of whole lines in a file being read */
+long count_dat_lines(SEASAT_dat_file *f)
+{
+	return(f->nlines);
+}
+
+/*-------------------------------------------------------------------------
+  Copies n bytes at in_off of fd_in to out_off of fd_out, with
+  copy_file_range where the kernel and file systems have it (sharing the
+  blocks where they can) and pread/pwrite where they do not.  Neither
+  file offset moves.  Returns 0, or -1 if the bytes can not be copied.
+ -------------------------------------------------------------------------*/
+int copy_file_bytes(int fd_in, long in_off, int fd_out, long out_off, long n)
+{
+	loff_t ri = in_off, ro = out_off;
+	unsigned char *buf;
+	long w, r;
+
+	while (n > 0) {
+	  w = copy_file_range(fd_in,&ri,fd_out,&ro,n,0);
+	  if (w < 0 && errno == EINTR) continue;
+	  if (w <= 0) break;
+	  n -= w;
+	}
+	if (n == 0) return(0);
+
+	/* file systems (and kernels) without it */
+	if ((buf = (unsigned char *) malloc(COPY_CHUNK)) == NULL) return(-1);
+	while (n > 0) {
+	  r = pread(fd_in,buf,n < COPY_CHUNK ? n : COPY_CHUNK,ri);
+	  if (r < 0 && errno == EINTR) continue;
+	  if (r <= 0 || pwrite(fd_out,buf,r,ro) != r) break;
+	  ri += r;
+	  ro += r;
+	  n -= r;
+	}
+	free(buf);
+	return(n == 0 ? 0 : -1);
+}
+
+/*-------------------------------------------------------------------------
+  Copies n lines from line from of in to line to of out, a file being
+  written in the same form (copy_file_bytes).  Neither file's
+  read_dat_line or write_dat_line position moves.  Exits if the lines
+  can not be copied.
+ -------------------------------------------------------------------------*/
+void copy_dat_lines(SEASAT_dat_file *in, long from, SEASAT_dat_file *out, long to, long n)
+{
+	if (in->packed != out->packed) { printf("ERROR: can not copy lines of %s to %s, a different form\n",in->name,out->name); exit(1); }
+	fflush(out->fp);
+	if (copy_file_bytes(fileno(in->fp),in->data_start + from*in->line_bytes,
+			    fileno(out->fp),out->data_start + to*out->line_bytes,n*in->line_bytes) != 0) {
+	  printf("ERROR: unable to copy lines %li to %li of data file %s to %s\n",from,from+n-1,in->name,out->name);
+	  exit(1);
+	}
+}
+
+/*-------------------------------------------------------------------------
+  Makes n lines from line to of a file being written blank.  Past the
+  end of what has been written they are left as a hole in the file,
+  which takes no space where the file system has holes; any written
+  already are zeroed.  Exits if they can not be.
+ -------------------------------------------------------------------------*/
+void blank_dat_lines(SEASAT_dat_file *f, long to, long n)
+{
+	static const unsigned char zero[PACKED_LINE_BYTES > SAMPLES_PER_LINE ? PACKED_LINE_BYTES : SAMPLES_PER_LINE] = { 0 };
+	long start = f->data_start + to*f->line_bytes, end = start + n*f->line_bytes, off;
+	int fd = fileno(f->fp);
+	struct stat st;
+
+	fflush(f->fp);
+	if (fstat(fd,&st) != 0) { printf("ERROR: unable to write to data file %s\n",f->name); exit(1); }
+	for (off = start; off < end && off < st.st_size; off += f->line_bytes)
+	  if (pwrite(fd,zero,f->line_bytes,off) != f->line_bytes) { printf("ERROR: unable to write to data file %s\n",f->name); exit(1); }
+	if (end > st.st_size && ftruncate(fd,end) != 0) { printf("ERROR: unable to write to data file %s\n",f->name); exit(1); }
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+NAME: hdr_convert - converts decoded SEASAT header files between the ASCII
+	.hdr and the binary .hdrb forms
+
+SYNOPSIS: hdr_convert <infile> <outfile>
+
+DESCRIPTION:
+	<infile> 	input header file, either form
+	<outfile>	output header file; binary if the name ends in .hdrb,
+			ASCII otherwise
+
+	Converting a file to the other form and back gives the file that
+	was started with.
+
+EXTERNAL ASSOCIATES:
+    NAME:               USAGE:
+    ---------------------------------------------------------------
+
+FILE REFERENCES:
+    NAME:               USAGE:
+    ---------------------------------------------------------------
+
+PROGRAM HISTORY:
+    VERS:   DATE:  AUTHOR:      PURPOSE:
+    ---------------------------------------------------------------
+    1.0	    10/26  	        Binary header file format
+
+HARDWARE/SOFTWARE LIMITATIONS:
+
+ALGORITHM DESCRIPTION:
+
+ALGORITHM REFERENCES:
+
+BUGS:
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "seasat_hdr.h"
+
+int main(int argc, char *argv[])
+{
+  SEASAT_hdr_file *fpin, *fpout;
+  SEASAT_header_ext hdr;
+  long cnt = 0;
+  int val;
+
+  if (argc!=3) {
+    printf("Usage: %s <in_header_file> <out_header_file>\n\n",argv[0]);
+    printf("<in>\tName of input header file (.hdr or .hdrb)\n");
+    printf("<out>\tName of output header file; written in binary if it ends in .hdrb\n");
+    printf("\n\n");
+    exit(1);
+  }
+
+  fpin=open_hdr_file(argv[1],"r");
+  if (fpin==NULL) {printf("ERROR: Unable to open input file %s\n",argv[1]); exit(1);}
+  fpout=open_hdr_file(argv[2],"w");
+  if (fpout==NULL) {printf("ERROR: Unable to open output file %s\n",argv[2]); exit(1);}
+
+  while ((val = read_header(fpin,&hdr)) == HDR_VALUES) {
+    write_header(fpout,&hdr);
+    cnt++;
+  }
+  if (val != EOF) {printf("ERROR: bad header record at line %li of %s\n",cnt+1,argv[1]); exit(1);}
+
+  printf("Converted %li header records from %s to %s\n",cnt,argv[1],argv[2]);
+  close_hdr_file(fpin);
+  close_hdr_file(fpout);
+  exit(0);
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "seasat_hdr.h"
+
+#define HDR_WRITE_BUFFER (256*1024)	/* stdio buffer for header files being written */
+
+/*************************************************************************************
+  Reader and writer for decoded SEASAT header files
+
+  Every tool that reads or writes the per line headers (seasat_decoder,
+  fix_headers, fix_time, fix_stairs, dis_search, create_roi_in) goes
+  through these routines, so they all take either the ASCII .hdr or the
+  binary .hdrb form (see seasat_hdr.h).  A binary file being read is
+  mapped into memory and a record is decoded straight from the map, so
+  reading a header file no longer costs a fscanf of 20 values per line,
+  and any record can be reached directly with seek_header.
+*************************************************************************************/
+
+/* little endian fields, whatever the byte order of this machine */
+static void put_le(unsigned char *p, long v, int n)
+{
+	int i;
+	unsigned long u = (unsigned long) v;
+
+	for (i=0; i<n; i++) { p[i] = u & 0377; u >>= 8; }
+}
+
+static long get_le(const unsigned char *p, int n)
+{
+	unsigned long u = 0;
+	int i;
+
+	for (i=n-1; i>=0; i--) u = (u << 8) | p[i];
+	if (n < 8 && (u >> (8*n-1)) & 1) u |= ~0UL << (8*n);	/* sign extend */
+	return((long) u);
+}
+
+static void put_short(unsigned char *p, int v, const char *what, SEASAT_hdr_file *h)
+{
+	if (v < -32768 || v > 32767) {
+	  printf("ERROR: %s value %i of line %li does not fit in %s\n",what,v,h->nrecs,h->name);
+	  exit(1);
+	}
+	put_le(p,v,2);
+}
+
+static void encode_record(SEASAT_hdr_file *h, SEASAT_header_ext *s, unsigned char *p)
+{
+	put_le(p,s->major_sync_loc,8);
+	put_le(p+8,s->msec,8);
+	put_le(p+16,s->major_cnt,4);
+	put_short(p+20,s->station_code,"station_code",h);
+	put_short(p+22,s->lsd_year,"lsd_year",h);
+	put_short(p+24,s->day_of_year,"day_of_year",h);
+	put_short(p+26,s->clock_drift,"clock_drift",h);
+	put_short(p+28,s->no_scan_indicator_bit,"no_scan_indicator_bit",h);
+	put_short(p+30,s->bits_per_sample,"bits_per_sample",h);
+	put_short(p+32,s->mfr_lock_bit,"mfr_lock_bit",h);
+	put_short(p+34,s->prf_rate_code,"prf_rate_code",h);
+	put_short(p+36,s->delay,"delay",h);
+	put_short(p+38,s->scu_bit,"scu_bit",h);
+	put_short(p+40,s->sdf_bit,"sdf_bit",h);
+	put_short(p+42,s->adc_bit,"adc_bit",h);
+	put_short(p+44,s->time_gate_bit,"time_gate_bit",h);
+	put_short(p+46,s->local_prf_bit,"local_prf_bit",h);
+	put_short(p+48,s->auto_prf_bit,"auto_prf_bit",h);
+	put_short(p+50,s->prf_lock_bit,"prf_lock_bit",h);
+	put_short(p+52,s->local_delay_bit,"local_delay_bit",h);
+	put_le(p+54,0,2);
+}
+
+static void decode_record(const unsigned char *p, SEASAT_header_ext *s)
+{
+	s->major_sync_loc	 = get_le(p,8);
+	s->msec			 = get_le(p+8,8);
+	s->major_cnt		 = get_le(p+16,4);
+	s->station_code		 = get_le(p+20,2);
+	s->lsd_year		 = get_le(p+22,2);
+	s->day_of_year		 = get_le(p+24,2);
+	s->clock_drift		 = get_le(p+26,2);
+	s->no_scan_indicator_bit = get_le(p+28,2);
+	s->bits_per_sample	 = get_le(p+30,2);
+	s->mfr_lock_bit		 = get_le(p+32,2);
+	s->prf_rate_code	 = get_le(p+34,2);
+	s->delay		 = get_le(p+36,2);
+	s->scu_bit		 = get_le(p+38,2);
+	s->sdf_bit		 = get_le(p+40,2);
+	s->adc_bit		 = get_le(p+42,2);
+	s->time_gate_bit	 = get_le(p+44,2);
+	s->local_prf_bit	 = get_le(p+46,2);
+	s->auto_prf_bit		 = get_le(p+48,2);
+	s->prf_lock_bit		 = get_le(p+50,2);
+	s->local_delay_bit	 = get_le(p+52,2);
+}
+
+/* 1 if name ends in .hdrb */
+int is_hdrb_name(const char *name)
+{
+	int n = strlen(name);
+	return(n >= 5 && strcmp(name+n-5,".hdrb") == 0);
+}
+
+/*-------------------------------------------------------------------------
+  Fills in name with the header file that goes with base name base:
+  base.hdrb if there is one, base.hdr otherwise.
+ -------------------------------------------------------------------------*/
+char *find_hdr_file(const char *base, char *name)
+{
+	sprintf(name,"%s.hdrb",base);
+	if (access(name,R_OK) == 0) return(name);
+	sprintf(name,"%s.hdr",base);
+	return(name);
+}
+
+/* maps a binary header file; 0 if it is not one */
+static int map_hdrb(SEASAT_hdr_file *h, const char *name)
+{
+	struct stat sb;
+	const unsigned char *p;
+	long stored;
+	int fd;
+
+	if ((fd = open(name,O_RDONLY)) < 0) return(0);
+	if (fstat(fd,&sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size < HDRB_HEADER_SIZE) { close(fd); return(0); }
+	p = (const unsigned char *) mmap(NULL,sb.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if (p == MAP_FAILED) return(0);
+	if (memcmp(p,HDRB_MAGIC,8) != 0) { munmap((void *) p,sb.st_size); return(0); }
+
+	if (get_le(p+8,4) != HDRB_VERSION || get_le(p+12,4) != HDRB_HEADER_SIZE ||
+	    get_le(p+16,4) != HDRB_RECORD_SIZE) {
+	  printf("ERROR: %s is a version %li binary header file with %li byte records; expected version %i with %i\n",
+	  	name,get_le(p+8,4),get_le(p+16,4),HDRB_VERSION,HDRB_RECORD_SIZE);
+	  exit(1);
+	}
+	h->map = p;
+	h->map_len = sb.st_size;
+	h->nrecs = (sb.st_size - HDRB_HEADER_SIZE) / HDRB_RECORD_SIZE;
+	stored = get_le(p+24,8);
+	if (stored != 0 && stored != h->nrecs)
+	  printf("WARNING: %s should hold %li header records but only %li are there\n",name,stored,h->nrecs);
+	madvise((void *) p,sb.st_size,MADV_WILLNEED);
+	return(1);
+}
+
+/*-------------------------------------------------------------------------
+  Opens a header file for reading (mode "r") or writing (mode "w"), or
+  to write more records after those already in it (mode "a").  A file
+  being read may be in either form.  A file being written is binary if
+  its name ends in .hdrb and ASCII otherwise.  Returns NULL if the file
+  can not be opened.
+ -------------------------------------------------------------------------*/
+SEASAT_hdr_file *open_hdr_file(const char *name, const char *mode)
+{
+	SEASAT_hdr_file *h;
+	unsigned char fh[HDRB_HEADER_SIZE];
+
+	h = (SEASAT_hdr_file *) calloc(1,sizeof(SEASAT_hdr_file));
+	if (h == NULL) { printf("ERROR: unable to allocate header file %s\n",name); exit(1); }
+	strncpy(h->name,name,sizeof(h->name)-1);
+	h->nrecs = -1;
+
+	if (mode[0] == 'w') {
+	  h->writing = 1;
+	  h->binary = is_hdrb_name(name);
+	  h->fp = fopen(name,h->binary ? "wb" : "w");
+	  if (h->fp == NULL) { free(h); return(NULL); }
+	  setvbuf(h->fp,NULL,_IOFBF,HDR_WRITE_BUFFER);	/* one write a few thousand lines */
+	  if (h->binary) {
+	    memset(fh,0,HDRB_HEADER_SIZE);
+	    memcpy(fh,HDRB_MAGIC,8);
+	    put_le(fh+8,HDRB_VERSION,4);
+	    put_le(fh+12,HDRB_HEADER_SIZE,4);
+	    put_le(fh+16,HDRB_RECORD_SIZE,4);
+	    fwrite(fh,HDRB_HEADER_SIZE,1,h->fp);
+	    h->nrecs = 0;
+	  }
+	  return(h);
+	}
+	if (mode[0] == 'a') {
+	  h->writing = 1;
+	  h->binary = is_hdrb_name(name);
+	  h->fp = fopen(name,h->binary ? "r+b" : "a");
+	  if (h->fp == NULL) { free(h); return(NULL); }
+	  setvbuf(h->fp,NULL,_IOFBF,HDR_WRITE_BUFFER);
+	  fseek(h->fp,0,SEEK_END);
+	  if (h->binary) h->nrecs = (ftell(h->fp) - HDRB_HEADER_SIZE) / HDRB_RECORD_SIZE;
+	  return(h);
+	}
+
+	if (map_hdrb(h,name)) { h->binary = 1; return(h); }
+	h->fp = fopen(name,"r");
+	if (h->fp == NULL) { free(h); return(NULL); }
+	return(h);
+}
+
+void close_hdr_file(SEASAT_hdr_file *h)
+{
+	unsigned char n[8];
+
+	if (h == NULL) return;
+	if (h->writing && h->binary) {
+	  /* fill in the record count, if the file can be rewritten */
+	  put_le(n,h->nrecs,8);
+	  if (fseek(h->fp,24,SEEK_SET) == 0) fwrite(n,8,1,h->fp);
+	}
+	if (h->map != NULL) munmap((void *) h->map,h->map_len);
+	if (h->fp != NULL) fclose(h->fp);
+	free(h);
+}
+
+/*-------------------------------------------------------------------------
+  Writes out the records buffered for a file being written and returns
+  the length of the file in bytes, or -1 if it can not be written.  With
+  sync set the records are on the disk before this returns.
+ -------------------------------------------------------------------------*/
+long flush_hdr_file(SEASAT_hdr_file *h, int sync)
+{
+	if (h == NULL || !h->writing) return(-1);
+	if (fflush(h->fp) != 0) return(-1);
+	if (sync && fdatasync(fileno(h->fp)) != 0) return(-1);
+	return(ftell(h->fp));
+}
+
+/*-------------------------------------------------------------------------
+  Reads the next record.  Returns the number of values read, as fscanf
+  did: HDR_VALUES for a good record, EOF at the end of the file.
+ -------------------------------------------------------------------------*/
+int read_header(SEASAT_hdr_file *h, SEASAT_header_ext *s)
+{
+	int val;
+
+	if (s==NULL) {printf("empty pointer passed to read_header\n"); exit(1);}
+	if (h->binary) {
+	  if (h->next >= h->nrecs) return(EOF);
+	  decode_record(h->map + HDRB_HEADER_SIZE + h->next*HDRB_RECORD_SIZE,s);
+	  h->next++;
+	  return(HDR_VALUES);
+	}
+
+	val = fscanf(h->fp,"%i %li %i %i %i %li %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n",
+	  &(s->major_cnt),&(s->major_sync_loc),&(s->station_code),&(s->lsd_year),
+	  &(s->day_of_year),&(s->msec),&(s->clock_drift),&(s->no_scan_indicator_bit),
+	  &(s->bits_per_sample),&(s->mfr_lock_bit),&(s->prf_rate_code),&(s->delay),
+	  &(s->scu_bit),&(s->sdf_bit),&(s->adc_bit),&(s->time_gate_bit),&(s->local_prf_bit),
+	  &(s->auto_prf_bit),&(s->prf_lock_bit),&(s->local_delay_bit));
+	if (val == HDR_VALUES) h->next++;
+	return(val);
+}
+
+void write_header(SEASAT_hdr_file *h, SEASAT_header_ext *s)
+{
+	unsigned char rec[HDRB_RECORD_SIZE];
+
+	if (s==NULL) {printf("empty pointer passed to write_header\n"); exit(1);}
+	if (h==NULL) {printf("null header file passed to write_header\n"); exit(1);}
+	if (h->binary) {
+	  encode_record(h,s,rec);
+	  if (fwrite(rec,HDRB_RECORD_SIZE,1,h->fp) != 1) {
+	    printf("ERROR: unable to write to header file %s\n",h->name); exit(1);
+	  }
+	  h->nrecs++;
+	  return;
+	}
+	fprintf(h->fp,"%i %li %i %i %i %li %i %i %i %i %i %i %i %i %i %i %i %i %i %i\n",
+	  s->major_cnt,s->major_sync_loc,s->station_code,s->lsd_year,
+	  s->day_of_year,s->msec,s->clock_drift,s->no_scan_indicator_bit,
+	  s->bits_per_sample,s->mfr_lock_bit,s->prf_rate_code,s->delay,
+	  s->scu_bit,s->sdf_bit,s->adc_bit,s->time_gate_bit,s->local_prf_bit,
+	  s->auto_prf_bit,s->prf_lock_bit,s->local_delay_bit);
+}
+
+/*-------------------------------------------------------------------------
+  Makes record rec (counting from 0) the next one read_header returns.
+  Direct for a binary file; an ASCII file is read through up to rec.
+  Returns 0, or -1 if the file has fewer records.
+ -------------------------------------------------------------------------*/
+int seek_header(SEASAT_hdr_file *h, long rec)
+{
+	SEASAT_header_ext s;
+
+	if (rec < 0) return(-1);
+	if (h->binary) {
+	  if (rec > h->nrecs) return(-1);
+	  h->next = rec;
+	  return(0);
+	}
+	if (rec < h->next) { rewind(h->fp); h->next = 0; }
+	while (h->next < rec)
+	  if (read_header(h,&s) != HDR_VALUES) return(-1);
+	return(0);
+}
+
+/* number of records in a binary file, -1 for an ASCII one */
+long count_headers(SEASAT_hdr_file *h)
+{
+	return(h->binary ? h->nrecs : -1);
+}
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "seasat_qual.h"
+
+/*************************************************************************************
+  Reader and writer for per line quality files
+
+  The decoder writes the records (see seasat_qual.h): in order through
+  stdio when it writes its lines itself, or with pwrite straight to each
+  record's place when its line writer threads do.  It sums the line
+  histograms up as it goes, and close_qual_file puts the totals, mean,
+  variance and saturation into the file header.  Tools that want to pass
+  over bad lines read the whole file with read_qual_file; those that only
+  want the sample statistics read the header with read_qual_stats.
+*************************************************************************************/
+
+static void put_le(unsigned char *p, long v, int n)
+{
+	int i;
+	for (i=0; i<n; i++) { p[i] = v & 0377; v >>= 8; }
+}
+
+static long get_le(const unsigned char *p, int n)
+{
+	long v = 0;
+	int i;
+	for (i=n-1; i>=0; i--) v = (v << 8) | p[i];
+	if (n < 8 && (v >> (8*n-1)) & 1) v -= 1L << (8*n);	/* sign extend */
+	return(v);
+}
+
+static void put_double(unsigned char *p, double d)
+{
+	long v;
+	memcpy(&v,&d,8);
+	put_le(p,v,8);
+}
+
+/*-------------------------------------------------------------------------
+  Counts the n samples of line into hist.  Four histograms are kept and
+  added up at the end, so consecutive samples of the same value do not
+  wait on each other's increment.  This beats counting with SIMD
+  compares, which takes two vector operations per sample for 32 bins.
+ -------------------------------------------------------------------------*/
+void line_histogram(const unsigned char *line, int n, int *hist)
+{
+	int h[4][QUAL_BINS];
+	int i, v;
+
+	memset(h,0,sizeof(h));
+	for (i=0; i+4<=n; i+=4) {
+	  h[0][line[i]   & (QUAL_BINS-1)]++;
+	  h[1][line[i+1] & (QUAL_BINS-1)]++;
+	  h[2][line[i+2] & (QUAL_BINS-1)]++;
+	  h[3][line[i+3] & (QUAL_BINS-1)]++;
+	}
+	for (; i<n; i++) h[0][line[i] & (QUAL_BINS-1)]++;
+	for (v=0; v<QUAL_BINS; v++) hist[v] = h[0][v] + h[1][v] + h[2][v] + h[3][v];
+}
+
+/* adds one line's histogram to s */
+void add_line_stats(SEASAT_sample_stats *s, const int *hist)
+{
+	int v;
+
+	s->lines++;
+	for (v=0; v<QUAL_BINS; v++) s->hist[v] += hist[v];
+}
+
+/* mean, variance and fraction of samples at 0 or 31 from the histogram */
+void sample_moments(const SEASAT_sample_stats *s, double *mean, double *variance, double *saturated)
+{
+	double n = 0.0, sum = 0.0, sumsq = 0.0;
+	int v;
+
+	for (v=0; v<QUAL_BINS; v++) {
+	  n += s->hist[v];
+	  sum += (double) v * s->hist[v];
+	  sumsq += (double) v * v * s->hist[v];
+	}
+	*mean = *variance = *saturated = 0.0;
+	if (n == 0.0) return;
+	*mean = sum / n;
+	*variance = sumsq / n - (*mean) * (*mean);
+	*saturated = (s->hist[0] + s->hist[QUAL_BINS-1]) / n;
+}
+
+static void make_qual_header(unsigned char *h, const SEASAT_sample_stats *s)
+{
+	double mean, variance, saturated;
+	int v;
+
+	memset(h,0,QUAL_HEADER_SIZE);
+	memcpy(h,QUAL_MAGIC,8);
+	put_le(h+8,QUAL_VERSION,4);
+	put_le(h+12,QUAL_HEADER_SIZE,4);
+	put_le(h+16,QUAL_RECORD_SIZE,4);
+	put_le(h+20,QUAL_BINS,4);
+	if (s == NULL) return;
+	sample_moments(s,&mean,&variance,&saturated);
+	put_le(h+24,s->lines,8);
+	for (v=0; v<QUAL_BINS; v++) put_le(h+32+8*v,s->hist[v],8);
+	put_double(h+288,mean);
+	put_double(h+296,variance);
+	put_double(h+304,saturated);
+}
+
+/*-------------------------------------------------------------------------
+  Creates the quality file name and writes its file header.  The header
+  is flushed at once, so records can be written with pwrite as well.
+  Returns NULL if the file can not be opened.
+ -------------------------------------------------------------------------*/
+FILE *open_qual_file(const char *name)
+{
+	FILE *fp;
+	unsigned char h[QUAL_HEADER_SIZE];
+
+	if ((fp = fopen(name,"wb")) == NULL) return(NULL);
+	make_qual_header(h,NULL);
+	if (fwrite(h,QUAL_HEADER_SIZE,1,fp) != 1 || fflush(fp) != 0) { fclose(fp); return(NULL); }
+	return(fp);
+}
+
+void encode_quality(const SEASAT_line_quality *q, unsigned char *p)
+{
+	int i;
+
+	memset(p,0,QUAL_RECORD_SIZE);
+	put_le(p,q->major_sync_loc,8);
+	put_le(p+8,q->line,4);
+	put_le(p+12,q->frames,2);
+	put_le(p+14,q->fixed,2);
+	put_le(p+16,q->unfixed,2);
+	put_le(p+18,q->fill,2);
+	put_le(p+20,q->missed,2);
+	put_le(p+22,q->flags,2);
+	put_le(p+24,q->sync_errors,4);
+	for (i=0; i<QUAL_BINS; i++) put_le(p+32+2*i,q->hist[i],2);
+}
+
+static void decode_quality(const unsigned char *p, SEASAT_line_quality *q)
+{
+	int i;
+
+	q->major_sync_loc = get_le(p,8);
+	q->line        = get_le(p+8,4);
+	q->frames      = get_le(p+12,2);
+	q->fixed       = get_le(p+14,2);
+	q->unfixed     = get_le(p+16,2);
+	q->fill        = get_le(p+18,2);
+	q->missed      = get_le(p+20,2);
+	q->flags       = get_le(p+22,2);
+	q->sync_errors = get_le(p+24,4);
+	for (i=0; i<QUAL_BINS; i++) q->hist[i] = get_le(p+32+2*i,2) & 0177777;
+}
+
+/* appends one record to a quality file written in order */
+void write_quality(FILE *fp, const SEASAT_line_quality *q)
+{
+	unsigned char r[QUAL_RECORD_SIZE];
+
+	encode_quality(q,r);
+	if (fwrite(r,QUAL_RECORD_SIZE,1,fp) != 1) { printf("ERROR: unable to write to quality file\n"); exit(1); }
+}
+
+/*-------------------------------------------------------------------------
+  Writes the n records of lines first_line on to the quality file open
+  on fd, each in its place.
+ -------------------------------------------------------------------------*/
+void pwrite_quality(int fd, long first_line, const SEASAT_line_quality *q, int n)
+{
+	unsigned char r[64*QUAL_RECORD_SIZE];
+	int i, k;
+
+	for (i=0; i<n; i+=k) {
+	  for (k=0; k<64 && i+k<n; k++) encode_quality(&q[i+k],r+k*QUAL_RECORD_SIZE);
+	  if (pwrite(fd,r,k*QUAL_RECORD_SIZE,QUAL_HEADER_SIZE+(first_line+i)*QUAL_RECORD_SIZE) != k*QUAL_RECORD_SIZE) {
+	    printf("ERROR: unable to write %i quality records at line %li\n",k,first_line+i);
+	    exit(1);
+	  }
+	}
+}
+
+/* fills in the summary of the samples s and closes the file */
+void close_qual_file(FILE *fp, const SEASAT_sample_stats *s)
+{
+	unsigned char h[QUAL_HEADER_SIZE];
+
+	if (fp == NULL) return;
+	make_qual_header(h,s);
+	if (fseek(fp,0,SEEK_SET) != 0 || fwrite(h,QUAL_HEADER_SIZE,1,fp) != 1) {
+	  printf("ERROR: unable to write to quality file\n"); exit(1);
+	}
+	fclose(fp);
+}
+
+/* reads the file header of a quality file; exits if it is not one */
+static FILE *open_qual_header(const char *name, unsigned char *h)
+{
+	FILE *fp;
+
+	if ((fp = fopen(name,"rb")) == NULL) return(NULL);
+	if (fread(h,QUAL_HEADER_SIZE,1,fp) != 1 || memcmp(h,QUAL_MAGIC,8) != 0) {
+	  printf("ERROR: %s is not a quality file\n",name); exit(1);
+	}
+	if (get_le(h+8,4) != QUAL_VERSION || get_le(h+16,4) < QUAL_RECORD_SIZE || get_le(h+20,4) != QUAL_BINS) {
+	  printf("ERROR: %s is a version %li quality file; expected version %i\n",name,get_le(h+8,4),QUAL_VERSION);
+	  exit(1);
+	}
+	return(fp);
+}
+
+/*-------------------------------------------------------------------------
+  Reads the sample statistics of the whole quality file name into s.
+  Returns 0, or -1 if there is no such file or it was never finished.
+ -------------------------------------------------------------------------*/
+int read_qual_stats(const char *name, SEASAT_sample_stats *s)
+{
+	FILE *fp;
+	unsigned char h[QUAL_HEADER_SIZE];
+	int v;
+
+	if ((fp = open_qual_header(name,h)) == NULL) return(-1);
+	fclose(fp);
+	s->lines = get_le(h+24,8);
+	for (v=0; v<QUAL_BINS; v++) s->hist[v] = get_le(h+32+8*v,8);
+	return(s->lines > 0 ? 0 : -1);
+}
+
+/*-------------------------------------------------------------------------
+  Reads the whole quality file name.  Returns the records and sets *n,
+  or exits if the file is not a quality file.
+ -------------------------------------------------------------------------*/
+SEASAT_line_quality *read_qual_file(const char *name, long *n)
+{
+	FILE *fp;
+	unsigned char h[QUAL_HEADER_SIZE], r[QUAL_RECORD_SIZE];
+	SEASAT_line_quality *q;
+	long i, size, rsize;
+
+	if ((fp = open_qual_header(name,h)) == NULL) { printf("ERROR: unable to open quality file %s\n",name); exit(1); }
+	rsize = get_le(h+16,4);
+	fseek(fp,0,SEEK_END);
+	size = ftell(fp);
+	*n = (size - get_le(h+12,4)) / rsize;
+	fseek(fp,get_le(h+12,4),SEEK_SET);
+
+	q = (SEASAT_line_quality *) malloc((*n ? *n : 1)*sizeof(SEASAT_line_quality));
+	if (q == NULL) { printf("ERROR: unable to allocate quality file %s\n",name); exit(1); }
+	for (i=0; i<*n; i++) {
+	  if (fread(r,QUAL_RECORD_SIZE,1,fp) != 1) { printf("ERROR: quality file %s is short\n",name); exit(1); }
+	  if (rsize > QUAL_RECORD_SIZE) fseek(fp,rsize-QUAL_RECORD_SIZE,SEEK_CUR);
+	  decode_quality(r,&q[i]);
+	}
+	fclose(fp);
+	return(q);
+}
+
+/*-------------------------------------------------------------------------
+  Opens the quality file name to read its records in order with
+  read_quality, without reading the whole file.  Returns NULL if there
+  is no such file; exits if it is not a quality file.
+ -------------------------------------------------------------------------*/
+FILE *open_qual_reader(const char *name)
+{
+	FILE *fp;
+	unsigned char h[QUAL_HEADER_SIZE];
+
+	if ((fp = open_qual_header(name,h)) == NULL) return(NULL);
+	if (get_le(h+16,4) != QUAL_RECORD_SIZE) {
+	  printf("ERROR: %s has %li byte records; expected %i\n",name,get_le(h+16,4),QUAL_RECORD_SIZE);
+	  exit(1);
+	}
+	fseek(fp,get_le(h+12,4),SEEK_SET);
+	return(fp);
+}
+
+/* reads the next record into q; returns 1, or 0 at the end of the file */
+int read_quality(FILE *fp, SEASAT_line_quality *q)
+{
+	unsigned char r[QUAL_RECORD_SIZE];
+
+	if (fread(r,QUAL_RECORD_SIZE,1,fp) != 1) return(0);
+	decode_quality(r,q);
+	return(1);
+}
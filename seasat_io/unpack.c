@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seasat.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/*************************************************************************************
+  5-bit sample unpacking
+
+  Samples are packed MSB first, 8 samples to every 5 bytes.  All of the
+  kernels below take a pointer and a starting bit offset (0..7) so that
+  nibble-shifted frames can be unpacked without being shifted first.  A
+  kernel never reads past the last byte that holds part of sample n-1.
+*************************************************************************************/
+
+typedef void (*unpack_fn)(const unsigned char *src, int bit_offset, unsigned char *dst, int n);
+
+static void unpack_scalar(const unsigned char *src, int bit_offset, unsigned char *dst, int n);
+static unpack_fn unpack_kernel = NULL;
+static const char *unpack_name = "none";
+
+/* Number of source bytes that hold n samples starting at bit_offset */
+static inline int unpack_bytes(int bit_offset, int n)
+{
+	return((bit_offset + 5*n + 7) >> 3);
+}
+
+/*-------------------------------------------------------------------------
+  Unpacks samples one at a time, only touching the bytes that hold them.
+ -------------------------------------------------------------------------*/
+static void unpack_tail(const unsigned char *src, int bit_offset, unsigned char *dst, int n)
+{
+	int i, pos, b, o;
+	unsigned int word;
+
+	for (i=0; i<n; i++) {
+	  pos = bit_offset + 5*i;
+	  b = pos >> 3;
+	  o = pos & 7;
+	  word = src[b] << 8;
+	  if (o > 3) word |= src[b+1];		/* sample spans two bytes */
+	  dst[i] = (word >> (11-o)) & 037;
+	}
+}
+
+/*-------------------------------------------------------------------------
+  Portable kernel - 8 samples from a 48 bit big endian window at a time.
+ -------------------------------------------------------------------------*/
+static void unpack_scalar(const unsigned char *src, int bit_offset, unsigned char *dst, int n)
+{
+	int nbytes = unpack_bytes(bit_offset,n);
+	int i = 0;
+	unsigned long long v;
+
+	/* every group of 8 samples needs bytes 0..5 of its window */
+	while (i+8 <= n && (i/8)*5+6 <= nbytes) {
+	  const unsigned char *p = src + (i/8)*5;
+	  v = ((unsigned long long)p[0] << 40) | ((unsigned long long)p[1] << 32) |
+	      ((unsigned long long)p[2] << 24) | ((unsigned long long)p[3] << 16) |
+	      ((unsigned long long)p[4] << 8)  |  (unsigned long long)p[5];
+	  v <<= bit_offset;
+	  dst[i]   = (v >> 43) & 037;
+	  dst[i+1] = (v >> 38) & 037;
+	  dst[i+2] = (v >> 33) & 037;
+	  dst[i+3] = (v >> 28) & 037;
+	  dst[i+4] = (v >> 23) & 037;
+	  dst[i+5] = (v >> 18) & 037;
+	  dst[i+6] = (v >> 13) & 037;
+	  dst[i+7] = (v >> 8)  & 037;
+	  i += 8;
+	}
+	unpack_tail(src + (i/8)*5, bit_offset, dst+i, n-i);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*-------------------------------------------------------------------------
+  Shuffle and multiply tables for the vector kernels.
+
+  Each 16 bit lane i is loaded with (byte[b] << 8 | byte[b+1]) where b is
+  the byte holding the top bit of sample i.  The sample then sits at bits
+  11-o..15-o of the lane (o = bit within byte b), so multiplying by
+  2^(5+o) and keeping the high 16 bits of the product (pmulhuw) moves it
+  to the bottom of the lane for any o - a per lane variable shift.
+ -------------------------------------------------------------------------*/
+static unsigned char shuf_tab[8][16];
+static unsigned short mult_tab[8][8];
+
+static void init_tables(void)
+{
+	int s, i, pos, b, o;
+
+	for (s=0; s<8; s++)
+	  for (i=0; i<8; i++) {
+	    pos = s + 5*i;
+	    b = pos >> 3;
+	    o = pos & 7;
+	    shuf_tab[s][2*i]   = b+1;		/* low byte of the lane  */
+	    shuf_tab[s][2*i+1] = b;		/* high byte of the lane */
+	    mult_tab[s][i] = 1 << (5+o);
+	  }
+}
+
+/*-------------------------------------------------------------------------
+  SSSE3 kernel - 16 samples from 10 bytes per iteration (16 byte loads).
+ -------------------------------------------------------------------------*/
+__attribute__((target("ssse3")))
+static void unpack_ssse3(const unsigned char *src, int bit_offset, unsigned char *dst, int n)
+{
+	int nbytes = unpack_bytes(bit_offset,n);
+	int i = 0;
+	const unsigned char *p = src;
+	__m128i shuf = _mm_loadu_si128((const __m128i *) shuf_tab[bit_offset]);
+	__m128i mult = _mm_loadu_si128((const __m128i *) mult_tab[bit_offset]);
+	__m128i mask = _mm_set1_epi16(037);
+
+	while (i+16 <= n && (p-src)+21 <= nbytes) {
+	  __m128i lo = _mm_loadu_si128((const __m128i *) p);
+	  __m128i hi = _mm_loadu_si128((const __m128i *) (p+5));
+	  lo = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(lo,shuf),mult),mask);
+	  hi = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(hi,shuf),mult),mask);
+	  _mm_storeu_si128((__m128i *) (dst+i),_mm_packus_epi16(lo,hi));
+	  i += 16;
+	  p += 10;
+	}
+	unpack_scalar(p,bit_offset,dst+i,n-i);
+}
+
+/*-------------------------------------------------------------------------
+  AVX2 kernel - 32 samples from 20 bytes per iteration.  pshufb works
+  within 128 bit lanes, so each lane gets its own 16 byte load.
+ -------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static void unpack_avx2(const unsigned char *src, int bit_offset, unsigned char *dst, int n)
+{
+	int nbytes = unpack_bytes(bit_offset,n);
+	int i = 0;
+	const unsigned char *p = src;
+	__m256i shuf = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) shuf_tab[bit_offset]));
+	__m256i mult = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) mult_tab[bit_offset]));
+	__m256i mask = _mm256_set1_epi16(037);
+
+	while (i+32 <= n && (p-src)+31 <= nbytes) {
+	  /* lane 0 holds samples 0-7 / 8-15, lane 1 holds samples 16-23 / 24-31 */
+	  __m256i lo = _mm256_inserti128_si256(_mm256_castsi128_si256(
+	  		_mm_loadu_si128((const __m128i *) p)),
+			_mm_loadu_si128((const __m128i *) (p+10)),1);
+	  __m256i hi = _mm256_inserti128_si256(_mm256_castsi128_si256(
+	  		_mm_loadu_si128((const __m128i *) (p+5))),
+			_mm_loadu_si128((const __m128i *) (p+15)),1);
+	  lo = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(lo,shuf),mult),mask);
+	  hi = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(hi,shuf),mult),mask);
+	  _mm256_storeu_si256((__m256i *) (dst+i),_mm256_packus_epi16(lo,hi));
+	  i += 32;
+	  p += 20;
+	}
+
+	/* finish with 16 sample steps here rather than calling the SSSE3 kernel;
+	   mixing legacy SSE and AVX encodings stalls on the transition */
+	while (i+16 <= n && (p-src)+21 <= nbytes) {
+	  __m128i lo = _mm_loadu_si128((const __m128i *) p);
+	  __m128i hi = _mm_loadu_si128((const __m128i *) (p+5));
+	  lo = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(lo,_mm256_castsi256_si128(shuf)),
+	  		_mm256_castsi256_si128(mult)),_mm256_castsi256_si128(mask));
+	  hi = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(hi,_mm256_castsi256_si128(shuf)),
+	  		_mm256_castsi256_si128(mult)),_mm256_castsi256_si128(mask));
+	  _mm_storeu_si128((__m128i *) (dst+i),_mm_packus_epi16(lo,hi));
+	  i += 16;
+	  p += 10;
+	}
+	_mm256_zeroupper();
+	unpack_scalar(p,bit_offset,dst+i,n-i);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/*-------------------------------------------------------------------------
+  Picks the fastest kernel this cpu supports.  SEASAT_UNPACK=scalar|ssse3
+  in the environment forces a particular kernel.
+ -------------------------------------------------------------------------*/
+static void select_kernel(void)
+{
+	const char *force = getenv("SEASAT_UNPACK");
+
+	unpack_kernel = unpack_scalar;
+	unpack_name = "scalar";
+#ifdef HAVE_X86_KERNELS
+	init_tables();
+	if (force != NULL && strcmp(force,"scalar")==0) return;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3")) { unpack_kernel = unpack_ssse3; unpack_name = "ssse3"; }
+	if (force != NULL && strcmp(force,"ssse3")==0) return;
+	if (__builtin_cpu_supports("avx2")) { unpack_kernel = unpack_avx2; unpack_name = "avx2"; }
+#endif
+}
+
+/*-------------------------------------------------------------------------
+  Unpacks n 5-bit samples starting at bit bit_offset of src into dst,
+  one sample per byte.
+ -------------------------------------------------------------------------*/
+void unpack_samples(const unsigned char *src, int bit_offset, unsigned char *dst, int n)
+{
+	if (unpack_kernel == NULL) select_kernel();
+	src += bit_offset >> 3;
+	unpack_kernel(src,bit_offset&7,dst,n);
+}
+
+const char *unpack_kernel_name(void)
+{
+	if (unpack_kernel == NULL) select_kernel();
+	return(unpack_name);
+}